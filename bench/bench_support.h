@@ -0,0 +1,96 @@
+#ifndef BENCH_SUPPORT_H
+#define BENCH_SUPPORT_H
+
+/**
+ * @file bench_support.h
+ * @brief Fixtures shared by the host benchmarks: clock, busy wait, assert handler and latency statistics.
+ *
+ * Header only, every bench is built as a single translation unit (see the native envs in platformio.ini).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "custom_types.h"
+
+// ###########################################################################
+// # Types
+// ###########################################################################
+typedef struct
+{
+    u32 nof_samples;
+    double min_us;
+    double avg_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} bench_stats_t;
+
+// ###########################################################################
+// # Functions
+// ###########################################################################
+static inline u64 bench_clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static inline u64 bench_now_ns(void) { return bench_clock_ns(CLOCK_MONOTONIC); }
+
+// Stands in for the work of a handler, sleeping would hand the CPU to the other threads
+static inline void bench_busy_wait_ns(u64 duration_ns)
+{
+    u64 start = bench_now_ns();
+    while ((bench_now_ns() - start) < duration_ns)
+    {
+    }
+}
+
+// Handler for custom_assert_init(), a failed check ends the bench with a non-zero exit code
+static inline void bench_assert_failed(const char* file, uint32_t line, const char* expr)
+{
+    fprintf(stderr, "[ASSERT FAILED]: %s:%u - %s\n", file, line, expr);
+    abort();
+}
+
+static inline int bench_compare_u64(const void* a, const void* b)
+{
+    u64 lhs = *(const u64*)a;
+    u64 rhs = *(const u64*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Sorts the samples (ns) in place, all values are 0 without samples
+static inline bench_stats_t bench_get_stats(u64* samples_ns, u32 nof_samples)
+{
+    bench_stats_t stats = {nof_samples, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if (nof_samples == 0)
+    {
+        return stats;
+    }
+
+    qsort(samples_ns, nof_samples, sizeof(u64), bench_compare_u64);
+
+    u64 total_ns = 0;
+    for (u32 i = 0; i < nof_samples; i++)
+    {
+        total_ns += samples_ns[i];
+    }
+    stats.min_us = (double)samples_ns[0] / 1000.0;
+    stats.avg_us = (double)total_ns / nof_samples / 1000.0;
+    stats.p50_us = (double)samples_ns[nof_samples / 2U] / 1000.0;
+    stats.p99_us = (double)samples_ns[(nof_samples * 99U) / 100U] / 1000.0;
+    stats.max_us = (double)samples_ns[nof_samples - 1U] / 1000.0;
+    return stats;
+}
+
+static inline void bench_print_stats(const char* label, u64* samples_ns, u32 nof_samples)
+{
+    bench_stats_t stats = bench_get_stats(samples_ns, nof_samples);
+    printf("  %-22s min %8.2f us | avg %8.2f us | p50 %8.2f us | p99 %8.2f us | max %8.2f us\n", label,
+           stats.min_us, stats.avg_us, stats.p50_us, stats.p99_us, stats.max_us);
+}
+
+#endif // BENCH_SUPPORT_H
@@ -0,0 +1,138 @@
+/**
+ * @file messagebroker_async_bench.c
+ * @brief Host benchmark: synchronous vs. queued (async) MessageBroker dispatch.
+ *
+ * Measures for both delivery modes
+ * - publisher blocking time: duration of the messagebroker_publish() call
+ * - publish-to-handler latency: time from publish until the callback runs
+ *
+ * The subscriber simulates a handler that does some work (e.g. Serial prints).
+ * On a single-core host the woken consumer thread may preempt the publisher before
+ * messagebroker_publish() returns - the same happens on the ESP32-C6 when the
+ * subscriber task has a higher priority than the publishing task.
+ *
+ * Build and run with PlatformIO (see env:native_async in platformio.ini):
+ *   pio run -e native_async -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -DMESSAGEBROKER_ASYNC_DISPATCH=1 -Ilib/MessageBroker -Ilib/Utils \
+ *       lib/MessageBroker/Message*.c lib/Utils/custom_assert.c bench/messagebroker_async_bench.c \
+ *       -lpthread -o messagebroker_async_bench && ./messagebroker_async_bench
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+#if !defined(MESSAGEBROKER_ASYNC_DISPATCH) || (MESSAGEBROKER_ASYNC_DISPATCH == 0)
+#error "Build with -DMESSAGEBROKER_ASYNC_DISPATCH=1, otherwise both runs measure synchronous dispatch"
+#endif
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_ITERATIONS   10000U
+#define HANDLER_WORK_NS  20000U // Simulated handler work (20 us)
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static u64 blocking_ns[NOF_ITERATIONS];
+static u64 latency_ns[NOF_ITERATIONS];
+static atomic_uint nof_handled = 0;
+static atomic_bool is_consumer_running = true;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_handler(const msg_t* const message)
+{
+    u64 published_at_ns = 0;
+    memcpy(&published_at_ns, message->data_bytes, sizeof(published_at_ns));
+
+    unsigned idx = atomic_load(&nof_handled);
+    if (idx < NOF_ITERATIONS)
+    {
+        latency_ns[idx] = bench_now_ns() - published_at_ns;
+    }
+
+    bench_busy_wait_ns(HANDLER_WORK_NS);
+    atomic_fetch_add(&nof_handled, 1);
+}
+
+// A callback is either delivered directly or through a queue, so each mode gets its own
+static void prv_sync_handler(const msg_t* const message) { prv_handler(message); }
+
+static void prv_queued_handler(const msg_t* const message) { prv_handler(message); }
+
+static void* prv_consumer_thread(void* arg)
+{
+    msg_queue_t* queue = (msg_queue_t*)arg;
+    while (atomic_load(&is_consumer_running))
+    {
+        messagebroker_queue_process(queue, 10);
+    }
+    return NULL;
+}
+
+static void prv_run(msg_id_e topic, const char* mode_name)
+{
+    atomic_store(&nof_handled, 0);
+
+    for (u32 i = 0; i < NOF_ITERATIONS; i++)
+    {
+        u64 published_at_ns = bench_now_ns();
+
+        msg_t msg;
+        msg.msg_id = topic;
+        msg.data_size = sizeof(published_at_ns);
+        msg.data_bytes = (u8*)&published_at_ns;
+
+        messagebroker_publish(&msg);
+        blocking_ns[i] = bench_now_ns() - published_at_ns;
+
+        // Wait until the handler ran, so that every sample starts with an empty queue
+        while (atomic_load(&nof_handled) <= i)
+        {
+            sched_yield();
+        }
+    }
+
+    printf("%s dispatch (%u messages, %u us handler work)\n", mode_name, NOF_ITERATIONS, HANDLER_WORK_NS / 1000U);
+    bench_print_stats("publisher blocking:", blocking_ns, NOF_ITERATIONS);
+    bench_print_stats("publish-to-handler:", latency_ns, NOF_ITERATIONS);
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    // Synchronous subscriber on MSG_0001, queued subscriber on MSG_0002
+    messagebroker_subscribe(MSG_0001, prv_sync_handler);
+
+    msg_queue_t* queue = messagebroker_queue_create();
+    messagebroker_subscribe_queued(MSG_0002, prv_queued_handler, queue);
+
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, prv_consumer_thread, queue);
+
+    prv_run(MSG_0001, "Synchronous");
+    prv_run(MSG_0002, "Queued (async)");
+
+    atomic_store(&is_consumer_running, false);
+    pthread_join(consumer, NULL);
+
+    printf("Dropped messages (queue full): %u\n", messagebroker_queue_get_dropped_count(queue));
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file messagebroker_coalescing_bench.c
+ * @brief Host benchmark: bursts into a slow queued subscriber, with and without coalescing.
+ *
+ * A publisher sends bursts of messages faster than the subscriber task can handle them.
+ * For every topic policy of MessageCoalescing.h and for messagebroker_publish_batch() the
+ * benchmark reports
+ * - handler invocations, coalesced and dropped deliveries
+ * - consumer wake-ups: calls of messagebroker_queue_process() that dispatched something
+ * - publisher cost per message
+ *
+ * Build and run with PlatformIO (see env:native_coalescing in platformio.ini):
+ *   pio run -e native_coalescing -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -DMESSAGEBROKER_ASYNC_DISPATCH=1 -Ilib/MessageBroker -Ilib/Utils \
+ *       lib/MessageBroker/Message*.c lib/Utils/custom_assert.c bench/messagebroker_coalescing_bench.c \
+ *       -lpthread -o messagebroker_coalescing_bench && ./messagebroker_coalescing_bench
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+#if !defined(MESSAGEBROKER_ASYNC_DISPATCH) || (MESSAGEBROKER_ASYNC_DISPATCH == 0)
+#error "Build with -DMESSAGEBROKER_ASYNC_DISPATCH=1, coalescing only applies to queued deliveries"
+#endif
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_BURSTS         200U
+#define BURST_LENGTH       16U     // Twice the default MESSAGEBROKER_QUEUE_DEPTH
+#define BURST_INTERVAL_NS  2000000U // 2 ms between bursts
+#define HANDLER_WORK_NS    100000U  // Simulated handler work (100 us)
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static atomic_uint nof_handled = 0;
+static atomic_uint nof_wakeups = 0;
+static atomic_uint last_value = 0;
+static atomic_bool is_consumer_running = true;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_handler(const msg_t* const message)
+{
+    if (message->data_size == sizeof(u32))
+    {
+        atomic_store(&last_value, *(const u32*)message->data_bytes);
+    }
+    bench_busy_wait_ns(HANDLER_WORK_NS);
+    atomic_fetch_add(&nof_handled, 1);
+}
+
+static void* prv_consumer_thread(void* arg)
+{
+    msg_queue_t* queue = (msg_queue_t*)arg;
+    while (atomic_load(&is_consumer_running))
+    {
+        if (messagebroker_queue_process(queue, 10) > 0)
+        {
+            atomic_fetch_add(&nof_wakeups, 1);
+        }
+    }
+    return NULL;
+}
+
+static void prv_run(msg_queue_t* queue, msg_id_e topic, bool has_payload, bool is_batched, const char* label)
+{
+    u32 coalesced_before = messagebroker_queue_get_coalesced_count(queue);
+    u32 dropped_before = messagebroker_queue_get_dropped_count(queue);
+    atomic_store(&nof_handled, 0);
+    atomic_store(&nof_wakeups, 0);
+
+    u32 values[BURST_LENGTH];
+    msg_t burst[BURST_LENGTH];
+    u64 publish_ns = 0;
+    u32 value = 0;
+
+    for (u32 b = 0; b < NOF_BURSTS; b++)
+    {
+        u64 burst_start_ns = bench_now_ns();
+
+        for (u32 i = 0; i < BURST_LENGTH; i++)
+        {
+            values[i] = ++value;
+            burst[i].msg_id = topic;
+            burst[i].data_size = has_payload ? sizeof(u32) : 0;
+            burst[i].data_bytes = has_payload ? (u8*)&values[i] : NULL;
+        }
+
+        u64 start_ns = bench_now_ns();
+        if (is_batched)
+        {
+            messagebroker_publish_batch(burst, BURST_LENGTH);
+        }
+        else
+        {
+            for (u32 i = 0; i < BURST_LENGTH; i++)
+            {
+                messagebroker_publish(&burst[i]);
+            }
+        }
+        publish_ns += bench_now_ns() - start_ns;
+
+        while ((bench_now_ns() - burst_start_ns) < BURST_INTERVAL_NS)
+        {
+        }
+    }
+
+    // Let the consumer drain the last burst
+    bench_busy_wait_ns(BURST_INTERVAL_NS * 2U);
+
+    u32 nof_published = NOF_BURSTS * BURST_LENGTH;
+    printf("  %-26s | %9u | %7u | %9u | %7u | %7u | %8.1f\n", label, nof_published, atomic_load(&nof_handled),
+           messagebroker_queue_get_coalesced_count(queue) - coalesced_before,
+           messagebroker_queue_get_dropped_count(queue) - dropped_before, atomic_load(&nof_wakeups),
+           (double)publish_ns / nof_published);
+
+    if (has_payload && (topic == MSG_0003))
+    {
+        // Latest-wins must never lose the final value of a burst
+        ASSERT(atomic_load(&last_value) == value);
+    }
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    // MSG_0001 has no policy, MSG_1003 drops duplicates, MSG_0003 keeps the latest payload
+    msg_queue_t* queue = messagebroker_queue_create();
+    messagebroker_subscribe_queued(MSG_0001, prv_handler, queue);
+    messagebroker_subscribe_queued(MSG_1003, prv_handler, queue);
+    messagebroker_subscribe_queued(MSG_0003, prv_handler, queue);
+
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, prv_consumer_thread, queue);
+
+    printf("Bursts of %u messages every %u ms into a queue of %u, %u us handler work, %u bursts\n", BURST_LENGTH,
+           BURST_INTERVAL_NS / 1000000U, MESSAGEBROKER_QUEUE_DEPTH, HANDLER_WORK_NS / 1000U, NOF_BURSTS);
+    printf("  %-26s | published | handled | coalesced | dropped | wakeups | ns/msg\n", "topic");
+    prv_run(queue, MSG_0001, true, false, "no policy");
+    prv_run(queue, MSG_0001, true, true, "no policy, batched");
+    prv_run(queue, MSG_1003, false, false, "drop duplicates");
+    prv_run(queue, MSG_1003, false, true, "drop duplicates, batched");
+    prv_run(queue, MSG_0003, true, false, "latest wins");
+    prv_run(queue, MSG_0003, true, true, "latest wins, batched");
+
+    atomic_store(&is_consumer_running, false);
+    pthread_join(consumer, NULL);
+    return 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file messagebroker_executor_bench.c
+ * @brief Host benchmark: response latency of one task per module against the cooperative executor.
+ *
+ * Four modules on the broker, modelled after the firmware:
+ * - DeskControl: gets a UART frame (MSG_1003, published from interrupt context) every 7 ms
+ * - Console: a key press every 53 ms, each one runs a query (messagerpc_call() on MSG_4002)
+ * - ApplicationControl: answers the query (MSG_4004)
+ * - PresenceDetector: evaluates a BLE scan for 3 ms every 100 ms
+ * Preemptive: every module and the MessageDispatcher have their own thread and queue, like
+ * the *_create_task() functions. The PresenceDetector thread runs at the lowest priority
+ * (SCHED_IDLE), like its task on the desk, so the others preempt its work. Cooperative: one
+ * thread runs the run hooks and dispatches one shared queue and the ISR ring, like
+ * executor_create_task(). Every mode runs in its own process, the broker is only initialized
+ * once. Reported per path: avg, p99 and max latency.
+ *
+ * The scan evaluation is the worst case for the executor: an event that arrives while it
+ * runs waits until the hook returns.
+ *
+ * Build and run with PlatformIO (see env:native_executor in platformio.ini):
+ *   pio run -e native_executor -t exec
+ *
+ * Or with plain gcc from the repository root (also with -DMESSAGEBROKER_ASYNC_DISPATCH=1):
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c lib/Utils/custom_assert.c \
+ *       bench/messagebroker_executor_bench.c -lpthread -o messagebroker_executor_bench \
+ *       && ./messagebroker_executor_bench
+ */
+
+#define _GNU_SOURCE // SCHED_IDLE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "MessageBroker.h"
+#include "MessageDefinitions.h"
+#include "MessageRpc.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define RUN_TIME_MS        2000U
+#define UART_INTERVAL_NS   7000000U  // One desk frame every 7 ms
+#define KEY_INTERVAL_NS    53000000U // One key press every 53 ms, neither is in phase with the scans
+#define SCAN_INTERVAL_MS   100U      // Scan evaluation every 100 ms (5 s on the desk) ...
+#define SCAN_WORK_NS       3000000U  // ... that keeps the CPU busy for 3 ms
+#define QUERY_TIMEOUT_MS   100U
+#define MAX_SAMPLES        1024U
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef struct
+{
+    u64 latency_ns[MAX_SAMPLES];
+    u32 nof_samples;
+} latency_samples_t;
+
+typedef enum
+{
+    MODULE_DESKCONTROL = 0,
+    MODULE_CONSOLE,
+    MODULE_APPLICATIONCONTROL,
+    MODULE_PRESENCEDETECTOR,
+    NOF_MODULES
+} module_e;
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static latency_samples_t frame_samples; // ISR publish to the DeskControl callback
+static latency_samples_t key_samples;   // Key press to the console run hook
+static latency_samples_t query_samples; // messagerpc_call() round trip from the console
+static u32 nof_query_timeouts = 0;
+
+static atomic_bool is_running = true;
+static _Atomic u64 key_pressed_ns = 0; // 0 = no key pending
+static msg_queue_t* console_queue = NULL;
+static msg_queue_t* module_queues[NOF_MODULES];
+static u64 next_scan_ns = 0;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_add_sample(latency_samples_t* samples, u64 latency_ns)
+{
+    if (samples->nof_samples < MAX_SAMPLES)
+    {
+        samples->latency_ns[samples->nof_samples++] = latency_ns;
+    }
+}
+
+static void prv_print_samples(const char* label, latency_samples_t* samples)
+{
+    bench_stats_t stats = bench_get_stats(samples->latency_ns, samples->nof_samples);
+    printf("  %-26s | %7u | %8.1f | %8.1f | %8.1f\n", label, stats.nof_samples, stats.avg_us, stats.p99_us,
+           stats.max_us);
+}
+
+// ---------------------------------------------------------------------------
+// Modules - the same hooks run in both modes
+// ---------------------------------------------------------------------------
+static void prv_deskcontrol_callback(const msg_t* const message)
+{
+    // The payload is the time of the interrupt, 0 stops the dispatcher
+    u64 published_ns = *(const u64*)message->data_bytes;
+    if (published_ns != 0)
+    {
+        prv_add_sample(&frame_samples, bench_now_ns() - published_ns);
+    }
+}
+
+static void prv_applicationcontrol_callback(const msg_t* const message)
+{
+    msg_timer_interval_reply_t reply;
+    reply.interval_ms = 20U * 60U * 1000U;
+    messagerpc_reply(message, MSG_4004, &reply, sizeof(reply));
+}
+
+static void prv_deskcontrol_init(void)
+{
+    messagebroker_subscribe_queued(MSG_1003, prv_deskcontrol_callback, messagebroker_queue_get_context_queue());
+}
+
+static void prv_console_init(void) { console_queue = messagebroker_queue_get_context_queue(); }
+
+static void prv_applicationcontrol_init(void)
+{
+    messagebroker_subscribe_queued(MSG_4002, prv_applicationcontrol_callback, messagebroker_queue_get_context_queue());
+}
+
+static void prv_presencedetector_init(void)
+{
+    messagebroker_queue_get_context_queue();
+    next_scan_ns = bench_now_ns() + SCAN_INTERVAL_MS * 1000000ULL;
+}
+
+static u32 prv_console_run(void)
+{
+    u64 pressed_ns = atomic_exchange(&key_pressed_ns, 0);
+    if (pressed_ns != 0)
+    {
+        u64 start_ns = bench_now_ns();
+        prv_add_sample(&key_samples, start_ns - pressed_ns);
+
+        msg_timer_interval_reply_t reply;
+        if (messagerpc_call(MSG_4002, MSG_4004, &reply, sizeof(reply), QUERY_TIMEOUT_MS) == MSG_RPC_OK)
+        {
+            prv_add_sample(&query_samples, bench_now_ns() - start_ns);
+        }
+        else
+        {
+            nof_query_timeouts++;
+        }
+    }
+    return MESSAGEBROKER_WAIT_FOREVER;
+}
+
+static u32 prv_presencedetector_run(void)
+{
+    u64 now_ns = bench_now_ns();
+    if (now_ns >= next_scan_ns)
+    {
+        bench_busy_wait_ns(SCAN_WORK_NS);
+        next_scan_ns += SCAN_INTERVAL_MS * 1000000ULL;
+        now_ns = bench_now_ns();
+    }
+    return (next_scan_ns > now_ns) ? (u32)((next_scan_ns - now_ns + 999999U) / 1000000U) : 0U;
+}
+
+static void (*const module_inits[NOF_MODULES])(void) = {prv_deskcontrol_init, prv_console_init,
+                                                         prv_applicationcontrol_init, prv_presencedetector_init};
+static u32 (*const module_runs[NOF_MODULES])(void) = {NULL, prv_console_run, NULL, prv_presencedetector_run};
+
+// ---------------------------------------------------------------------------
+// Tasks
+// ---------------------------------------------------------------------------
+static void* prv_dispatcher_thread(void* arg)
+{
+    (void)arg;
+    while (atomic_load(&is_running))
+    {
+        messagebroker_isr_queue_process(MESSAGEBROKER_WAIT_FOREVER);
+    }
+    return NULL;
+}
+
+// One module per thread, like prv_<module>_task()
+static void* prv_module_thread(void* arg)
+{
+    module_e module = (module_e)(uintptr_t)arg;
+    if (module == MODULE_PRESENCEDETECTOR)
+    {
+        struct sched_param param = {0};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    }
+    module_inits[module]();
+    module_queues[module] = messagebroker_queue_get_context_queue();
+
+    while (atomic_load(&is_running))
+    {
+        u32 next_run_ms = (module_runs[module] != NULL) ? module_runs[module]() : MESSAGEBROKER_WAIT_FOREVER;
+        messagebroker_queue_process(module_queues[module], next_run_ms);
+    }
+    return NULL;
+}
+
+// All modules in one thread, like prv_executor_task()
+static void* prv_executor_thread(void* arg)
+{
+    (void)arg;
+    for (u8 i = 0; i < NOF_MODULES; i++)
+    {
+        module_inits[i]();
+    }
+    msg_queue_t* queue = messagebroker_queue_get_context_queue();
+    messagebroker_isr_queue_set_wake_queue(queue);
+    for (u8 i = 0; i < NOF_MODULES; i++)
+    {
+        module_queues[i] = queue;
+    }
+
+    while (atomic_load(&is_running))
+    {
+        messagebroker_isr_queue_process(0);
+
+        u32 wait_ms = MESSAGEBROKER_WAIT_FOREVER;
+        for (u8 i = 0; i < NOF_MODULES; i++)
+        {
+            if (module_runs[i] != NULL)
+            {
+                u32 next_run_ms = module_runs[i]();
+                wait_ms = (next_run_ms < wait_ms) ? next_run_ms : wait_ms;
+            }
+        }
+        messagebroker_queue_process(queue, wait_ms);
+    }
+    return NULL;
+}
+
+// Interrupts and the serial port: UART frames and key presses at fixed intervals
+static void* prv_stimulus_thread(void* arg)
+{
+    (void)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    u64 next_key_ns = bench_now_ns() + KEY_INTERVAL_NS;
+
+    while (atomic_load(&is_running))
+    {
+        next.tv_nsec += UART_INTERVAL_NS;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        u64 now_ns = bench_now_ns();
+        msg_t message;
+        message.msg_id = MSG_1003;
+        message.data_size = sizeof(now_ns);
+        message.data_bytes = (u8*)&now_ns;
+        messagebroker_publish_from_isr(&message);
+
+        if ((now_ns >= next_key_ns) && (console_queue != NULL))
+        {
+            atomic_store(&key_pressed_ns, now_ns);
+            messagebroker_queue_notify(console_queue);
+            next_key_ns += KEY_INTERVAL_NS;
+        }
+    }
+    return NULL;
+}
+
+static void prv_run(bool is_cooperative)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    pthread_t threads[NOF_MODULES + 1U];
+    u8 nof_threads = 0;
+    if (is_cooperative)
+    {
+        pthread_create(&threads[nof_threads++], NULL, prv_executor_thread, NULL);
+    }
+    else
+    {
+        pthread_create(&threads[nof_threads++], NULL, prv_dispatcher_thread, NULL);
+        for (u8 i = 0; i < NOF_MODULES; i++)
+        {
+            pthread_create(&threads[nof_threads++], NULL, prv_module_thread, (void*)(uintptr_t)i);
+        }
+    }
+
+    // Let every module subscribe before the first stimulus
+    struct timespec settle = {0, 50000000L};
+    nanosleep(&settle, NULL);
+
+    pthread_t stimulus;
+    pthread_create(&stimulus, NULL, prv_stimulus_thread, NULL);
+    struct timespec run_time = {RUN_TIME_MS / 1000U, (RUN_TIME_MS % 1000U) * 1000000L};
+    nanosleep(&run_time, NULL);
+    atomic_store(&is_running, false);
+    pthread_join(stimulus, NULL);
+
+    // Wake every waiting task, the tasks without a timeout only return for an event
+    u64 stop = 0;
+    msg_t message;
+    message.msg_id = MSG_1003;
+    message.data_size = sizeof(stop);
+    message.data_bytes = (u8*)&stop;
+    messagebroker_publish_from_isr(&message);
+    for (u8 i = 0; i < NOF_MODULES; i++)
+    {
+        messagebroker_queue_notify(module_queues[i]);
+    }
+    for (u8 i = 0; i < nof_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("%s (%u threads)\n", is_cooperative ? "Cooperative executor" : "One task per module", nof_threads);
+    prv_print_samples("UART frame -> DeskControl", &frame_samples);
+    prv_print_samples("key press -> Console", &key_samples);
+    prv_print_samples("Console query round trip", &query_samples);
+    if (nof_query_timeouts > 0)
+    {
+        printf("  %u query timeouts\n", nof_query_timeouts);
+    }
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    printf("Frame every %u ms, key every %u ms, %u ms scan work every %u ms, %u ms per run (ASYNC=%d)\n",
+           UART_INTERVAL_NS / 1000000U, KEY_INTERVAL_NS / 1000000U, SCAN_WORK_NS / 1000000U, SCAN_INTERVAL_MS,
+           RUN_TIME_MS, MESSAGEBROKER_ASYNC_DISPATCH);
+    printf("  %-26s | samples | avg us   | p99 us   | max us\n", "path");
+    fflush(stdout);
+
+    // The broker is initialized once per process, every mode gets a fresh one
+    for (u8 mode = 0; mode < 2U; mode++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            prv_run(mode == 1U);
+            fflush(stdout);
+            _exit(0);
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
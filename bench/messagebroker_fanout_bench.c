@@ -0,0 +1,105 @@
+/**
+ * @file messagebroker_fanout_bench.c
+ * @brief Host microbenchmark: messagebroker_publish() cost for every msg_id_e topic.
+ *
+ * The subscriptions mirror the firmware wiring (main.cpp and all modules), so topics
+ * have between zero and two subscribers. Every topic is published NOF_ITERATIONS
+ * times with synchronous delivery and the mean cost per publish is reported.
+ *
+ * Build and run with PlatformIO (see env:native_fanout in platformio.ini):
+ *   pio run -e native_fanout -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c \
+ *       lib/Utils/custom_assert.c bench/messagebroker_fanout_bench.c -lpthread \
+ *       -o messagebroker_fanout_bench && ./messagebroker_fanout_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_ITERATIONS 1000000U
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static volatile u32 nof_deliveries = 0;
+static u8 nof_topic_subscribers[E_TOPIC_LAST_TOPIC] = {0};
+
+// One callback per firmware subscriber
+static void prv_main_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_appctrl_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_timermanager_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_console_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_deskcontrol_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_presence_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+static void prv_nettime_callback(const msg_t* const message) { (void)message; nof_deliveries++; }
+
+typedef struct
+{
+    msg_id_e topic;
+    msg_callback_t callback;
+} bench_subscription_t;
+
+static const bench_subscription_t firmware_subscriptions[] = {
+    {MSG_2001, prv_main_callback},         {MSG_2002, prv_main_callback},
+    {MSG_2001, prv_appctrl_callback},      {MSG_2002, prv_appctrl_callback},
+    {MSG_3003, prv_appctrl_callback},      {MSG_0003, prv_appctrl_callback},
+    {MSG_4001, prv_appctrl_callback},      {MSG_4002, prv_appctrl_callback},
+    {MSG_4003, prv_appctrl_callback},      {MSG_3001, prv_timermanager_callback},
+    {MSG_3002, prv_timermanager_callback}, {MSG_3003, prv_console_callback},
+    {MSG_0001, prv_console_callback},      {MSG_0004, prv_deskcontrol_callback},
+    {MSG_1000, prv_deskcontrol_callback},  {MSG_1002, prv_deskcontrol_callback},
+    {MSG_1003, prv_deskcontrol_callback},
+    {MSG_0005, prv_presence_callback},     {MSG_2003, prv_presence_callback},
+    {MSG_2004, prv_presence_callback},     {MSG_0006, prv_nettime_callback},
+    {MSG_5001, prv_nettime_callback},      {MSG_5002, prv_nettime_callback},
+    {MSG_5003, prv_nettime_callback},      {MSG_5004, prv_nettime_callback},
+};
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    for (size_t i = 0; i < sizeof(firmware_subscriptions) / sizeof(firmware_subscriptions[0]); i++)
+    {
+        messagebroker_subscribe(firmware_subscriptions[i].topic, firmware_subscriptions[i].callback);
+        nof_topic_subscribers[firmware_subscriptions[i].topic]++;
+    }
+
+    printf("topic | subscribers | ns/publish\n");
+
+    u64 total_ns = 0;
+    for (u16 topic = E_TOPIC_FIRST_TOPIC + 1; topic < E_TOPIC_LAST_TOPIC; topic++)
+    {
+        msg_t msg;
+        msg.msg_id = (msg_id_e)topic;
+        msg.data_size = 0;
+        msg.data_bytes = NULL;
+
+        u64 start_ns = bench_now_ns();
+        for (u32 i = 0; i < NOF_ITERATIONS; i++)
+        {
+            messagebroker_publish(&msg);
+        }
+        u64 elapsed_ns = bench_now_ns() - start_ns;
+        total_ns += elapsed_ns;
+
+        printf("%5u | %11u | %10.2f\n", topic, nof_topic_subscribers[topic], elapsed_ns / (double)NOF_ITERATIONS);
+    }
+
+    printf("all topics: %.2f ns/publish (mean), %u deliveries\n",
+           total_ns / (double)(NOF_ITERATIONS * (E_TOPIC_LAST_TOPIC - 1)), nof_deliveries);
+    return 0;
+}
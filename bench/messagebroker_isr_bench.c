@@ -0,0 +1,192 @@
+/**
+ * @file messagebroker_isr_bench.c
+ * @brief Host benchmark: messagebroker_publish_from_isr() latency and concurrent producers.
+ *
+ * 1. Latency: a producer thread stands in for the interrupt, a dispatcher thread calls
+ *    messagebroker_isr_queue_process() like the MessageDispatcher task. Reports the time
+ *    from publish_from_isr() until the subscriber runs.
+ * 2. Producers: several threads publish bursts at the same time. Every message must either
+ *    be delivered exactly once, in order per producer, or be counted as dropped.
+ *
+ * Build and run with PlatformIO (see env:native_isr in platformio.ini):
+ *   pio run -e native_isr -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c \
+ *       lib/Utils/custom_assert.c bench/messagebroker_isr_bench.c -lpthread \
+ *       -o messagebroker_isr_bench && ./messagebroker_isr_bench
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_LATENCY_ITERATIONS 10000U
+#define NOF_PRODUCERS          4U
+#define NOF_BURST_MESSAGES     100000U
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static u64 latency_ns[NOF_LATENCY_ITERATIONS];
+static atomic_uint nof_handled = 0;
+static atomic_bool is_dispatcher_running = true;
+static pthread_t dispatcher;
+
+static u32 next_expected_sequence[NOF_PRODUCERS] = {0};
+static u32 nof_delivered[NOF_PRODUCERS] = {0};
+static u32 nof_out_of_order = 0;
+static u32 nof_dropped[NOF_PRODUCERS] = {0};
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_latency_handler(const msg_t* const message)
+{
+    u64 published_at_ns = 0;
+    memcpy(&published_at_ns, message->data_bytes, sizeof(published_at_ns));
+
+    unsigned idx = atomic_load(&nof_handled);
+    if (idx < NOF_LATENCY_ITERATIONS)
+    {
+        latency_ns[idx] = bench_now_ns() - published_at_ns;
+    }
+    atomic_fetch_add(&nof_handled, 1);
+}
+
+// Runs in the dispatcher thread only, no synchronization needed
+static void prv_burst_handler(const msg_t* const message)
+{
+    u32 producer = 0;
+    u32 sequence = 0;
+    memcpy(&producer, &message->data_bytes[0], sizeof(producer));
+    memcpy(&sequence, &message->data_bytes[4], sizeof(sequence));
+
+    // Dropped messages leave gaps, but a producer's messages never overtake each other
+    if (sequence < next_expected_sequence[producer])
+    {
+        nof_out_of_order++;
+    }
+    next_expected_sequence[producer] = sequence + 1;
+    nof_delivered[producer]++;
+}
+
+static void* prv_dispatcher_thread(void* arg)
+{
+    (void)arg;
+    while (atomic_load(&is_dispatcher_running))
+    {
+        messagebroker_isr_queue_process(10);
+    }
+    return NULL;
+}
+
+static void* prv_producer_thread(void* arg)
+{
+    u32 producer = (u32)(uintptr_t)arg;
+    for (u32 sequence = 0; sequence < NOF_BURST_MESSAGES; sequence++)
+    {
+        u8 payload[8];
+        memcpy(&payload[0], &producer, sizeof(producer));
+        memcpy(&payload[4], &sequence, sizeof(sequence));
+
+        msg_t msg;
+        msg.msg_id = MSG_0002;
+        msg.data_size = sizeof(payload);
+        msg.data_bytes = payload;
+
+        if (!messagebroker_publish_from_isr(&msg))
+        {
+            nof_dropped[producer]++;
+            sched_yield(); // Give the dispatcher a chance, like an idle interrupt source would
+        }
+    }
+    return NULL;
+}
+
+static void prv_run_latency(void)
+{
+    for (u32 i = 0; i < NOF_LATENCY_ITERATIONS; i++)
+    {
+        u64 published_at_ns = bench_now_ns();
+
+        msg_t msg;
+        msg.msg_id = MSG_0001;
+        msg.data_size = sizeof(published_at_ns);
+        msg.data_bytes = (u8*)&published_at_ns;
+
+        bool is_published = messagebroker_publish_from_isr(&msg);
+        ASSERT(is_published);
+
+        while (atomic_load(&nof_handled) <= i)
+        {
+            sched_yield();
+        }
+    }
+
+    printf("publish_from_isr -> subscriber (%u messages)\n", NOF_LATENCY_ITERATIONS);
+    bench_print_stats("latency:", latency_ns, NOF_LATENCY_ITERATIONS);
+}
+
+static bool prv_run_producers(void)
+{
+    pthread_t producers[NOF_PRODUCERS];
+    for (u32 i = 0; i < NOF_PRODUCERS; i++)
+    {
+        pthread_create(&producers[i], NULL, prv_producer_thread, (void*)(uintptr_t)i);
+    }
+    for (u32 i = 0; i < NOF_PRODUCERS; i++)
+    {
+        pthread_join(producers[i], NULL);
+    }
+
+    // Let the dispatcher drain what is left in the ring, then stop it before reading its counters
+    struct timespec settle = {0, 50 * 1000000L};
+    nanosleep(&settle, NULL);
+    atomic_store(&is_dispatcher_running, false);
+    pthread_join(dispatcher, NULL);
+
+    bool is_consistent = (nof_out_of_order == 0);
+    u32 total_dropped = 0;
+
+    printf("%u producers x %u messages\n", NOF_PRODUCERS, NOF_BURST_MESSAGES);
+    for (u32 i = 0; i < NOF_PRODUCERS; i++)
+    {
+        printf("  producer %u: delivered %u, dropped %u\n", i, nof_delivered[i], nof_dropped[i]);
+        is_consistent = is_consistent && ((nof_delivered[i] + nof_dropped[i]) == NOF_BURST_MESSAGES);
+        total_dropped += nof_dropped[i];
+    }
+    is_consistent = is_consistent && (total_dropped == messagebroker_isr_queue_get_dropped_count());
+
+    printf("  out of order: %u -> %s\n", nof_out_of_order, is_consistent ? "OK" : "FAILED");
+    return is_consistent;
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    messagebroker_subscribe(MSG_0001, prv_latency_handler);
+    messagebroker_subscribe(MSG_0002, prv_burst_handler);
+
+    pthread_create(&dispatcher, NULL, prv_dispatcher_thread, NULL);
+
+    prv_run_latency();
+    bool is_consistent = prv_run_producers();
+
+    return is_consistent ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file messagebroker_priority_bench.c
+ * @brief Host benchmark: desk command latency while a console user floods the queue with queries.
+ *
+ * One subscriber task - like DeskControl - handles desk commands (MSG_1000, high priority)
+ * and height queries (MSG_1002, low priority) from one queue. A flood thread publishes
+ * bursts of queries faster than the task can answer them, a command thread publishes a desk
+ * command every millisecond. Both sleep between their publishes, so the benchmark also runs
+ * on a single core. Reported per topic: deliveries, drops and the wait from the publish to
+ * the start of the callback (avg, p99, max).
+ *
+ * The baseline run sends the commands on MSG_0002, a low priority topic, so they share the
+ * flooded lane like they would share a single FIFO queue.
+ *
+ * Build and run with PlatformIO (see env:native_priority in platformio.ini):
+ *   pio run -e native_priority -t exec
+ *
+ * Or with plain gcc from the repository root (add -DMESSAGEBROKER_INSTRUMENTATION=1 for the lane stats
+ * of the broker):
+ *   gcc -O2 -std=gnu11 -DMESSAGEBROKER_ASYNC_DISPATCH=1 -Ilib/MessageBroker -Ilib/Utils \
+ *       lib/MessageBroker/Message*.c lib/Utils/custom_assert.c bench/messagebroker_priority_bench.c \
+ *       -lpthread -o messagebroker_priority_bench && ./messagebroker_priority_bench
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+#if !defined(MESSAGEBROKER_ASYNC_DISPATCH) || (MESSAGEBROKER_ASYNC_DISPATCH == 0)
+#error "Build with -DMESSAGEBROKER_ASYNC_DISPATCH=1, priority lanes only apply to queued deliveries"
+#endif
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define RUN_TIME_MS          1000U
+#define PUBLISH_INTERVAL_NS  1000000U // One desk command and one query burst per ms
+#define QUERY_BURST_LENGTH   50U      // 2.5x more queries than the handler can answer
+#define COMMAND_DELAY_NS     50000U   // Commands are published 50 us after a query burst
+#define HANDLER_WORK_NS      50000U   // Simulated handler work (50 us)
+#define MAX_SAMPLES          32768U
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef struct
+{
+    u64 wait_ns[MAX_SAMPLES];
+    atomic_uint nof_samples;
+    atomic_uint nof_published;
+} topic_samples_t;
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static topic_samples_t command_samples;
+static topic_samples_t query_samples;
+static msg_id_e command_topic = MSG_1000;
+static atomic_bool is_running = true;
+static atomic_bool is_consumer_running = true;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_handler(const msg_t* const message)
+{
+    // The payload is the publish time
+    u64 wait_ns = bench_now_ns() - *(const u64*)message->data_bytes;
+    topic_samples_t* samples = (message->msg_id == MSG_1002) ? &query_samples : &command_samples;
+
+    u32 index = atomic_fetch_add(&samples->nof_samples, 1);
+    if (index < MAX_SAMPLES)
+    {
+        samples->wait_ns[index] = wait_ns;
+    }
+    bench_busy_wait_ns(HANDLER_WORK_NS);
+}
+
+static void prv_publish_now(msg_id_e topic)
+{
+    u64 publish_ns = bench_now_ns();
+
+    msg_t message;
+    message.msg_id = topic;
+    message.data_size = sizeof(publish_ns);
+    message.data_bytes = (u8*)&publish_ns;
+    messagebroker_publish(&message);
+}
+
+static void* prv_publisher_thread(void* arg)
+{
+    bool is_flood = (arg != NULL);
+    msg_id_e topic = is_flood ? MSG_1002 : command_topic;
+    topic_samples_t* samples = is_flood ? &query_samples : &command_samples;
+    u32 burst_length = is_flood ? QUERY_BURST_LENGTH : 1U;
+
+    // Commands follow a query burst closely, so that they arrive while the queue is full
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    next.tv_nsec += is_flood ? 0 : (long)COMMAND_DELAY_NS;
+
+    while (atomic_load_explicit(&is_running, memory_order_relaxed))
+    {
+        for (u32 i = 0; i < burst_length; i++)
+        {
+            prv_publish_now(topic);
+        }
+        atomic_fetch_add(&samples->nof_published, burst_length);
+
+        next.tv_nsec += PUBLISH_INTERVAL_NS;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+static void* prv_consumer_thread(void* arg)
+{
+    msg_queue_t* queue = (msg_queue_t*)arg;
+    while (atomic_load(&is_consumer_running))
+    {
+        messagebroker_queue_process(queue, 10);
+    }
+    return NULL;
+}
+
+static void prv_print_samples(const char* label, topic_samples_t* samples)
+{
+    u32 nof_published = atomic_load(&samples->nof_published);
+    u32 nof_samples = atomic_load(&samples->nof_samples);
+    u32 nof_stored = (nof_samples < MAX_SAMPLES) ? nof_samples : MAX_SAMPLES;
+
+    bench_stats_t stats = bench_get_stats(samples->wait_ns, nof_stored);
+    printf("  %-28s | %9u | %7u | %8.1f | %8.1f | %8.1f\n", label, nof_samples, nof_published - nof_samples,
+           stats.avg_us, stats.p99_us, stats.max_us);
+}
+
+static void prv_run(msg_id_e topic, bool is_flooded, const char* label)
+{
+    atomic_store(&command_samples.nof_samples, 0);
+    atomic_store(&command_samples.nof_published, 0);
+    atomic_store(&query_samples.nof_samples, 0);
+    atomic_store(&query_samples.nof_published, 0);
+    command_topic = topic;
+    atomic_store(&is_running, true);
+
+    pthread_t command_thread;
+    pthread_t flood_thread;
+    pthread_create(&command_thread, NULL, prv_publisher_thread, NULL);
+    if (is_flooded)
+    {
+        pthread_create(&flood_thread, NULL, prv_publisher_thread, (void*)1);
+    }
+
+    struct timespec run_time = {RUN_TIME_MS / 1000U, (RUN_TIME_MS % 1000U) * 1000000L};
+    nanosleep(&run_time, NULL);
+    atomic_store(&is_running, false);
+
+    pthread_join(command_thread, NULL);
+    if (is_flooded)
+    {
+        pthread_join(flood_thread, NULL);
+    }
+
+    // Let the consumer drain the queue
+    bench_busy_wait_ns(MESSAGEBROKER_QUEUE_DEPTH * E_MSG_PRIORITY_COUNT * HANDLER_WORK_NS * 2U);
+
+    printf("%s\n", label);
+    prv_print_samples("commands", &command_samples);
+    if (is_flooded)
+    {
+        prv_print_samples("queries", &query_samples);
+    }
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    msg_queue_t* queue = messagebroker_queue_create();
+    messagebroker_subscribe_queued(MSG_1000, prv_handler, queue);
+    messagebroker_subscribe_queued(MSG_0002, prv_handler, queue);
+    messagebroker_subscribe_queued(MSG_1002, prv_handler, queue);
+
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, prv_consumer_thread, queue);
+
+    printf("Every %u us: 1 command, %u queries. %u us handler work, %u entries per lane, %u ms per run\n",
+           PUBLISH_INTERVAL_NS / 1000U, QUERY_BURST_LENGTH, HANDLER_WORK_NS / 1000U, MESSAGEBROKER_QUEUE_DEPTH,
+           RUN_TIME_MS);
+    printf("  %-28s | delivered | dropped | avg us   | p99 us   | max us\n", "topic");
+    prv_run(MSG_1000, false, "Idle, commands on the high lane");
+    prv_run(MSG_0002, true, "Flood, commands share the query lane");
+    prv_run(MSG_1000, true, "Flood, commands on the high lane");
+
+#if MESSAGEBROKER_INSTRUMENTATION
+    static const char* const lane_names[E_MSG_PRIORITY_COUNT] = {"normal", "high", "low"};
+    printf("Broker lane stats (cycles = ns on the host)\n");
+    for (u8 priority = 0; priority < E_MSG_PRIORITY_COUNT; priority++)
+    {
+        msg_lane_stats_t lane_stats;
+        messagebroker_get_lane_stats((msg_priority_e)priority, &lane_stats);
+        printf("  %-6s: %u deliveries, %u dropped, max wait %u\n", lane_names[priority], lane_stats.nof_deliveries,
+               lane_stats.nof_dropped, lane_stats.max_wait_cycles);
+    }
+#endif
+
+    atomic_store(&is_consumer_running, false);
+    pthread_join(consumer, NULL);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file messagebroker_reentrancy_bench.c
+ * @brief Host benchmark: stack high-water mark of chained publishes from inside callbacks.
+ *
+ * Every topic of a chain has one subscriber, which publishes the next topic of the chain.
+ * The chain runs in a thread with a painted stack, the unused stack is measured the same
+ * way as FreeRTOS' uxTaskGetStackHighWaterMark() does (fill byte 0xA5, counted from the
+ * far end). The delivery order is checked against the expected order.
+ *
+ * Build and run with PlatformIO (see env:native_reentrancy in platformio.ini):
+ *   pio run -e native_reentrancy -t exec
+ *
+ * Or with plain gcc, twice from the repository root, nested (0) and deferred (1) publishes:
+ *   gcc -O2 -std=gnu11 -DMESSAGEBROKER_DEFER_NESTED_PUBLISH=1 -Ilib/MessageBroker -Ilib/Utils \
+ *       lib/MessageBroker/Message*.c lib/Utils/custom_assert.c bench/messagebroker_reentrancy_bench.c \
+ *       -lpthread -o messagebroker_reentrancy_bench && ./messagebroker_reentrancy_bench
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define THREAD_STACK_SIZE     (256U * 1024U)
+#define STACK_FILL_BYTE       0xA5U
+#define CALLBACK_FRAME_SIZE   256U // Local buffer of each callback, like a Serial print buffer
+#define MAX_CHAIN_LENGTH      24U
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static const msg_id_e chain_topics[MAX_CHAIN_LENGTH] = {
+    MSG_0001, MSG_0002, MSG_0003, MSG_0004, MSG_0005, MSG_0006, MSG_1000, MSG_1001,
+    MSG_1002, MSG_1003, MSG_2003, MSG_2004, MSG_3001, MSG_3002, MSG_3003, MSG_4001,
+    MSG_4002, MSG_4003, MSG_5001, MSG_5002, MSG_5003, MSG_5004, MSG_2001, MSG_2002,
+};
+
+static u8 chain_length = 0;
+static u8 chain_position[E_TOPIC_LAST_TOPIC];
+static msg_id_e delivery_order[MAX_CHAIN_LENGTH];
+static u8 nof_deliveries = 0;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static void prv_chain_callback(const msg_t* const message)
+{
+    // Keep a realistic frame alive while the next topic is published
+    volatile u8 frame[CALLBACK_FRAME_SIZE];
+    frame[0] = (u8)message->msg_id;
+
+    delivery_order[nof_deliveries++] = message->msg_id;
+
+    u8 position = chain_position[message->msg_id];
+    if (position + 1U < chain_length)
+    {
+        u32 next_position = position + 1U;
+
+        msg_t next;
+        next.msg_id = chain_topics[next_position];
+        next.data_size = sizeof(next_position);
+        next.data_bytes = (u8*)&next_position;
+        messagebroker_publish(&next);
+    }
+
+    frame[CALLBACK_FRAME_SIZE - 1U] = frame[0];
+}
+
+static void* prv_chain_thread(void* arg)
+{
+    (void)arg;
+
+    msg_t first;
+    first.msg_id = chain_topics[0];
+    first.data_size = 0;
+    first.data_bytes = NULL;
+    messagebroker_publish(&first);
+
+    return NULL;
+}
+
+// Unused stack in bytes, counted from the far end like uxTaskGetStackHighWaterMark()
+static size_t prv_get_stack_high_water_mark(const u8* stack, size_t size)
+{
+    size_t unused = 0;
+    while ((unused < size) && (stack[unused] == STACK_FILL_BYTE))
+    {
+        unused++;
+    }
+    return unused;
+}
+
+static size_t prv_run_chain(u8 length)
+{
+    chain_length = length;
+    nof_deliveries = 0;
+
+    u8* stack = NULL;
+    int status = posix_memalign((void**)&stack, 4096, THREAD_STACK_SIZE);
+    ASSERT(status == 0);
+    memset(stack, STACK_FILL_BYTE, THREAD_STACK_SIZE);
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, stack, THREAD_STACK_SIZE);
+
+    pthread_t thread;
+    pthread_create(&thread, &attributes, prv_chain_thread, NULL);
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attributes);
+
+    size_t used = THREAD_STACK_SIZE - prv_get_stack_high_water_mark(stack, THREAD_STACK_SIZE);
+    free(stack);
+
+    // Each topic of the chain is delivered exactly once and in chain order
+    ASSERT(nof_deliveries == length);
+    for (u8 i = 0; i < length; i++)
+    {
+        ASSERT(delivery_order[i] == chain_topics[i]);
+    }
+
+    return used;
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    for (u8 i = 0; i < MAX_CHAIN_LENGTH; i++)
+    {
+        chain_position[chain_topics[i]] = i;
+        messagebroker_subscribe(chain_topics[i], prv_chain_callback);
+    }
+
+    // Warm up, so lazy symbol binding of the first calls does not show up in the stack peak
+    (void)prv_run_chain(MAX_CHAIN_LENGTH);
+
+    printf("MESSAGEBROKER_DEFER_NESTED_PUBLISH=%d (%u byte callback frames)\n", MESSAGEBROKER_DEFER_NESTED_PUBLISH,
+           CALLBACK_FRAME_SIZE);
+    printf("chain length | peak stack [bytes]\n");
+
+    const u8 chain_lengths[] = {1, 2, 4, 8, 16, MAX_CHAIN_LENGTH};
+    for (size_t i = 0; i < sizeof(chain_lengths); i++)
+    {
+        printf("%12u | %18zu\n", chain_lengths[i], prv_run_chain(chain_lengths[i]));
+    }
+
+    return 0;
+}
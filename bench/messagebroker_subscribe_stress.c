@@ -0,0 +1,260 @@
+/**
+ * @file messagebroker_subscribe_stress.c
+ * @brief Host stress test: concurrent publish, subscribe and unsubscribe from several pthreads.
+ *
+ * Publisher threads publish round robin on a set of topics while churn threads keep
+ * subscribing and unsubscribing their own callbacks. Checked:
+ * - a callback is never called after messagebroker_unsubscribe() + messagebroker_synchronize()
+ * - a subscriber that stays subscribed gets every publish of its topic, no matter how the
+ *   other subscriptions of that topic change in the meantime
+ * Reported: publish throughput with and without churn and the grace period latency.
+ * Returns non-zero if a check fails.
+ *
+ * Build and run with PlatformIO (see env:native_subscribe_stress in platformio.ini):
+ *   pio run -e native_subscribe_stress -t exec
+ *
+ * Or with plain gcc from the repository root (add -fsanitize=thread to check the memory ordering):
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c lib/Utils/custom_assert.c \
+ *       bench/messagebroker_subscribe_stress.c -lpthread -o messagebroker_subscribe_stress \
+ *       && ./messagebroker_subscribe_stress
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+#if MESSAGEBROKER_STATIC_ROUTES
+#error "Build with -DMESSAGEBROKER_STATIC_ROUTES=0, static routes cannot change at runtime"
+#endif
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_PUBLISHERS  3U
+#define NOF_CHURNERS    4U
+#define RUN_TIME_MS     2000U
+#define NOF_TOPICS      4U
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef enum
+{
+    SUBSCRIPTION_SUBSCRIBED = 0,
+    SUBSCRIPTION_UNSUBSCRIBED, // Removed, but a running publish may still deliver
+    SUBSCRIPTION_RETIRED,      // Synchronized, a delivery now is a bug
+} subscription_state_e;
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static const msg_id_e topics[NOF_TOPICS] = {MSG_0001, MSG_0002, MSG_1001, MSG_3002};
+
+static atomic_bool is_running = true;
+static atomic_uint nof_publishes[NOF_TOPICS];
+static atomic_uint nof_stable_deliveries[NOF_TOPICS];
+static atomic_uint nof_churn_deliveries = 0;
+static atomic_uint nof_late_deliveries = 0;
+static atomic_uint nof_churn_cycles = 0;
+static atomic_int subscription_states[NOF_CHURNERS][NOF_TOPICS];
+static u64 max_synchronize_ns = 0;
+static u64 total_synchronize_ns = 0;
+static u32 nof_synchronizes = 0;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static u8 prv_topic_index(msg_id_e msg_id)
+{
+    for (u8 i = 0; i < NOF_TOPICS; i++)
+    {
+        if (topics[i] == msg_id)
+        {
+            return i;
+        }
+    }
+    ASSERT(false);
+    return 0;
+}
+
+static void prv_stable_callback(const msg_t* const message)
+{
+    atomic_fetch_add(&nof_stable_deliveries[prv_topic_index(message->msg_id)], 1);
+}
+
+static void prv_churn_delivery(u8 churner, const msg_t* const message)
+{
+    atomic_fetch_add(&nof_churn_deliveries, 1);
+    if (atomic_load(&subscription_states[churner][prv_topic_index(message->msg_id)]) == SUBSCRIPTION_RETIRED)
+    {
+        atomic_fetch_add(&nof_late_deliveries, 1);
+    }
+}
+
+// One distinct callback per churn thread, the broker tells subscribers apart by their callback
+static void prv_churn_callback_0(const msg_t* const message) { prv_churn_delivery(0, message); }
+static void prv_churn_callback_1(const msg_t* const message) { prv_churn_delivery(1, message); }
+static void prv_churn_callback_2(const msg_t* const message) { prv_churn_delivery(2, message); }
+static void prv_churn_callback_3(const msg_t* const message) { prv_churn_delivery(3, message); }
+
+static const msg_callback_t churn_callbacks[NOF_CHURNERS] = {prv_churn_callback_0, prv_churn_callback_1,
+                                                             prv_churn_callback_2, prv_churn_callback_3};
+
+static void* prv_publisher_thread(void* arg)
+{
+    u32 next = (u32)(uintptr_t)arg;
+    u32 value = 0;
+
+    while (atomic_load_explicit(&is_running, memory_order_relaxed))
+    {
+        u8 topic_index = (u8)(next++ % NOF_TOPICS);
+
+        msg_t message;
+        message.msg_id = topics[topic_index];
+        message.data_size = sizeof(value);
+        message.data_bytes = (u8*)&value;
+        value++;
+
+        messagebroker_publish(&message);
+        atomic_fetch_add_explicit(&nof_publishes[topic_index], 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static void* prv_churn_thread(void* arg)
+{
+    u8 churner = (u8)(uintptr_t)arg;
+    msg_callback_t callback = churn_callbacks[churner];
+    u32 cycle = 0;
+
+    for (u8 t = 0; t < NOF_TOPICS; t++)
+    {
+        atomic_store(&subscription_states[churner][t], SUBSCRIPTION_RETIRED);
+    }
+
+    while (atomic_load_explicit(&is_running, memory_order_relaxed))
+    {
+        u8 topic_index = (u8)((churner + cycle++) % NOF_TOPICS);
+
+        atomic_store(&subscription_states[churner][topic_index], SUBSCRIPTION_SUBSCRIBED);
+        messagebroker_subscribe(topics[topic_index], callback);
+
+        messagebroker_unsubscribe(topics[topic_index], callback);
+        atomic_store(&subscription_states[churner][topic_index], SUBSCRIPTION_UNSUBSCRIBED);
+
+        // Every other cycle waits for the grace period, the others leave it to later cycles
+        if ((cycle % 2U) == 0U)
+        {
+            u64 start_ns = bench_now_ns();
+            messagebroker_synchronize();
+            u64 duration_ns = bench_now_ns() - start_ns;
+
+            for (u8 t = 0; t < NOF_TOPICS; t++)
+            {
+                int expected = SUBSCRIPTION_UNSUBSCRIBED;
+                atomic_compare_exchange_strong(&subscription_states[churner][t], &expected, SUBSCRIPTION_RETIRED);
+            }
+
+            pthread_mutex_lock(&stats_mutex);
+            total_synchronize_ns += duration_ns;
+            max_synchronize_ns = (duration_ns > max_synchronize_ns) ? duration_ns : max_synchronize_ns;
+            nof_synchronizes++;
+            pthread_mutex_unlock(&stats_mutex);
+        }
+        atomic_fetch_add_explicit(&nof_churn_cycles, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static u32 prv_run(u8 nof_churners, const char* label)
+{
+    for (u8 t = 0; t < NOF_TOPICS; t++)
+    {
+        atomic_store(&nof_publishes[t], 0);
+        atomic_store(&nof_stable_deliveries[t], 0);
+    }
+    atomic_store(&nof_churn_deliveries, 0);
+    atomic_store(&nof_churn_cycles, 0);
+    atomic_store(&is_running, true);
+
+    pthread_t publishers[NOF_PUBLISHERS];
+    pthread_t churners[NOF_CHURNERS];
+    for (u8 i = 0; i < NOF_PUBLISHERS; i++)
+    {
+        pthread_create(&publishers[i], NULL, prv_publisher_thread, (void*)(uintptr_t)i);
+    }
+    for (u8 i = 0; i < nof_churners; i++)
+    {
+        pthread_create(&churners[i], NULL, prv_churn_thread, (void*)(uintptr_t)i);
+    }
+
+    struct timespec run_time = {RUN_TIME_MS / 1000U, (RUN_TIME_MS % 1000U) * 1000000L};
+    nanosleep(&run_time, NULL);
+    atomic_store(&is_running, false);
+
+    for (u8 i = 0; i < NOF_PUBLISHERS; i++)
+    {
+        pthread_join(publishers[i], NULL);
+    }
+    for (u8 i = 0; i < nof_churners; i++)
+    {
+        pthread_join(churners[i], NULL);
+    }
+
+    u32 nof_failures = 0;
+    u32 total_publishes = 0;
+    for (u8 t = 0; t < NOF_TOPICS; t++)
+    {
+        u32 published = atomic_load(&nof_publishes[t]);
+        u32 delivered = atomic_load(&nof_stable_deliveries[t]);
+        total_publishes += published;
+        if (published != delivered)
+        {
+            printf("  FAIL topic %u: %u publishes, %u deliveries to the stable subscriber\n", topics[t], published,
+                   delivered);
+            nof_failures++;
+        }
+    }
+
+    printf("  %-15s | %11.0f | %11u | %12u\n", label, (double)total_publishes * 1000.0 / RUN_TIME_MS,
+           atomic_load(&nof_churn_cycles) * 1000U / RUN_TIME_MS, atomic_load(&nof_churn_deliveries));
+    return nof_failures;
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    for (u8 t = 0; t < NOF_TOPICS; t++)
+    {
+        messagebroker_subscribe(topics[t], prv_stable_callback);
+    }
+
+    printf("%u publisher threads, %u topics, %u ms per run\n", NOF_PUBLISHERS, NOF_TOPICS, RUN_TIME_MS);
+    printf("  %-15s | publishes/s | sub+unsub/s | churn deliv.\n", "run");
+    u32 nof_failures = prv_run(0, "no churn");
+    nof_failures += prv_run(NOF_CHURNERS, "4 churn threads");
+
+    u32 nof_late = atomic_load(&nof_late_deliveries);
+    if (nof_late > 0)
+    {
+        printf("  FAIL %u deliveries after unsubscribe and synchronize\n", nof_late);
+        nof_failures++;
+    }
+
+    printf("Grace period: %u synchronizes, avg %.1f us, max %.1f us\n", nof_synchronizes,
+           (nof_synchronizes > 0) ? (double)total_synchronize_ns / nof_synchronizes / 1000.0 : 0.0,
+           (double)max_synchronize_ns / 1000.0);
+    printf("%s\n", (nof_failures == 0) ? "PASS" : "FAIL");
+    return (nof_failures == 0) ? 0 : 1;
+}
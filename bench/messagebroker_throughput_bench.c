@@ -0,0 +1,201 @@
+/**
+ * @file messagebroker_throughput_bench.c
+ * @brief Host benchmark suite: publish throughput, fan-out scaling and memory footprint.
+ *
+ * 1. Subscribers: one topic with 1 .. 10 synchronous subscribers, publishes per second
+ *    and cost per delivery.
+ * 2. Topics: one subscriber per topic, publishing round robin across 1 .. 12 topics. The
+ *    routing is a table lookup, so the cost per publish should not grow with the topic count.
+ * 3. Request/reply: messagerpc_call() against a responder that answers synchronously, the
+ *    cost of a remote interface polling a state value.
+ * 4. Memory: the statically allocated RAM of the broker for the configuration it was built with.
+ *
+ * Build and run with PlatformIO (see env:native in platformio.ini):
+ *   pio run -e native -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c \
+ *       lib/Utils/custom_assert.c bench/messagebroker_throughput_bench.c -lpthread \
+ *       -o messagebroker_throughput_bench && ./messagebroker_throughput_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "MessageDefinitions.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+#if MESSAGEBROKER_STATIC_ROUTES
+#error "The benchmark subscribes at runtime, build with -DMESSAGEBROKER_STATIC_ROUTES=0"
+#endif
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_ITERATIONS      2000000U
+#define MAX_NOF_SUBSCRIBERS 10U
+#define PAYLOAD_SIZE        4U
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static volatile u32 nof_deliveries = 0;
+
+#define BENCH_CALLBACK(n) \
+    static void prv_callback_##n(const msg_t* const message) { (void)message; nof_deliveries++; }
+BENCH_CALLBACK(0)
+BENCH_CALLBACK(1)
+BENCH_CALLBACK(2)
+BENCH_CALLBACK(3)
+BENCH_CALLBACK(4)
+BENCH_CALLBACK(5)
+BENCH_CALLBACK(6)
+BENCH_CALLBACK(7)
+BENCH_CALLBACK(8)
+BENCH_CALLBACK(9)
+
+static const msg_callback_t callbacks[MAX_NOF_SUBSCRIBERS] = {
+    prv_callback_0, prv_callback_1, prv_callback_2, prv_callback_3, prv_callback_4,
+    prv_callback_5, prv_callback_6, prv_callback_7, prv_callback_8, prv_callback_9,
+};
+
+// Topic i has i + 1 subscribers
+static const msg_id_e subscriber_topics[MAX_NOF_SUBSCRIBERS] = {
+    MSG_0001, MSG_0002, MSG_0003, MSG_0004, MSG_0005, MSG_0006, MSG_1000, MSG_1001, MSG_1002, MSG_1003,
+};
+
+// One subscriber each, retained topics are left out since they take the broker lock
+static const msg_id_e scaling_topics[] = {
+    MSG_2003, MSG_2004, MSG_3001, MSG_3002, MSG_3003, MSG_4001,
+    MSG_4002, MSG_4003, MSG_5001, MSG_5002, MSG_5003, MSG_5004,
+};
+#define NOF_SCALING_TOPICS (sizeof(scaling_topics) / sizeof(scaling_topics[0]))
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+// Publishes NOF_ITERATIONS messages round robin across the topics, returns ns per publish
+static double prv_measure(const msg_id_e* topics, u8 nof_topics)
+{
+    u8 payload[PAYLOAD_SIZE] = {0};
+    msg_t msg;
+    msg.data_size = sizeof(payload);
+    msg.data_bytes = payload;
+
+    u64 start_ns = bench_now_ns();
+    for (u32 i = 0; i < NOF_ITERATIONS; i++)
+    {
+        msg.msg_id = topics[i % nof_topics];
+        messagebroker_publish(&msg);
+    }
+    u64 elapsed_ns = bench_now_ns() - start_ns;
+
+    return (double)elapsed_ns / NOF_ITERATIONS;
+}
+
+static void prv_run_subscriber_sweep(void)
+{
+    for (u8 i = 0; i < MAX_NOF_SUBSCRIBERS; i++)
+    {
+        for (u8 subscriber = 0; subscriber <= i; subscriber++)
+        {
+            messagebroker_subscribe(subscriber_topics[i], callbacks[subscriber]);
+        }
+    }
+
+    printf("Publish throughput by subscriber count (%u byte payload)\n", PAYLOAD_SIZE);
+    printf("  subscribers | ns/publish | ns/delivery | publishes/s\n");
+    for (u8 i = 0; i < MAX_NOF_SUBSCRIBERS; i++)
+    {
+        u32 deliveries_before = nof_deliveries;
+        double ns_per_publish = prv_measure(&subscriber_topics[i], 1);
+        ASSERT((nof_deliveries - deliveries_before) == NOF_ITERATIONS * (i + 1U));
+
+        printf("  %11u | %10.2f | %11.2f | %11.0f\n", i + 1U, ns_per_publish, ns_per_publish / (i + 1U),
+               1e9 / ns_per_publish);
+    }
+}
+
+static void prv_run_topic_scaling(void)
+{
+    for (u8 i = 0; i < NOF_SCALING_TOPICS; i++)
+    {
+        messagebroker_subscribe(scaling_topics[i], callbacks[0]);
+    }
+
+    printf("Fan-out scaling by topic count (1 subscriber per topic, round robin)\n");
+    printf("  topics | ns/publish | publishes/s\n");
+    const u8 topic_counts[] = {1, 2, 4, 8, NOF_SCALING_TOPICS};
+    for (u8 i = 0; i < sizeof(topic_counts); i++)
+    {
+        double ns_per_publish = prv_measure(scaling_topics, topic_counts[i]);
+        printf("  %6u | %10.2f | %11.0f\n", topic_counts[i], ns_per_publish, 1e9 / ns_per_publish);
+    }
+}
+
+static void prv_timer_interval_responder(const msg_t* const message)
+{
+    msg_timer_interval_reply_t reply;
+    reply.interval_ms = 20U * 60U * 1000U;
+    messagerpc_reply(message, MSG_4004, &reply, sizeof(reply));
+}
+
+static void prv_run_request_reply(void)
+{
+    messagebroker_subscribe(MSG_4002, prv_timer_interval_responder);
+
+    msg_timer_interval_reply_t reply;
+    u64 start_ns = bench_now_ns();
+    for (u32 i = 0; i < NOF_ITERATIONS; i++)
+    {
+        msg_rpc_status_e status = messagerpc_call(MSG_4002, MSG_4004, &reply, sizeof(reply), 100);
+        ASSERT(status == MSG_RPC_OK);
+    }
+    double ns_per_call = (double)(bench_now_ns() - start_ns) / NOF_ITERATIONS;
+
+    printf("Request/reply round trip (synchronous responder)\n");
+    printf("  ns/call | calls/s\n");
+    printf("  %7.2f | %7.0f\n", ns_per_call, 1e9 / ns_per_call);
+}
+
+static void prv_print_memory_footprint(void)
+{
+    msg_memory_footprint_t footprint;
+    messagebroker_get_memory_footprint(&footprint);
+
+    printf("Static RAM footprint (ASYNC=%d STATIC_ROUTES=%d DEFER=%d INSTRUMENTATION=%d TRACE=%d)\n",
+           MESSAGEBROKER_ASYNC_DISPATCH, MESSAGEBROKER_STATIC_ROUTES, MESSAGEBROKER_DEFER_NESTED_PUBLISH,
+           MESSAGEBROKER_INSTRUMENTATION, MESSAGEBROKER_TRACE);
+    printf("  routing          %6u B\n", footprint.routing_bytes);
+    printf("  retained topics  %6u B\n", footprint.retained_bytes);
+    printf("  queue pool       %6u B (%u queues x %u entries)\n", footprint.queue_pool_bytes, MESSAGEBROKER_MAX_QUEUES,
+           MESSAGEBROKER_QUEUE_DEPTH);
+    printf("  isr ring         %6u B (%u slots)\n", footprint.isr_ring_bytes, MESSAGEBROKER_ISR_QUEUE_DEPTH);
+    printf("  dispatch table   %6u B\n", footprint.dispatch_bytes);
+    printf("  instrumentation  %6u B\n", footprint.instrumentation_bytes);
+    printf("  trace ring       %6u B (%u records)\n", footprint.trace_bytes, MESSAGEBROKER_TRACE_DEPTH);
+    printf("  rpc calls        %6u B (%u pending)\n", footprint.rpc_bytes, MESSAGEBROKER_RPC_MAX_PENDING);
+    printf("  payload pool     %6u B (%u blocks x %u B)\n", footprint.payload_pool_bytes, MESSAGEPOOL_NOF_BLOCKS,
+           MESSAGEPOOL_BLOCK_SIZE);
+    printf("  total            %6u B\n", footprint.total_bytes);
+    printf("  + per publishing task stack: %u B deferred FIFO\n", footprint.deferred_fifo_stack_bytes);
+    printf("  (pointer size %u B on this host, 4 B on the ESP32-C6)\n", (u32)sizeof(void*));
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    prv_run_subscriber_sweep();
+    prv_run_topic_scaling();
+    prv_run_request_reply();
+    prv_print_memory_footprint();
+
+    return 0;
+}
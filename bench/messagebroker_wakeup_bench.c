@@ -0,0 +1,200 @@
+/**
+ * @file messagebroker_wakeup_bench.c
+ * @brief Host benchmark: task wake-ups of an idle desk, polling loops against event-driven tasks.
+ *
+ * One thread per module task waits in messagebroker_queue_process() on its own queue:
+ * - polling: the timeouts of the former task loops (5 ms for Console, ApplicationControl and
+ *   PresenceDetector, 1 s for NetworkTime)
+ * - event-driven: the tasks sleep until a message, messagebroker_queue_notify() or their own
+ *   next deadline (PresenceDetector scan evaluation every 5 s, NetworkTime sync every hour)
+ * A typing thread stands in for the serial port and presses a key every 100 ms, the console
+ * task measures how long the key waited. Reported: wake-ups per second per task (counted by
+ * the broker, see messagebroker_get_queue_stats()), process CPU time and key latency.
+ *
+ * Build and run with PlatformIO (see env:native_wakeup in platformio.ini):
+ *   pio run -e native_wakeup -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -Ilib/MessageBroker -Ilib/Utils lib/MessageBroker/Message*.c lib/Utils/custom_assert.c \
+ *       bench/messagebroker_wakeup_bench.c -lpthread -o messagebroker_wakeup_bench && ./messagebroker_wakeup_bench
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "MessageBroker.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define RUN_TIME_MS       3000U
+#define KEY_INTERVAL_MS   100U
+#define NOF_TASKS         6U
+#define CONSOLE_TASK      0U
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef struct
+{
+    const char* name;
+    u32 polling_timeout_ms;
+    u32 event_timeout_ms;
+    msg_queue_t* queue;
+} bench_task_t;
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static bench_task_t tasks[NOF_TASKS] = {
+    {"Console", 5U, MESSAGEBROKER_WAIT_FOREVER, NULL},
+    {"ApplicationControl", 5U, MESSAGEBROKER_WAIT_FOREVER, NULL},
+    {"PresenceDetector", 5U, 5000U, NULL},
+    {"NetworkTime", 1000U, 3600000U, NULL},
+    {"DeskControl", MESSAGEBROKER_WAIT_FOREVER, MESSAGEBROKER_WAIT_FOREVER, NULL},
+    {"TimerManager", MESSAGEBROKER_WAIT_FOREVER, MESSAGEBROKER_WAIT_FOREVER, NULL},
+};
+
+static atomic_bool is_running = true;
+static atomic_bool is_event_driven = false;
+static _Atomic u64 key_pressed_ns = 0; // 0 = no key pending
+static u64 total_key_latency_ns = 0;
+static u64 max_key_latency_ns = 0;
+static u32 nof_keys = 0;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+// Stands in for prv_console_run(): reads the pending key like Serial.available()/read()
+static void prv_console_run(void)
+{
+    u64 pressed_ns = atomic_exchange(&key_pressed_ns, 0);
+    if (pressed_ns != 0)
+    {
+        u64 latency_ns = bench_now_ns() - pressed_ns;
+        total_key_latency_ns += latency_ns;
+        max_key_latency_ns = (latency_ns > max_key_latency_ns) ? latency_ns : max_key_latency_ns;
+        nof_keys++;
+    }
+}
+
+static void* prv_task_thread(void* arg)
+{
+    bench_task_t* task = (bench_task_t*)arg;
+    u32 timeout_ms = atomic_load(&is_event_driven) ? task->event_timeout_ms : task->polling_timeout_ms;
+
+    while (atomic_load(&is_running))
+    {
+        if (task == &tasks[CONSOLE_TASK])
+        {
+            prv_console_run();
+        }
+        messagebroker_queue_process(task->queue, timeout_ms);
+    }
+    return NULL;
+}
+
+static void* prv_typing_thread(void* arg)
+{
+    (void)arg;
+    struct timespec interval = {0, KEY_INTERVAL_MS * 1000000L};
+
+    while (atomic_load(&is_running))
+    {
+        nanosleep(&interval, NULL);
+        atomic_store(&key_pressed_ns, bench_now_ns());
+
+        // The receive callback of the serial port, the polling loop finds the key on its own
+        if (atomic_load(&is_event_driven))
+        {
+            messagebroker_queue_notify(tasks[CONSOLE_TASK].queue);
+        }
+    }
+    return NULL;
+}
+
+static void prv_run(bool is_event, const char* label)
+{
+    msg_queue_stats_t before[NOF_TASKS];
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        messagebroker_get_queue_stats(i, &before[i]);
+    }
+    total_key_latency_ns = 0;
+    max_key_latency_ns = 0;
+    nof_keys = 0;
+    atomic_store(&is_event_driven, is_event);
+    atomic_store(&is_running, true);
+
+    u64 start_cpu_ns = bench_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    u64 start_ns = bench_now_ns();
+
+    pthread_t threads[NOF_TASKS];
+    pthread_t typing_thread;
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        pthread_create(&threads[i], NULL, prv_task_thread, &tasks[i]);
+    }
+    pthread_create(&typing_thread, NULL, prv_typing_thread, NULL);
+
+    struct timespec run_time = {RUN_TIME_MS / 1000U, (RUN_TIME_MS % 1000U) * 1000000L};
+    nanosleep(&run_time, NULL);
+    atomic_store(&is_running, false);
+
+    msg_queue_stats_t after[NOF_TASKS];
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        messagebroker_get_queue_stats(i, &after[i]);
+    }
+    double elapsed_s = (double)(bench_now_ns() - start_ns) / 1e9;
+    double cpu_ms = (double)(bench_clock_ns(CLOCK_PROCESS_CPUTIME_ID) - start_cpu_ns) / 1e6;
+
+    pthread_join(typing_thread, NULL);
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        // Tasks without a timeout only return from their wait for an event
+        messagebroker_queue_notify(tasks[i].queue);
+        pthread_join(threads[i], NULL);
+
+        // A polling task may have stopped on a timeout, do not leave the notification to the next run
+        messagebroker_queue_process(tasks[i].queue, 0);
+    }
+
+    printf("%s\n", label);
+    double total_wakeups = 0.0;
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        u32 wakeups = after[i].nof_wakeups - before[i].nof_wakeups;
+        total_wakeups += wakeups;
+        printf("  %-20s | %9.1f | %10.1f\n", tasks[i].name, wakeups / elapsed_s,
+               (after[i].nof_timeouts - before[i].nof_timeouts) / elapsed_s);
+    }
+    printf("  %-20s | %9.1f | CPU %.2f%% of one core, key latency avg %.1f us max %.1f us\n", "all tasks",
+           total_wakeups / elapsed_s, cpu_ms / (elapsed_s * 10.0),
+           (nof_keys > 0) ? (double)total_key_latency_ns / nof_keys / 1000.0 : 0.0,
+           (double)max_key_latency_ns / 1000.0);
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    messagebroker_init();
+
+    for (u8 i = 0; i < NOF_TASKS; i++)
+    {
+        tasks[i].queue = messagebroker_queue_create();
+    }
+
+    printf("Idle desk, one key every %u ms, %u ms per run\n", KEY_INTERVAL_MS, RUN_TIME_MS);
+    printf("  %-20s | wakeups/s | timeouts/s\n", "task");
+    prv_run(false, "Polling loops");
+    prv_run(true, "Event-driven");
+    return 0;
+}
@@ -0,0 +1,256 @@
+/**
+ * @file timingwheel_bench.c
+ * @brief Host benchmark: the timing wheel of the TimerManager, checked against a reference model of its timers.
+ *
+ * Random one-shot and periodic timers (1 tick to 10 hours) are started, restarted, paused,
+ * resumed and stopped while the clock advances in random steps from one tick to several hours, starting
+ * shortly before the u32 tick counter wraps. Every step is checked against a reference
+ * model of the timers:
+ * - timingwheel_advance() reports exactly the timers that expired since the last step
+ * - timingwheel_get_next_expiry() is the earliest expiry, an owner that sleeps until then
+ *   neither misses one nor wakes up for nothing
+ * - timingwheel_get_remaining() matches the reference, paused timers keep their remaining ticks
+ * Reported: cost per operation and the wake-ups per hour of an owner that sleeps until
+ * the next expiry of the desk timers. Returns non-zero if a check fails.
+ *
+ * Build and run with PlatformIO (see env:native_timingwheel in platformio.ini):
+ *   pio run -e native_timingwheel -t exec
+ *
+ * Or with plain gcc from the repository root:
+ *   gcc -O2 -std=gnu11 -Ilib/TimerManager -Ilib/Utils lib/TimerManager/TimingWheel.c lib/Utils/custom_assert.c \
+ *       bench/timingwheel_bench.c -o timingwheel_bench && ./timingwheel_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "TimingWheel.h"
+#include "bench_support.h"
+#include "custom_assert.h"
+
+// ###########################################################################
+// # Configuration
+// ###########################################################################
+#define NOF_TIMERS      TIMINGWHEEL_MAX_TIMERS
+#define NOF_OPERATIONS  2000000U
+#define START_TICK      0xFFF00000UL // About 17 minutes before the tick counter wraps
+#define MAX_DELAY_TICKS 36000000U    // 10 hours at 1 kHz, beyond the 4.6 hours of the wheel
+#define MAX_STEP_TICKS  14400000U    // 4 hours
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef struct
+{
+    bool is_active;
+    u32 expiry_tick;
+    u32 period_ticks;
+    bool is_paused;
+    u32 paused_ticks;
+} reference_timer_t;
+
+// ###########################################################################
+// # Private Data
+// ###########################################################################
+static timingwheel_t wheel;
+static reference_timer_t reference[NOF_TIMERS];
+static u32 nof_failures = 0;
+
+// ###########################################################################
+// # Private Functions
+// ###########################################################################
+static bool prv_is_before(u32 tick, u32 reference_tick) { return (s32)(tick - reference_tick) < 0; }
+
+// Random delay, short ones are more likely, like the timers of the modules
+static u32 prv_random_ticks(u32 max_ticks)
+{
+    u32 scale = 1U << (rand() % 26);
+    u32 ticks = (u32)rand() % ((scale < max_ticks) ? scale : max_ticks);
+    return ticks + 1U;
+}
+
+static void prv_fail(const char* check, u32 now_tick, u8 timer_id)
+{
+    if (nof_failures < 10U)
+    {
+        printf("  FAIL %s, tick %u, timer %u\n", check, now_tick, timer_id);
+    }
+    nof_failures++;
+}
+
+static u32 prv_reference_advance(u32 now_tick)
+{
+    u32 expired_mask = 0;
+    for (u8 i = 0; i < NOF_TIMERS; i++)
+    {
+        reference_timer_t* timer = &reference[i];
+        if (timer->is_active && !prv_is_before(now_tick, timer->expiry_tick))
+        {
+            expired_mask |= (1UL << i);
+            if (timer->period_ticks == 0)
+            {
+                timer->is_active = false;
+            }
+            else
+            {
+                u32 nof_periods = ((now_tick - timer->expiry_tick) / timer->period_ticks) + 1U;
+                timer->expiry_tick += nof_periods * timer->period_ticks;
+            }
+        }
+    }
+    return expired_mask;
+}
+
+static void prv_check(u32 now_tick)
+{
+    bool is_any_active = false;
+    u32 min_distance = 0;
+    for (u8 i = 0; i < NOF_TIMERS; i++)
+    {
+        u32 expected = reference[i].is_active ? (reference[i].expiry_tick - now_tick) : 0U;
+        expected = reference[i].is_paused ? reference[i].paused_ticks : expected;
+        if (timingwheel_get_remaining(&wheel, i, now_tick) != expected)
+        {
+            prv_fail("remaining ticks", now_tick, i);
+        }
+        if (timingwheel_is_paused(&wheel, i) != reference[i].is_paused)
+        {
+            prv_fail("paused state", now_tick, i);
+        }
+        if (reference[i].is_active && (!is_any_active || (expected < min_distance)))
+        {
+            min_distance = expected;
+            is_any_active = true;
+        }
+    }
+
+    u32 expiry_tick = 0;
+    bool is_pending = timingwheel_get_next_expiry(&wheel, &expiry_tick);
+    if (is_pending != is_any_active)
+    {
+        prv_fail("pending state", now_tick, 0);
+    }
+    else if (is_pending && ((expiry_tick - now_tick) != min_distance))
+    {
+        prv_fail("next expiry", now_tick, 0);
+    }
+}
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(void)
+{
+    custom_assert_init(bench_assert_failed);
+    srand(1);
+
+    u32 now_tick = START_TICK;
+    timingwheel_init(&wheel, now_tick);
+
+    u64 start_ns = 0;
+    u64 update_ns = 0;
+    u64 advance_ns = 0;
+    u32 nof_updates = 0;
+    u32 nof_advances = 0;
+    u32 nof_expiries = 0;
+
+    for (u32 i = 0; i < NOF_OPERATIONS; i++)
+    {
+        u8 timer_id = (u8)(rand() % NOF_TIMERS);
+        u32 operation = (u32)rand() % 10U;
+
+        if (operation < 3U)
+        {
+            u32 expiry_tick = now_tick + prv_random_ticks(MAX_DELAY_TICKS);
+            u32 period_ticks = ((rand() % 2) == 0) ? 0U : prv_random_ticks(MAX_DELAY_TICKS);
+            reference[timer_id] = (reference_timer_t){true, expiry_tick, period_ticks, false, 0U};
+
+            start_ns = bench_now_ns();
+            timingwheel_start(&wheel, timer_id, expiry_tick, period_ticks);
+            update_ns += bench_now_ns() - start_ns;
+            nof_updates++;
+        }
+        else if (operation < 4U)
+        {
+            reference[timer_id].is_active = false;
+            reference[timer_id].is_paused = false;
+
+            start_ns = bench_now_ns();
+            timingwheel_stop(&wheel, timer_id);
+            update_ns += bench_now_ns() - start_ns;
+            nof_updates++;
+        }
+        else if (operation < 5U)
+        {
+            reference_timer_t* timer = &reference[timer_id];
+            if (timer->is_active)
+            {
+                timer->paused_ticks = timer->expiry_tick - now_tick;
+                timer->is_active = false;
+                timer->is_paused = true;
+            }
+
+            start_ns = bench_now_ns();
+            timingwheel_pause(&wheel, timer_id, now_tick);
+            update_ns += bench_now_ns() - start_ns;
+            nof_updates++;
+        }
+        else if (operation < 6U)
+        {
+            reference_timer_t* timer = &reference[timer_id];
+            if (timer->is_paused)
+            {
+                timer->expiry_tick = now_tick + timer->paused_ticks;
+                timer->is_active = true;
+                timer->is_paused = false;
+            }
+
+            start_ns = bench_now_ns();
+            timingwheel_resume(&wheel, timer_id, now_tick);
+            update_ns += bench_now_ns() - start_ns;
+            nof_updates++;
+        }
+        else
+        {
+            // Mostly small steps, sometimes a long sleep
+            now_tick += ((rand() % 16) == 0) ? prv_random_ticks(MAX_STEP_TICKS) : prv_random_ticks(64U);
+            u32 expected_mask = prv_reference_advance(now_tick);
+
+            start_ns = bench_now_ns();
+            u32 expired_mask = timingwheel_advance(&wheel, now_tick);
+            advance_ns += bench_now_ns() - start_ns;
+            nof_advances++;
+
+            if (expired_mask != expected_mask)
+            {
+                prv_fail("expired timers", now_tick, (u8)__builtin_ctz(expired_mask ^ expected_mask));
+            }
+            nof_expiries += (u32)__builtin_popcount(expired_mask);
+        }
+        prv_check(now_tick);
+    }
+
+    printf("%u timers, %u operations, clock from 0x%08lX to 0x%08X\n", NOF_TIMERS, NOF_OPERATIONS, START_TICK,
+           now_tick);
+    printf("  start/stop/pause  | %8u calls | %6.1f ns/call\n", nof_updates, (double)update_ns / nof_updates);
+    printf("  advance           | %8u calls | %6.1f ns/call | %u expiries\n", nof_advances,
+           (double)advance_ns / nof_advances, nof_expiries);
+
+    // An owner that sleeps until timingwheel_get_next_expiry(): wake-ups in an hour of the desk timers
+    timingwheel_init(&wheel, 0);
+    timingwheel_start(&wheel, 0, 1200000U, 0);  // Countdown, 20 minutes
+    timingwheel_start(&wheel, 1, 5000U, 5000U); // Presence scan every 5 s
+    timingwheel_start(&wheel, 2, 3600000U, 0);  // Time sync after an hour
+    u32 nof_wakeups = 0;
+    u32 expiry_tick = 0;
+    while (timingwheel_get_next_expiry(&wheel, &expiry_tick) && (expiry_tick <= 3600000U))
+    {
+        timingwheel_advance(&wheel, expiry_tick);
+        nof_wakeups++;
+    }
+    printf("  desk timers, 1 h  | %8u wake-ups (720 scans, the countdown and the sync expire with a scan)\n",
+           nof_wakeups);
+
+    printf("%s\n", (nof_failures == 0) ? "PASS" : "FAIL");
+    return (nof_failures == 0) ? 0 : 1;
+}
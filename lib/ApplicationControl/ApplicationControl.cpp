@@ -1,11 +1,16 @@
 #include "ApplicationControl.h"
 #include <Arduino.h>
 #include <Preferences.h>
+#include "Executor.h"
 #include "MessageBroker.h"
 #include "MessageDefinitions.h"
+#include "MessageSchema.h"
 #include "NetworkTime.h"
 #include "custom_assert.h"
 #include "custom_types.h"
+#include "monotonic_time.h"
+#include "rtos_alloc.h"
+#include "test_support.h"
 
 // ###########################################################################
 // # Internal Configuration
@@ -18,27 +23,33 @@ typedef struct
 {
     bool is_person_present;
     bool is_countdown_expired;
+    bool is_grace_expired;
 } prv_mailbox_t;
 
 static prv_mailbox_t g_mailbox = {
     .is_person_present = false,
     .is_countdown_expired = false,
+    .is_grace_expired = false,
 };
 #define DEFAULT_MINUTES 20
 static u32 timer_interval_ms = DEFAULT_MINUTES * 60 * 1000; // 20 minutes default
 static bool g_run_sequence_once = false;
-static bool g_timer_stop_sent = false;   // Flag to prevent repeated timer stop messages
-static u32 timer_start_timestamp_ms = 0; // Timestamp when countdown timer started
-static Preferences prv_preferences;      // Preferences object for NVS storage
+static bool g_is_countdown_paused = false; // Presence lost, the countdown waits for the grace period
+static u64 timer_start_timestamp_ms = 0;   // Timestamp when countdown timer started, moved on by its pauses
+static u64 timer_pause_timestamp_ms = 0;   // Timestamp when the countdown was paused
+static Preferences prv_preferences;        // Preferences object for NVS storage
 
 // ###########################################################################
 // # Private function declarations
 // ###########################################################################
 static void prv_applicationcontrol_task(void* parameter);
-static void prv_applicationcontrol_init(void);
-static void prv_applicationcontrol_run(void);
-static void prv_msg_broker_callback(const msg_t* const message);
+STATIC void prv_applicationcontrol_init(void);
+STATIC void prv_applicationcontrol_run(void);
+static u32 prv_applicationcontrol_executor_run(void);
 static void prv_reset_sequence(void);
+static void prv_pause_countdown(void);
+static void prv_resume_countdown(void);
+static void prv_stop_countdown(void);
 static void prv_load_settings_from_flash(void);
 static void prv_save_timer_interval_to_flash(void);
 static bool prv_is_desk_movement_allowed(void);
@@ -50,6 +61,9 @@ static bool prv_is_desk_movement_allowed(void);
 // Logging control
 static bool prv_logging_enabled = false;
 
+// Delivery queue of this task
+static msg_queue_t* prv_msg_queue = NULL;
+
 // TODO: Add application state variables here
 
 // ###########################################################################
@@ -60,17 +74,39 @@ TaskHandle_t applicationcontrol_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_applicationcontrol_task, // Task function
-                "ApplicationControlTask",    // Task name
-                4096,                        // Stack size (words)
-                NULL,                        // Task parameters
-                2,                           // Task priority
-                &task_handle                 // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[APPLICATIONCONTROL_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_applicationcontrol_task,   // Task function
+                                    "ApplicationControlTask",      // Task name
+                                    APPLICATIONCONTROL_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                          // Task parameters
+                                    2,                             // Task priority
+                                    task_stack,                    // Task stack
+                                    &task_buffer                   // Task control block
+    );
+#else
+    xTaskCreate(prv_applicationcontrol_task,   // Task function
+                "ApplicationControlTask",      // Task name
+                APPLICATIONCONTROL_STACK_SIZE, // Stack size (bytes)
+                NULL,                          // Task parameters
+                2,                             // Task priority
+                &task_handle                   // Task handle
     );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
 
+void applicationcontrol_add_to_executor(void)
+{
+    static const executor_module_t module = {"ApplicationControl", prv_applicationcontrol_init,
+                                             prv_applicationcontrol_executor_run};
+    executor_register(&module);
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
@@ -88,29 +124,45 @@ static void prv_applicationcontrol_task(void* parameter)
         // Run the application control processing
         prv_applicationcontrol_run();
 
-        delay(5);
+        // Sleep until a message arrives - the sequence only advances on presence and countdown events
+        messagebroker_queue_process(prv_msg_queue, MESSAGEBROKER_WAIT_FOREVER);
     }
 }
 
-static void prv_applicationcontrol_init(void)
+STATIC void prv_applicationcontrol_init(void)
 {
     // Load settings from flash
     prv_load_settings_from_flash();
 
-    // Subscribe to 2001, 2002, 3003
-    messagebroker_subscribe(MSG_2001, prv_msg_broker_callback); // Presence Detected
-    messagebroker_subscribe(MSG_2002, prv_msg_broker_callback); // No Presence Detected
-    messagebroker_subscribe(MSG_3003, prv_msg_broker_callback); // Countdown finished
-    messagebroker_subscribe(MSG_0003, prv_msg_broker_callback); // Set Logging State
-    messagebroker_subscribe(MSG_4001, prv_msg_broker_callback); // Set Timer Interval
-    messagebroker_subscribe(MSG_4002, prv_msg_broker_callback); // Get Timer Interval
-    messagebroker_subscribe(MSG_4003, prv_msg_broker_callback); // Get Elapsed Timer Time
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
+    // Subscribe to 2001, 2002, 3003, 3006
+    messagebroker_subscribe_queued(MSG_2001, applicationcontrol_msg_broker_callback, prv_msg_queue); // Presence Detected
+    messagebroker_subscribe_queued(MSG_2002, applicationcontrol_msg_broker_callback, prv_msg_queue); // No Presence Detected
+    messagebroker_subscribe_queued(MSG_3003, applicationcontrol_msg_broker_callback, prv_msg_queue); // Countdown finished
+    messagebroker_subscribe_queued(MSG_3006, applicationcontrol_msg_broker_callback, prv_msg_queue); // Timer Expired
+    messagebroker_subscribe_queued(MSG_0003, applicationcontrol_msg_broker_callback, prv_msg_queue); // Set Logging State
+    messagebroker_subscribe_queued(MSG_4001, applicationcontrol_msg_broker_callback, prv_msg_queue); // Set Timer Interval
+    messagebroker_subscribe_queued(MSG_4002, applicationcontrol_msg_broker_callback, prv_msg_queue); // Get Timer Interval
+    messagebroker_subscribe_queued(MSG_4003, applicationcontrol_msg_broker_callback, prv_msg_queue); // Get Elapsed Timer Time
 }
 
-static void prv_applicationcontrol_run(void)
+STATIC void prv_applicationcontrol_run(void)
 {
     if (g_mailbox.is_person_present)
     {
+        if (g_is_countdown_paused && g_mailbox.is_grace_expired)
+        {
+            // The grace period ended in the same queue run in which presence returned, start over
+            prv_stop_countdown();
+        }
+        else if (g_is_countdown_paused)
+        {
+            // Presence returned within the grace period, the countdown continues where it stopped
+            prv_resume_countdown();
+        }
+
         if (g_run_sequence_once == false)
         {
             if (prv_logging_enabled)
@@ -120,14 +172,11 @@ static void prv_applicationcontrol_run(void)
                 Serial.println(" minutes");
             }
 
-            msg_t timer_msg;
-            timer_msg.msg_id = MSG_3001;
-            timer_msg.data_size = sizeof(u32);
-            timer_msg.data_bytes = (u8*)&timer_interval_ms;
-            messagebroker_publish(&timer_msg);
+            // The broker copies the value, timer_interval_ms can change while the message is queued
+            msg::publish<MSG_3001>(timer_interval_ms);
 
             // Store timestamp when timer starts
-            timer_start_timestamp_ms = millis();
+            timer_start_timestamp_ms = monotonic_time_get_ms();
 
             g_run_sequence_once = true;
         }
@@ -152,12 +201,7 @@ static void prv_applicationcontrol_run(void)
             }
 
             // Move desk up (toggle functionality)
-            static desk_command_e toggle_command = DESK_CMD_TOGGLE;
-            msg_t desk_msg;
-            desk_msg.msg_id = MSG_1000;
-            desk_msg.data_size = sizeof(desk_command_e);
-            desk_msg.data_bytes = (u8*)&toggle_command;
-            messagebroker_publish(&desk_msg);
+            msg::publish<MSG_1000>(DESK_CMD_TOGGLE);
 
             if (prv_logging_enabled)
             {
@@ -170,34 +214,32 @@ static void prv_applicationcontrol_run(void)
             timer_start_timestamp_ms = 0;
         }
     }
-    else
+    else if (g_run_sequence_once)
     {
-        // Stop the countdown timer if running (only send once)
-        if (!g_timer_stop_sent && g_run_sequence_once)
+        // A short dropout of the presence detection must not restart the countdown from zero
+        if (!g_is_countdown_paused && (APPLICATIONCONTROL_GRACE_PERIOD_MS > 0))
         {
-            msg_t timer_msg;
-            timer_msg.msg_id = MSG_3002; // Stop Countdown
-            timer_msg.data_size = 0;
-            timer_msg.data_bytes = NULL;
-            messagebroker_publish(&timer_msg);
-            g_timer_stop_sent = true;
-
-            if (prv_logging_enabled)
-            {
-                Serial.println("[AppCtrl] Timer stopped due to no presence");
-            }
+            prv_pause_countdown();
+        }
+        else if (!g_is_countdown_paused || g_mailbox.is_grace_expired)
+        {
+            prv_stop_countdown();
         }
-
-        // Wait before checking again
-        delay(10000);
     }
 }
 
+// The sequence only advances on presence and countdown events, see prv_applicationcontrol_task()
+static u32 prv_applicationcontrol_executor_run(void)
+{
+    prv_applicationcontrol_run();
+    return MESSAGEBROKER_WAIT_FOREVER;
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
 
-static void prv_msg_broker_callback(const msg_t* const message)
+void applicationcontrol_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
@@ -205,20 +247,17 @@ static void prv_msg_broker_callback(const msg_t* const message)
     {
         case MSG_2001: // Presence Detected
             g_mailbox.is_person_present = true;
-            g_timer_stop_sent = false; // Allow timer stop to be sent again if needed
             if (prv_logging_enabled)
             {
                 Serial.println("[AppCtrl] Event: Presence Detected");
             }
             break;
         case MSG_2002: // No Presence Detected
+            // The countdown is paused and only reset if presence does not return within the grace period
             g_mailbox.is_person_present = false;
-            // Reset the entire sequence when presence is lost
-            prv_reset_sequence();
-            timer_start_timestamp_ms = 0;
             if (prv_logging_enabled)
             {
-                Serial.println("[AppCtrl] Event: No Presence Detected - Sequence reset");
+                Serial.println("[AppCtrl] Event: No Presence Detected");
             }
             break;
         case MSG_3003: // Countdown finished
@@ -228,55 +267,58 @@ static void prv_msg_broker_callback(const msg_t* const message)
                 Serial.println("[AppCtrl] Event: Countdown Finished");
             }
             break;
-        case MSG_0003: // Set Logging State
-            if (message->data_size == sizeof(bool))
+        case MSG_3006: // Timer Expired
+            if (msg::payload<MSG_3006>(message) == TIMER_ID_PRESENCE_GRACE)
             {
-                prv_logging_enabled = *(bool*)(message->data_bytes);
-                Serial.print("[AppCtrl] Logging ");
-                Serial.println(prv_logging_enabled ? "enabled" : "disabled");
+                g_mailbox.is_grace_expired = true;
             }
             break;
-        case MSG_4001: // Set Timer Interval
-            if (message->data_size == sizeof(u32))
-            {
-                timer_interval_ms = *(u32*)(message->data_bytes);
-                prv_save_timer_interval_to_flash(); // Save to flash
-                Serial.print("[AppCtrl] Timer interval set to ");
-                Serial.print(timer_interval_ms / 60000);
-                Serial.println(" minutes");
-
-                // reset the sequence and timer timestamp
-                g_mailbox.is_countdown_expired = false;
-                g_run_sequence_once = false;
-                timer_start_timestamp_ms = 0;
-            }
+        case MSG_0003: // Set Logging State
+            prv_logging_enabled = msg::payload<MSG_0003>(message);
+            Serial.print("[AppCtrl] Logging ");
+            Serial.println(prv_logging_enabled ? "enabled" : "disabled");
             break;
-        case MSG_4002: // Get Timer Interval
-            Serial.print("[AppCtrl] Current timer interval: ");
+        case MSG_4001: // Set Timer Interval
+            timer_interval_ms = msg::payload<MSG_4001>(message);
+            prv_save_timer_interval_to_flash(); // Save to flash
+            Serial.print("[AppCtrl] Timer interval set to ");
             Serial.print(timer_interval_ms / 60000);
             Serial.println(" minutes");
-            break;
-        case MSG_4003: // Get Elapsed Time Since Timer Started
-            if (timer_start_timestamp_ms == 0)
+
+            // reset the sequence and timer timestamp, a paused countdown is discarded with its grace timer
+            if (g_is_countdown_paused)
             {
-                Serial.println("[AppCtrl] Timer is not currently running");
+                prv_stop_countdown();
             }
             else
             {
-                u32 elapsed_ms = millis() - timer_start_timestamp_ms;
-                u32 elapsed_seconds = elapsed_ms / 1000;
-                u32 elapsed_minutes = elapsed_seconds / 60;
-                u32 remaining_seconds = elapsed_seconds % 60;
-
-                Serial.print("[AppCtrl] Timer running for: ");
-                Serial.print(elapsed_minutes);
-                Serial.print(" minutes, ");
-                Serial.print(remaining_seconds);
-                Serial.print(" seconds (of ");
-                Serial.print(timer_interval_ms / 60000);
-                Serial.println(" minutes total)");
+                prv_reset_sequence();
+                timer_start_timestamp_ms = 0;
             }
             break;
+        case MSG_4002: // Get Timer Interval
+        {
+            msg_timer_interval_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+            reply.interval_ms = timer_interval_ms;
+            msg::reply<MSG_4002>(message, reply);
+        }
+        break;
+        case MSG_4003: // Get Elapsed Time Since Timer Started
+        {
+            msg_elapsed_time_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+            reply.is_running = (timer_start_timestamp_ms != 0);
+            reply.is_paused = g_is_countdown_paused;
+            if (reply.is_running)
+            {
+                u64 now_ms = g_is_countdown_paused ? timer_pause_timestamp_ms : monotonic_time_get_ms();
+                reply.elapsed_ms = (u32)(now_ms - timer_start_timestamp_ms);
+            }
+            reply.interval_ms = timer_interval_ms;
+            msg::reply<MSG_4003>(message, reply);
+        }
+        break;
         default:
             // Unknown message ID
             ASSERT(false);
@@ -287,7 +329,62 @@ static void prv_msg_broker_callback(const msg_t* const message)
 static void prv_reset_sequence(void)
 {
     g_mailbox.is_countdown_expired = false;
+    g_mailbox.is_grace_expired = false;
     g_run_sequence_once = false;
+    g_is_countdown_paused = false;
+}
+
+// The TimerManager keeps the remaining time of the countdown, the grace timer bounds the pause
+static void prv_pause_countdown(void)
+{
+    msg_timer_start_t grace_timer = {TIMER_ID_PRESENCE_GRACE, APPLICATIONCONTROL_GRACE_PERIOD_MS, 0};
+    msg::publish<MSG_3009>(TIMER_ID_COUNTDOWN); // Pause Timer
+    msg::publish<MSG_3004>(grace_timer);        // Start Timer
+
+    g_mailbox.is_grace_expired = false;
+    g_is_countdown_paused = true;
+    timer_pause_timestamp_ms = monotonic_time_get_ms();
+
+    if (prv_logging_enabled)
+    {
+        Serial.print("[AppCtrl] Timer paused due to no presence, stopped in ");
+        Serial.print(APPLICATIONCONTROL_GRACE_PERIOD_MS / 1000);
+        Serial.println(" seconds");
+    }
+}
+
+static void prv_resume_countdown(void)
+{
+    msg::publish<MSG_3005>(TIMER_ID_PRESENCE_GRACE); // Stop Timer
+    msg::publish<MSG_3010>(TIMER_ID_COUNTDOWN);      // Resume Timer
+
+    g_mailbox.is_grace_expired = false;
+    g_is_countdown_paused = false;
+
+    // The elapsed time does not count the pause
+    timer_start_timestamp_ms += monotonic_time_get_ms() - timer_pause_timestamp_ms;
+
+    if (prv_logging_enabled)
+    {
+        Serial.println("[AppCtrl] Presence returned, timer resumed");
+    }
+}
+
+static void prv_stop_countdown(void)
+{
+    msg::publish<MSG_3002>(); // Stop Countdown, discards the paused time
+    if (g_is_countdown_paused && !g_mailbox.is_grace_expired)
+    {
+        msg::publish<MSG_3005>(TIMER_ID_PRESENCE_GRACE); // Stop Timer
+    }
+
+    prv_reset_sequence();
+    timer_start_timestamp_ms = 0;
+
+    if (prv_logging_enabled)
+    {
+        Serial.println("[AppCtrl] Timer stopped, sequence reset");
+    }
 }
 
 // ###########################################################################
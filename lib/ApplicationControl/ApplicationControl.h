@@ -5,6 +5,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define APPLICATIONCONTROL_STACK_SIZE 4096 // Task stack in bytes
+
+// Time the countdown stays paused after presence is lost, it resumes if presence returns in time
+// and is stopped otherwise. 0 = stop the countdown as soon as presence is lost.
+#ifndef APPLICATIONCONTROL_GRACE_PERIOD_MS
+#define APPLICATIONCONTROL_GRACE_PERIOD_MS 120000U
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -16,6 +24,12 @@ extern "C"
      */
     TaskHandle_t applicationcontrol_create_task(void);
 
+    /**
+     * @brief Registers the ApplicationControl with the cooperative executor
+     *        (EXECUTOR_COOPERATIVE), instead of creating its task
+     */
+    void applicationcontrol_add_to_executor(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -32,31 +32,71 @@
 
 #include "Console.h"
 #include "Cli.h"
+#include "Executor.h"
 #include "MessageBroker.h"
 #include "MessageDefinitions.h"
+#include "MessageRpc.h"
+#include "MessageSchema.h"
+#include "MessageTrace.h"
+#include "StackMonitor.h"
+#include "TaskProfiler.h"
 #include "custom_assert.h"
 #include "custom_types.h"
+#include "monotonic_time.h"
+#include "rtos_alloc.h"
 
 // Include Arduino Serial for I/O
 #include <Arduino.h>
 #include <esp_system.h>
 
+// ###########################################################################
+// # Internal Configuration
+// ###########################################################################
+
+#define CONSOLE_QUERY_TIMEOUT_MS       100        // Queries are answered from the module tasks, usually within a few ms
+#define CONSOLE_ARDUINO_LOOP_TASK_NAME "loopTask" // Task of setup() and loop(), created by the Arduino core
+
 // ###########################################################################
 // # Private function declarations
 // ###########################################################################
 static void prv_console_task(void* parameter);
 static void prv_console_init(void);
-static void prv_console_run(void);
+static u32 prv_console_run(void);
 static int prv_console_put_char(char in_char);
 static char prv_console_get_char(void);
+#if ARDUINO_USB_CDC_ON_BOOT
+static void prv_serial_rx_event_callback(void* arg, esp_event_base_t base, int32_t event_id, void* event_data);
+#else
+static void prv_serial_receive_callback(void);
+#endif
+static void* prv_alloc_payload(u16 size);
+template <msg_id_e ID, typename T>
+static bool prv_query(T* reply, const char* module_name);
 
 // System Commands
 static int prv_cmd_system_info(int argc, char* argv[], void* context);
 static int prv_cmd_reset_system(int argc, char* argv[], void* context);
+static int prv_cmd_system_stack(int argc, char* argv[], void* context);
+static int prv_cmd_top(int argc, char* argv[], void* context);
+static int prv_cmd_system_ram(int argc, char* argv[], void* context);
 
 // Message Broker Test commands
-static void prv_msg_broker_callback(const msg_t* const message);
 static int prv_cmd_msgbroker_can_subscribe_and_publish(int argc, char* argv[], void* context);
+static int prv_cmd_msgbroker_pool_stats(int argc, char* argv[], void* context);
+static int prv_cmd_msgbroker_rpc_stats(int argc, char* argv[], void* context);
+static int prv_cmd_msgbroker_wakeups(int argc, char* argv[], void* context);
+#if MESSAGEBROKER_INSTRUMENTATION
+static int prv_cmd_msgbroker_stats(int argc, char* argv[], void* context);
+static const char* prv_get_subscriber_name(msg_callback_t callback);
+static void prv_print_histogram(const u32* histogram, u32 cycles_per_us);
+#endif
+#if MESSAGEBROKER_TRACE
+static int prv_cmd_msgbroker_trace(int argc, char* argv[], void* context);
+#endif
+#if !MESSAGEBROKER_STATIC_ROUTES
+static int prv_cmd_msgbroker_watch(int argc, char* argv[], void* context);
+static void prv_watch_callback(const msg_t* const message);
+#endif
 
 // Desk Control Test Commands
 static int prv_cmd_deskcontrol_move_command(int argc, char* argv[], void* context);
@@ -72,6 +112,7 @@ static int prv_cmd_pd_get_threshold(int argc, char* argv[], void* context);
 
 // Timer Manager Test Commands
 static int prv_cmd_timer_start_countdown(int argc, char* argv[], void* context);
+static int prv_cmd_timer_list(int argc, char* argv[], void* context);
 
 // Application Control Commands
 static int prv_cmd_appctrl_set_timer_interval(int argc, char* argv[], void* context);
@@ -89,6 +130,10 @@ static int prv_cmd_time_get_info(int argc, char* argv[], void* context);
 // ###########################################################################
 
 static bool is_initialized = false;
+static msg_queue_t* prv_msg_queue = NULL;
+#if !MESSAGEBROKER_STATIC_ROUTES
+static bool is_topic_watched[E_TOPIC_LAST_TOPIC] = {false};
+#endif
 
 // embedded cli object - contains all data. This memory is to be managed by the user
 static cli_cfg_t g_cli_cfg = {0};
@@ -105,9 +150,27 @@ static cli_binding_t cli_bindings[] = {
     // System Commands
     {"system_info", prv_cmd_system_info, NULL, "Show system information"},
     {"system_restart", prv_cmd_reset_system, NULL, "Hard reset the system"},
+    {"system_stack", prv_cmd_system_stack, NULL, "Show worst case stack use and suggested stack size per task"},
+    {"top", prv_cmd_top, NULL, "Show CPU use, state and wake-ups per task since the last call"},
+    {"system_ram", prv_cmd_system_ram, NULL, "Show the RAM budget of the tasks and the message broker"},
 
     // Message Broker Test Commands
     {"msgbroker_test", prv_cmd_msgbroker_can_subscribe_and_publish, NULL, "Test Message Broker subscribe and publish"},
+    {"msgbroker_pool", prv_cmd_msgbroker_pool_stats, NULL, "Show payload pool occupancy and allocation latency"},
+    {"msgbroker_rpc", prv_cmd_msgbroker_rpc_stats, NULL, "Show request/reply calls, timeouts and reply latency"},
+    {"msgbroker_wakeups", prv_cmd_msgbroker_wakeups, NULL, "Show task wake-ups per second since the last call"},
+#if MESSAGEBROKER_INSTRUMENTATION
+    {"msgbroker_stats", prv_cmd_msgbroker_stats, NULL,
+     "Show topic counters, callback durations and lane wait times: msgbroker_stats [reset]"},
+#endif
+#if MESSAGEBROKER_TRACE
+    {"msgbroker_trace", prv_cmd_msgbroker_trace, NULL,
+     "Show or dump the publish trace: msgbroker_trace [dump|clear|on|off]"},
+#endif
+#if !MESSAGEBROKER_STATIC_ROUTES
+    {"msgbroker_watch", prv_cmd_msgbroker_watch, NULL,
+     "Print every publish of a topic: msgbroker_watch <topic> <on|off> (topic as in msgbroker_stats)"},
+#endif
 
     // Logging Commands
     {"log", prv_cmd_log_control, NULL, "Control module logging: log <on|off> <appctrl|desk|presence|nettime>"},
@@ -123,6 +186,7 @@ static cli_binding_t cli_bindings[] = {
 
     // Timer Manager Commands
     {"test_timer", prv_cmd_timer_start_countdown, NULL, "Start countdown timer: test_timer <seconds>"},
+    {"timers", prv_cmd_timer_list, NULL, "Show the running timers of the timer service"},
 
     // Application Control Commands
     {"appctrl_set_time", prv_cmd_appctrl_set_timer_interval, NULL,
@@ -147,17 +211,38 @@ TaskHandle_t console_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_console_task, // Task function
-                "ConsoleTask",    // Task name
-                4096,             // Stack size (words)
-                NULL,             // Task parameters
-                1,                // Task priority
-                &task_handle      // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[CONSOLE_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_console_task,   // Task function
+                                    "ConsoleTask",      // Task name
+                                    CONSOLE_STACK_SIZE, // Stack size (bytes)
+                                    NULL,               // Task parameters
+                                    1,                  // Task priority
+                                    task_stack,         // Task stack
+                                    &task_buffer        // Task control block
     );
+#else
+    xTaskCreate(prv_console_task,   // Task function
+                "ConsoleTask",      // Task name
+                CONSOLE_STACK_SIZE, // Stack size (bytes)
+                NULL,               // Task parameters
+                1,                  // Task priority
+                &task_handle        // Task handle
+    );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
 
+void console_add_to_executor(void)
+{
+    static const executor_module_t module = {"Console", prv_console_init, prv_console_run};
+    executor_register(&module);
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
@@ -173,9 +258,10 @@ static void prv_console_task(void* parameter)
     while (1)
     {
         // Run the console processing
-        prv_console_run();
+        u32 next_run_ms = prv_console_run();
 
-        delay(5);
+        // Sleep until a message arrives or the serial port receives a character
+        messagebroker_queue_process(prv_msg_queue, next_run_ms);
     }
 }
 
@@ -194,21 +280,32 @@ static void prv_console_init(void)
         cli_register(&cli_bindings[i]);
     }
 
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
     // Subscribe to timer done message
-    messagebroker_subscribe(MSG_3003, prv_msg_broker_callback);
+    messagebroker_subscribe_queued(MSG_3003, console_msg_broker_callback, prv_msg_queue);
 
     // Subscribe to test message
-    messagebroker_subscribe(MSG_0001, prv_msg_broker_callback);
+    messagebroker_subscribe_queued(MSG_0001, console_msg_broker_callback, prv_msg_queue);
+
+    // Received characters wake the task
+#if ARDUINO_USB_CDC_ON_BOOT
+    Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, prv_serial_rx_event_callback);
+#else
+    Serial.onReceive(prv_serial_receive_callback);
+#endif
 
     is_initialized = true;
 }
 
-static void prv_console_run(void)
+// Returns the time in ms until the console has to run again, received characters wake it
+static u32 prv_console_run(void)
 {
     ASSERT(is_initialized);
 
-    // Check if there are characters available from Serial
-    if (Serial.available() > 0)
+    // Process every character that arrived since the task went to sleep
+    while (Serial.available() > 0)
     {
         // Get a character entered by the user
         char c = prv_console_get_char();
@@ -216,6 +313,8 @@ static void prv_console_run(void)
         // Add the character to a queue and process it
         cli_receive_and_process(c);
     }
+
+    return MESSAGEBROKER_WAIT_FOREVER;
 }
 
 // ###########################################################################
@@ -241,6 +340,46 @@ static char prv_console_get_char(void)
     return 0; // No character available
 }
 
+#if ARDUINO_USB_CDC_ON_BOOT
+static void prv_serial_rx_event_callback(void* arg, esp_event_base_t base, int32_t event_id, void* event_data)
+{
+    // Runs in the USB CDC event task, the characters are read by prv_console_run()
+    (void)arg;
+    (void)base;
+    (void)event_id;
+    (void)event_data;
+    messagebroker_queue_notify(prv_msg_queue);
+}
+#else
+static void prv_serial_receive_callback(void)
+{
+    // Runs in the UART event task, the characters are read by prv_console_run()
+    messagebroker_queue_notify(prv_msg_queue);
+}
+#endif
+
+static void* prv_alloc_payload(u16 size)
+{
+    void* payload = messagepool_alloc(size);
+    if (payload == NULL)
+    {
+        cli_print("Error: message pool exhausted, try again later");
+    }
+    return payload;
+}
+
+// Sends a query and waits for the typed reply of the module
+template <msg_id_e ID, typename T>
+static bool prv_query(T* reply, const char* module_name)
+{
+    if (msg::call<ID>(reply, CONSOLE_QUERY_TIMEOUT_MS) != MSG_RPC_OK)
+    {
+        cli_print("Error: %s did not answer within %u ms", module_name, CONSOLE_QUERY_TIMEOUT_MS);
+        return false;
+    }
+    return true;
+}
+
 // ============================
 // = Commands
 // ============================
@@ -252,7 +391,7 @@ static int prv_cmd_system_info(int argc, char* argv[], void* context)
     (void)context;
 
     // Basic system info
-    cli_print("* Uptime: %lu ms", millis());
+    cli_print("* Uptime: %llu ms", (unsigned long long)monotonic_time_get_ms());
     cli_print("* Free Heap: %d bytes", ESP.getFreeHeap());
     cli_print("* CPU Frequency: %d MHz", ESP.getCpuFreqMHz());
 
@@ -290,14 +429,151 @@ static int prv_cmd_reset_system(int argc, char* argv[], void* context)
     return CLI_OK_STATUS;
 }
 
-static void prv_msg_broker_callback(const msg_t* const message)
+static int prv_cmd_system_stack(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    // The worst case since boot, exercise the commands and error paths of interest before reading the suggestion
+    stackmonitor_sample();
+
+    u32 total_size = 0;
+    u32 total_suggested = 0;
+    cli_print("Task                   |  Size | Max used |   %% | Suggested | Last increase");
+    for (u8 i = 0; i < stackmonitor_get_nof_tasks(); i++)
+    {
+        stackmonitor_task_stats_t stats;
+        stackmonitor_get_task_stats(i, &stats);
+        total_size += stats.stack_size;
+        total_suggested += stats.suggested_size;
+
+        cli_print("%-22s | %5lu | %8lu | %3lu | %9lu | %llu ms", pcTaskGetName(stats.task_handle),
+                  (unsigned long)stats.stack_size, (unsigned long)stats.max_used,
+                  (unsigned long)((stats.max_used * 100U) / stats.stack_size), (unsigned long)stats.suggested_size,
+                  (unsigned long long)stats.last_increase_ms);
+    }
+
+    // Negative if a task needs more stack than it has
+    cli_print("All tasks: %lu bytes of stack, %lu suggested, %ld reclaimable", (unsigned long)total_size,
+              (unsigned long)total_suggested, (long)total_size - (long)total_suggested);
+    return CLI_OK_STATUS;
+}
+
+static int prv_cmd_top(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    static const char state_names[] = {'X', 'R', 'B', 'S', 'D'}; // Running, ready, blocked, suspended, deleted
+
+    u8 nof_tasks = taskprofiler_sample();
+    if (nof_tasks == 0)
+    {
+        cli_print("Run time stats disabled, enable CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+        return CLI_OK_STATUS;
+    }
+
+    // The first call covers the time since boot
+    u32 interval_us = taskprofiler_get_interval();
+    u32 interval_ms = (interval_us / 1000U > 0) ? (interval_us / 1000U) : 1U;
+
+    cli_print("Task                   | State | Prio |   CPU %% | Wakeups/s");
+    for (u8 i = 0; i < nof_tasks; i++)
+    {
+        taskprofiler_task_stats_t stats;
+        taskprofiler_get_task_stats(i, &stats);
+
+        char state = ((u32)stats.state < sizeof(state_names)) ? state_names[stats.state] : '?';
+        if (stats.nof_wakeups == TASKPROFILER_NO_WAKEUPS)
+        {
+            cli_print("%-22s | %5c | %4lu | %5lu.%lu | %9s", stats.name, state, (unsigned long)stats.priority,
+                      (unsigned long)(stats.cpu_permille / 10U), (unsigned long)(stats.cpu_permille % 10U), "-");
+        }
+        else
+        {
+            cli_print("%-22s | %5c | %4lu | %5lu.%lu | %9lu", stats.name, state, (unsigned long)stats.priority,
+                      (unsigned long)(stats.cpu_permille / 10U), (unsigned long)(stats.cpu_permille % 10U),
+                      (unsigned long)(((u64)stats.nof_wakeups * 1000ULL) / interval_ms));
+        }
+    }
+    cli_print("Over %lu ms, sampled in %lu us", (unsigned long)interval_ms,
+              (unsigned long)taskprofiler_get_sample_duration_us());
+    return CLI_OK_STATUS;
+}
+
+static int prv_cmd_system_ram(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    u32 total_bytes = 0;
+
+    // The tasks created in this build, as registered with the stack monitor
+    cli_print("Module                 | Stack | Control block | Total");
+    for (u8 i = 0; i < stackmonitor_get_nof_tasks(); i++)
+    {
+        stackmonitor_task_stats_t stats;
+        stackmonitor_get_task_stats(i, &stats);
+
+        // The loop task always comes from the heap, the Arduino core creates it
+        const char* name = pcTaskGetName(stats.task_handle);
+        bool is_loop_task = (strcmp(name, CONSOLE_ARDUINO_LOOP_TASK_NAME) == 0);
+        u32 task_bytes = stats.stack_size + (u32)sizeof(StaticTask_t);
+        total_bytes += is_loop_task ? 0U : task_bytes;
+        cli_print("%-22s | %5lu | %13u | %5lu%s", name, (unsigned long)stats.stack_size, (unsigned)sizeof(StaticTask_t),
+                  (unsigned long)task_bytes, is_loop_task ? " (heap, not in the total)" : "");
+    }
+
+    // The sampling timer of the stack monitor, the only FreeRTOS timer of the modules
+    u32 timer_bytes = (u32)sizeof(StaticTimer_t);
+    total_bytes += timer_bytes;
+    cli_print("%-22s | %5s | %13u | %5lu", "StackMonitor timer", "-", (unsigned)sizeof(StaticTimer_t),
+              (unsigned long)timer_bytes);
+
+    msg_memory_footprint_t footprint;
+    messagebroker_get_memory_footprint(&footprint);
+    const struct
+    {
+        const char* name;
+        u32 bytes;
+    } broker_rows[] = {
+        {"Broker routing", footprint.routing_bytes},
+        {"Broker retained", footprint.retained_bytes},
+        {"Broker queues", footprint.queue_pool_bytes},
+        {"Broker ISR ring", footprint.isr_ring_bytes},
+        {"Broker dispatch", footprint.dispatch_bytes},
+        {"Broker instrumentation", footprint.instrumentation_bytes},
+        {"Broker trace", footprint.trace_bytes},
+        {"Broker RPC", footprint.rpc_bytes},
+        {"Broker payload pool", footprint.payload_pool_bytes},
+    };
+    for (u8 i = 0; i < sizeof(broker_rows) / sizeof(broker_rows[0]); i++)
+    {
+        if (broker_rows[i].bytes > 0)
+        {
+            cli_print("%-22s | %5s | %13s | %5lu", broker_rows[i].name, "-", "-", (unsigned long)broker_rows[i].bytes);
+        }
+    }
+    total_bytes += footprint.total_bytes;
+
+    cli_print("Total: %lu bytes, module tasks and timers %s", (unsigned long)total_bytes,
+              RTOS_STATIC_ALLOCATION ? "static (RTOS_STATIC_ALLOCATION)" : "from the heap");
+    cli_print("Heap: %lu free, %lu min free, %lu largest block", (unsigned long)ESP.getFreeHeap(),
+              (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+    return CLI_OK_STATUS;
+}
+
+void console_msg_broker_callback(const msg_t* const message)
 {
     switch (message->msg_id)
     {
         case MSG_0001:
             cli_print("Message was received\n...");
             cli_print("Received message ID: %d, Size: %d", message->msg_id, message->data_size);
-            cli_print("Message Content: %s", message->data_bytes);
+            cli_print("Message Content: %s", msg::text<MSG_0001>(message));
             break;
 
         case MSG_3003: // Timer finished
@@ -318,17 +594,295 @@ static int prv_cmd_msgbroker_can_subscribe_and_publish(int argc, char* argv[], v
 
     cli_print("Subscribed to MSG_0001 \n... \nNow publishing a test message. \n...");
     // Publish a test message
-    msg_t test_msg;
-    test_msg.msg_id = MSG_0001;
-    const char* test_data = "The elephant has been tickled!";
-    test_msg.data_size = strlen(test_data) + 1; // Including null terminator
-    test_msg.data_bytes = (u8*)test_data;
+    msg::publish_text<MSG_0001>("The elephant has been tickled!");
+
+    return CLI_OK_STATUS;
+}
+
+static int prv_cmd_msgbroker_pool_stats(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    messagepool_stats_t stats;
+    messagepool_get_stats(&stats);
+
+    u32 cycles_per_us = (stats.cycles_per_us > 0) ? stats.cycles_per_us : 1;
+
+    cli_print("* Blocks in use: %u / %u (%u bytes each)", stats.nof_used_blocks, stats.nof_blocks, stats.block_size);
+    cli_print("* Peak blocks in use: %u", stats.peak_used_blocks);
+    cli_print("* Allocations: %lu (failed: %lu)", (unsigned long)stats.nof_allocations,
+              (unsigned long)stats.nof_failed_allocations);
+    cli_print("* Alloc latency avg: %lu cycles (%lu ns)", (unsigned long)stats.avg_alloc_cycles,
+              (unsigned long)(((u64)stats.avg_alloc_cycles * 1000ULL) / cycles_per_us));
+    cli_print("* Alloc latency max: %lu cycles (%lu ns)", (unsigned long)stats.max_alloc_cycles,
+              (unsigned long)(((u64)stats.max_alloc_cycles * 1000ULL) / cycles_per_us));
+    return CLI_OK_STATUS;
+}
+
+static int prv_cmd_msgbroker_rpc_stats(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    msg_rpc_stats_t stats;
+    messagerpc_get_stats(&stats);
+
+    cli_print("* Calls: %lu (timed out: %lu)", (unsigned long)stats.nof_calls, (unsigned long)stats.nof_timeouts);
+    cli_print("* Unmatched replies: %lu", (unsigned long)stats.nof_unmatched_replies);
+    cli_print("* Reply latency max: %lu us", (unsigned long)stats.max_latency_us);
+    return CLI_OK_STATUS;
+}
+
+static int prv_cmd_msgbroker_wakeups(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
+
+    // Counters of the previous call, the rates cover the time in between
+    static u64 last_time_ms = 0;
+    static u32 last_wakeups[MESSAGEBROKER_MAX_QUEUES] = {0};
+    static u32 last_timeouts[MESSAGEBROKER_MAX_QUEUES] = {0};
+
+    u64 now_ms = monotonic_time_get_ms();
+    u64 elapsed_ms = (now_ms - last_time_ms > 0) ? (now_ms - last_time_ms) : 1U;
+    u32 total_wakeups = 0;
+
+    cli_print("Task                   | Wakeups/s | Timeouts/s | Total wakeups");
+    for (u16 i = 0; i < messagebroker_get_nof_queues(); i++)
+    {
+        msg_queue_stats_t stats;
+        messagebroker_get_queue_stats(i, &stats);
+
+        u32 wakeups = stats.nof_wakeups - last_wakeups[i];
+        u32 timeouts = stats.nof_timeouts - last_timeouts[i];
+        last_wakeups[i] = stats.nof_wakeups;
+        last_timeouts[i] = stats.nof_timeouts;
+        total_wakeups += wakeups;
+
+        cli_print("%-22s | %9lu | %10lu | %13lu", pcTaskGetName((TaskHandle_t)stats.owner),
+                  (unsigned long)(((u64)wakeups * 1000ULL) / elapsed_ms),
+                  (unsigned long)(((u64)timeouts * 1000ULL) / elapsed_ms), (unsigned long)stats.nof_wakeups);
+    }
+    cli_print("All tasks: %lu wakeups/s over %lu ms", (unsigned long)(((u64)total_wakeups * 1000ULL) / elapsed_ms),
+              (unsigned long)elapsed_ms);
+
+    last_time_ms = now_ms;
+    return CLI_OK_STATUS;
+}
+
+#if MESSAGEBROKER_INSTRUMENTATION
+static int prv_cmd_msgbroker_stats(int argc, char* argv[], void* context)
+{
+    (void)context;
+
+    if ((argc == 2) && (strcmp(argv[1], "reset") == 0))
+    {
+        messagebroker_reset_stats();
+        cli_print("Message broker statistics cleared");
+        return CLI_OK_STATUS;
+    }
+
+    cli_print("Topic | Publishes | No subscriber | Coalesced");
+    for (u16 topic = E_TOPIC_FIRST_TOPIC + 1; topic < E_TOPIC_LAST_TOPIC; topic++)
+    {
+        msg_topic_stats_t topic_stats;
+        messagebroker_get_topic_stats((msg_id_e)topic, &topic_stats);
+        if (topic_stats.nof_publishes > 0)
+        {
+            cli_print("%5u | %9lu | %13lu | %9lu", topic, (unsigned long)topic_stats.nof_publishes,
+                      (unsigned long)topic_stats.nof_unheard_publishes, (unsigned long)topic_stats.nof_coalesced);
+        }
+    }
+
+    // The CPU frequency in MHz is the number of cycles per microsecond
+    u32 cycles_per_us = ESP.getCpuFreqMHz();
+
+    for (u8 i = 0; i < messagebroker_get_nof_subscribers(); i++)
+    {
+        msg_subscriber_stats_t subscriber_stats;
+        messagebroker_get_subscriber_stats(i, &subscriber_stats);
 
-    messagebroker_publish(&test_msg);
+        cli_print("%s: %lu calls, max %lu cycles (%lu us)", prv_get_subscriber_name(subscriber_stats.callback),
+                  (unsigned long)subscriber_stats.nof_calls, (unsigned long)subscriber_stats.max_cycles,
+                  (unsigned long)(subscriber_stats.max_cycles / cycles_per_us));
+        prv_print_histogram(subscriber_stats.histogram, cycles_per_us);
+    }
+
+    // Queued deliveries only, from the publish to the start of the callback
+    static const char* const lane_names[E_MSG_PRIORITY_COUNT] = {"normal", "high", "low"};
+    for (u8 priority = 0; priority < E_MSG_PRIORITY_COUNT; priority++)
+    {
+        msg_lane_stats_t lane_stats;
+        messagebroker_get_lane_stats((msg_priority_e)priority, &lane_stats);
+
+        cli_print("Lane %s: %lu deliveries, %lu dropped, max wait %lu cycles (%lu us)", lane_names[priority],
+                  (unsigned long)lane_stats.nof_deliveries, (unsigned long)lane_stats.nof_dropped,
+                  (unsigned long)lane_stats.max_wait_cycles,
+                  (unsigned long)(lane_stats.max_wait_cycles / cycles_per_us));
+        prv_print_histogram(lane_stats.histogram, cycles_per_us);
+    }
 
     return CLI_OK_STATUS;
 }
 
+static void prv_print_histogram(const u32* histogram, u32 cycles_per_us)
+{
+    for (u8 bucket = 0; bucket < MESSAGEBROKER_STATS_NOF_BUCKETS; bucket++)
+    {
+        if (histogram[bucket] == 0)
+        {
+            continue;
+        }
+
+        // Upper limit of the bucket, the last bucket is open-ended and shows its lower limit
+        u32 limit_cycles = 1UL << (MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2 + bucket);
+        const char* relation = "< ";
+        if (bucket == MESSAGEBROKER_STATS_NOF_BUCKETS - 1U)
+        {
+            limit_cycles /= 2U;
+            relation = ">=";
+        }
+
+        cli_print("  %s %8lu cycles (%6lu us): %lu", relation, (unsigned long)limit_cycles,
+                  (unsigned long)(limit_cycles / cycles_per_us), (unsigned long)histogram[bucket]);
+    }
+}
+
+static const char* prv_get_subscriber_name(msg_callback_t callback)
+{
+#define CONSOLE_SUBSCRIBER_NAME(id, subscriber_callback)                                                               \
+    if (callback == subscriber_callback)                                                                               \
+    {                                                                                                                  \
+        return #subscriber_callback;                                                                                   \
+    }
+    MESSAGE_SUBSCRIBERS(CONSOLE_SUBSCRIBER_NAME)
+#undef CONSOLE_SUBSCRIBER_NAME
+
+    return "unknown";
+}
+#endif
+
+#if MESSAGEBROKER_TRACE
+static int prv_cmd_msgbroker_trace(int argc, char* argv[], void* context)
+{
+    (void)context;
+
+    const char* mode = (argc >= 2) ? argv[1] : "show";
+    if (strcmp(mode, "clear") == 0)
+    {
+        messagetrace_clear();
+        cli_print("Message trace cleared");
+        return CLI_OK_STATUS;
+    }
+    if ((strcmp(mode, "on") == 0) || (strcmp(mode, "off") == 0))
+    {
+        messagetrace_set_enabled(strcmp(mode, "on") == 0);
+        cli_print("Message trace %s", mode);
+        return CLI_OK_STATUS;
+    }
+    if ((strcmp(mode, "show") != 0) && (strcmp(mode, "dump") != 0))
+    {
+        cli_print("Usage: msgbroker_trace [dump|clear|on|off]");
+        return CLI_FAIL_STATUS;
+    }
+
+    // Keep the ring stable while it is read, the publishes in the meantime are not recorded
+    messagetrace_set_enabled(false);
+
+    msg_trace_header_t header;
+    messagetrace_get_header(&header);
+
+    if (strcmp(mode, "dump") == 0)
+    {
+        // Raw binary stream, see MessageTrace.h for the format
+        Serial.write((const u8*)&header, sizeof(header));
+        for (u32 i = 0; i < header.nof_records; i++)
+        {
+            msg_trace_record_t record;
+            if (messagetrace_get_record(i, &record))
+            {
+                Serial.write((const u8*)&record, sizeof(record));
+            }
+        }
+        Serial.flush();
+    }
+    else
+    {
+        cli_print("%lu records (%lu overwritten)", (unsigned long)header.nof_records,
+                  (unsigned long)header.nof_overwritten);
+        for (u32 i = 0; i < header.nof_records; i++)
+        {
+            msg_trace_record_t record;
+            if (!messagetrace_get_record(i, &record))
+            {
+                break;
+            }
+
+            char payload[3 * MESSAGEBROKER_TRACE_PAYLOAD_SIZE + 1] = {0};
+            u16 nof_bytes = (record.data_size < header.payload_size) ? record.data_size : header.payload_size;
+            for (u16 b = 0; b < nof_bytes; b++)
+            {
+                snprintf(&payload[3 * b], 4, "%02X ", record.data_bytes[b]);
+            }
+
+            // Task handles are 32 bit pointers on the ESP32-C6
+            TaskHandle_t publisher = (TaskHandle_t)(uintptr_t)record.publisher;
+            cli_print("%12llu us %-22s topic %2u %3u B %s", (unsigned long long)record.timestamp_us,
+                      pcTaskGetName(publisher), record.msg_id, record.data_size, payload);
+        }
+    }
+
+    messagetrace_set_enabled(true);
+    return CLI_OK_STATUS;
+}
+#endif
+
+#if !MESSAGEBROKER_STATIC_ROUTES
+static int prv_cmd_msgbroker_watch(int argc, char* argv[], void* context)
+{
+    (void)context;
+
+    int topic = (argc == 3) ? atoi(argv[1]) : 0;
+    bool is_on = (argc == 3) && (strcmp(argv[2], "on") == 0);
+    bool is_off = (argc == 3) && (strcmp(argv[2], "off") == 0);
+    if ((topic <= E_TOPIC_FIRST_TOPIC) || (topic >= E_TOPIC_LAST_TOPIC) || (!is_on && !is_off))
+    {
+        cli_print("Usage: msgbroker_watch <topic> <on|off>, topic 1 .. %u", E_TOPIC_LAST_TOPIC - 1);
+        return CLI_FAIL_STATUS;
+    }
+
+    // Subscriptions change at runtime without stopping the publishers
+    if (is_on && !is_topic_watched[topic])
+    {
+        messagebroker_subscribe_queued((msg_id_e)topic, prv_watch_callback, prv_msg_queue);
+    }
+    else if (is_off && is_topic_watched[topic])
+    {
+        messagebroker_unsubscribe((msg_id_e)topic, prv_watch_callback);
+    }
+    is_topic_watched[topic] = is_on;
+
+    cli_print("Watching topic %d %s", topic, is_on ? "on" : "off");
+    return CLI_OK_STATUS;
+}
+
+static void prv_watch_callback(const msg_t* const message)
+{
+    char payload[3 * 8 + 1] = {0};
+    u16 nof_bytes = (message->data_size < 8) ? message->data_size : 8;
+    for (u16 b = 0; b < nof_bytes; b++)
+    {
+        snprintf(&payload[3 * b], 4, "%02X ", message->data_bytes[b]);
+    }
+    cli_print("[watch] %10llu ms topic %2u %3u B %s", (unsigned long long)monotonic_time_get_ms(), message->msg_id,
+              message->data_size, payload);
+}
+#endif
+
 // Desk Control Command Handlers
 static int prv_cmd_deskcontrol_move_command(int argc, char* argv[], void* context)
 {
@@ -341,7 +895,7 @@ static int prv_cmd_deskcontrol_move_command(int argc, char* argv[], void* contex
     }
 
     const char* command = argv[1];
-    static desk_command_e desk_cmd; // Static to persist after function returns
+    desk_command_e desk_cmd;
 
     // Parse command string to enum
     if (strcmp(command, "up") == 0)
@@ -388,12 +942,7 @@ static int prv_cmd_deskcontrol_move_command(int argc, char* argv[], void* contex
     }
 
     // Use MSG_1000 with the command enum as data
-    msg_t desk_msg;
-    desk_msg.msg_id = MSG_1000;
-    desk_msg.data_size = sizeof(desk_command_e);
-    desk_msg.data_bytes = (u8*)&desk_cmd;
-
-    messagebroker_publish(&desk_msg);
+    msg::publish<MSG_1000>(desk_cmd);
     cli_print("Moving desk: %s", command);
     return CLI_OK_STATUS;
 }
@@ -404,13 +953,18 @@ static int prv_cmd_deskcontrol_get_height(int argc, char* argv[], void* context)
     (void)argv;
     (void)context;
 
-    // Publish message to DeskControl requesting current height
-    msg_t height_msg;
-    height_msg.msg_id = MSG_1002; // Get Desk Height
-    height_msg.data_size = 0;
-    height_msg.data_bytes = NULL;
+    msg_desk_height_reply_t reply;
+    if (!prv_query<MSG_1002>(&reply, "DeskControl"))
+    {
+        return CLI_FAIL_STATUS;
+    }
 
-    messagebroker_publish(&height_msg);
+    if (!reply.is_valid)
+    {
+        cli_print("Height not available yet");
+        return CLI_OK_STATUS;
+    }
+    cli_print("Current height: %.1f cm", reply.height_cm);
     return CLI_OK_STATUS;
 }
 
@@ -426,7 +980,7 @@ static int prv_cmd_log_control(int argc, char* argv[], void* context)
     }
 
     // Parse enable/disable
-    static bool enable_logging; // Static so it persists after function returns
+    bool enable_logging;
     if (strcmp(argv[1], "on") == 0)
     {
         enable_logging = true;
@@ -441,28 +995,28 @@ static int prv_cmd_log_control(int argc, char* argv[], void* context)
         return CLI_FAIL_STATUS;
     }
 
-    // Parse module name and get corresponding message ID
-    msg_id_e msg_id;
+    // Parse module name and get the publish function of the corresponding message ID
+    void (*publish_logging_state)(const bool& is_enabled);
     const char* module_name;
 
     if (strcmp(argv[2], "appctrl") == 0)
     {
-        msg_id = MSG_0003;
+        publish_logging_state = msg::publish<MSG_0003, bool>;
         module_name = "ApplicationControl";
     }
     else if (strcmp(argv[2], "desk") == 0)
     {
-        msg_id = MSG_0004;
+        publish_logging_state = msg::publish<MSG_0004, bool>;
         module_name = "DeskControl";
     }
     else if (strcmp(argv[2], "presence") == 0)
     {
-        msg_id = MSG_0005;
+        publish_logging_state = msg::publish<MSG_0005, bool>;
         module_name = "PresenceDetector";
     }
     else if (strcmp(argv[2], "nettime") == 0)
     {
-        msg_id = MSG_0006;
+        publish_logging_state = msg::publish<MSG_0006, bool>;
         module_name = "NetworkTime";
     }
     else
@@ -472,12 +1026,7 @@ static int prv_cmd_log_control(int argc, char* argv[], void* context)
     }
 
     // Publish logging control message
-    msg_t log_msg;
-    log_msg.msg_id = msg_id;
-    log_msg.data_size = sizeof(bool);
-    log_msg.data_bytes = (u8*)&enable_logging;
-
-    messagebroker_publish(&log_msg);
+    publish_logging_state(enable_logging);
 
     return CLI_OK_STATUS;
 }
@@ -501,16 +1050,46 @@ static int prv_cmd_timer_start_countdown(int argc, char* argv[], void* context)
         return CLI_FAIL_STATUS;
     }
 
-    // Convert seconds to milliseconds
-    uint32_t countdown_time_ms = (uint32_t)seconds * 1000;
+    u32 countdown_time_ms = (u32)seconds * 1000; // Convert seconds to milliseconds
+    msg::publish<MSG_3001>(countdown_time_ms); // Start countdown
+    cli_print("Starting %d second countdown timer...", seconds);
+    return CLI_OK_STATUS;
+}
 
-    msg_t timer_msg;
-    timer_msg.msg_id = MSG_3001; // Start countdown
-    timer_msg.data_size = sizeof(uint32_t);
-    timer_msg.data_bytes = (u8*)&countdown_time_ms;
+static int prv_cmd_timer_list(int argc, char* argv[], void* context)
+{
+    (void)argc;
+    (void)argv;
+    (void)context;
 
-    messagebroker_publish(&timer_msg);
-    cli_print("Starting %d second countdown timer...", seconds);
+    static const char* const timer_names[TIMER_ID_LAST] = {"countdown", "presence scan", "time sync", "presence grace"};
+
+    msg_timers_reply_t reply;
+    if (!prv_query<MSG_3007>(&reply, "TimerManager"))
+    {
+        return CLI_FAIL_STATUS;
+    }
+
+    cli_print("%-14s | %s", "timer", "expires in");
+    for (u8 timer_id = 0; timer_id < TIMER_ID_LAST; timer_id++)
+    {
+        if ((reply.active_mask & (1UL << timer_id)) != 0)
+        {
+            u32 remaining_ms = reply.remaining_ms[timer_id];
+            cli_print("%-14s | %lu.%03lu s", timer_names[timer_id], (unsigned long)(remaining_ms / 1000),
+                      (unsigned long)(remaining_ms % 1000));
+        }
+        else if ((reply.paused_mask & (1UL << timer_id)) != 0)
+        {
+            u32 remaining_ms = reply.remaining_ms[timer_id];
+            cli_print("%-14s | paused, %lu.%03lu s left", timer_names[timer_id], (unsigned long)(remaining_ms / 1000),
+                      (unsigned long)(remaining_ms % 1000));
+        }
+        else
+        {
+            cli_print("%-14s | stopped", timer_names[timer_id]);
+        }
+    }
     return CLI_OK_STATUS;
 }
 
@@ -526,8 +1105,7 @@ static int prv_cmd_pd_set_threshold(int argc, char* argv[], void* context)
     }
 
     // Parse the threshold argument
-    static int threshold = 0; // Static to persist after function returns
-    threshold = atoi(argv[1]);
+    s32 threshold = atoi(argv[1]);
     if (threshold <= 0)
     {
         cli_print("Error: threshold must be a positive number");
@@ -535,13 +1113,8 @@ static int prv_cmd_pd_set_threshold(int argc, char* argv[], void* context)
     }
 
     // Publish message to PresenceDetector
-    msg_t threshold_msg;
-    threshold_msg.msg_id = MSG_2003; // Set Presence Threshold
-    threshold_msg.data_size = sizeof(int);
-    threshold_msg.data_bytes = (u8*)&threshold;
-
-    messagebroker_publish(&threshold_msg);
-    cli_print("Presence threshold set to %d devices", threshold);
+    msg::publish<MSG_2003>(threshold); // Set Presence Threshold
+    cli_print("Presence threshold set to %ld devices", (long)threshold);
     return CLI_OK_STATUS;
 }
 
@@ -551,13 +1124,13 @@ static int prv_cmd_pd_get_threshold(int argc, char* argv[], void* context)
     (void)argv;
     (void)context;
 
-    // Publish message to PresenceDetector requesting current threshold
-    msg_t get_threshold_msg;
-    get_threshold_msg.msg_id = MSG_2004; // Get Presence Threshold
-    get_threshold_msg.data_size = 0;
-    get_threshold_msg.data_bytes = NULL;
+    msg_presence_threshold_reply_t reply;
+    if (!prv_query<MSG_2004>(&reply, "PresenceDetector"))
+    {
+        return CLI_FAIL_STATUS;
+    }
 
-    messagebroker_publish(&get_threshold_msg);
+    cli_print("Current threshold: %ld devices", (long)reply.threshold);
     return CLI_OK_STATUS;
 }
 
@@ -580,17 +1153,10 @@ static int prv_cmd_appctrl_set_timer_interval(int argc, char* argv[], void* cont
         return CLI_FAIL_STATUS;
     }
 
-    // Store as static to persist beyond function scope
-    static u32 timer_interval = 0;
-    timer_interval = (u32)minutes * 60 * 1000; // Convert minutes to milliseconds
+    u32 timer_interval = (u32)minutes * 60 * 1000; // Convert minutes to milliseconds
 
     // Publish message to ApplicationControl
-    msg_t timer_msg;
-    timer_msg.msg_id = MSG_4001; // Set Timer Interval
-    timer_msg.data_size = sizeof(u32);
-    timer_msg.data_bytes = (u8*)&timer_interval;
-
-    messagebroker_publish(&timer_msg);
+    msg::publish<MSG_4001>(timer_interval); // Set Timer Interval
     cli_print("Timer interval set to %d minutes", minutes);
     return CLI_OK_STATUS;
 }
@@ -601,13 +1167,13 @@ static int prv_cmd_appctrl_get_timer_interval(int argc, char* argv[], void* cont
     (void)argv;
     (void)context;
 
-    // Publish message to ApplicationControl requesting current timer interval
-    msg_t get_timer_msg;
-    get_timer_msg.msg_id = MSG_4002; // Get Timer Interval
-    get_timer_msg.data_size = 0;
-    get_timer_msg.data_bytes = NULL;
+    msg_timer_interval_reply_t reply;
+    if (!prv_query<MSG_4002>(&reply, "ApplicationControl"))
+    {
+        return CLI_FAIL_STATUS;
+    }
 
-    messagebroker_publish(&get_timer_msg);
+    cli_print("Current timer interval: %lu minutes", (unsigned long)(reply.interval_ms / 60000));
     return CLI_OK_STATUS;
 }
 
@@ -617,13 +1183,22 @@ static int prv_cmd_appctrl_get_elapsed_time(int argc, char* argv[], void* contex
     (void)argv;
     (void)context;
 
-    // Publish message to ApplicationControl requesting elapsed time since last move
-    msg_t get_elapsed_msg;
-    get_elapsed_msg.msg_id = MSG_4003; // Get Elapsed Time Since Last Move
-    get_elapsed_msg.data_size = 0;
-    get_elapsed_msg.data_bytes = NULL;
+    msg_elapsed_time_reply_t reply;
+    if (!prv_query<MSG_4003>(&reply, "ApplicationControl"))
+    {
+        return CLI_FAIL_STATUS;
+    }
+
+    if (!reply.is_running)
+    {
+        cli_print("Timer is not currently running");
+        return CLI_OK_STATUS;
+    }
 
-    messagebroker_publish(&get_elapsed_msg);
+    u32 elapsed_seconds = reply.elapsed_ms / 1000;
+    cli_print("Timer %s for: %lu minutes, %lu seconds (of %lu minutes total)",
+              reply.is_paused ? "paused after running" : "running", (unsigned long)(elapsed_seconds / 60),
+              (unsigned long)(elapsed_seconds % 60), (unsigned long)(reply.interval_ms / 60000));
     return CLI_OK_STATUS;
 }
 
@@ -642,16 +1217,16 @@ static int prv_cmd_wifi_set_credentials(int argc, char* argv[], void* context)
     const char* password = argv[2];
 
     // Publish message to NetworkTime to set WiFi credentials
-    // Create a static buffer to hold the credentials data
-    static char credentials_buffer[100];
-    snprintf(credentials_buffer, sizeof(credentials_buffer), "%s|%s", ssid, password);
-
-    msg_t wifi_msg;
-    wifi_msg.msg_id = MSG_5001; // Set WiFi Credentials
-    wifi_msg.data_size = strlen(credentials_buffer) + 1;
-    wifi_msg.data_bytes = (u8*)credentials_buffer;
+    // The credentials are formatted directly into a pool block
+    char* credentials_buffer = (char*)prv_alloc_payload(MESSAGEPOOL_BLOCK_SIZE);
+    if (credentials_buffer == NULL)
+    {
+        return CLI_FAIL_STATUS;
+    }
+    snprintf(credentials_buffer, MESSAGEPOOL_BLOCK_SIZE, "%s|%s", ssid, password);
 
-    messagebroker_publish(&wifi_msg);
+    msg::publish_text<MSG_5001>(credentials_buffer); // Set WiFi Credentials
+    messagepool_release(credentials_buffer);
 
     cli_print("WiFi credentials set. Connecting...");
     return CLI_OK_STATUS;
@@ -664,12 +1239,7 @@ static int prv_cmd_wifi_get_credentials(int argc, char* argv[], void* context)
     (void)context;
 
     // Publish message to NetworkTime requesting WiFi credentials
-    msg_t wifi_msg;
-    wifi_msg.msg_id = MSG_5002; // Get WiFi Credentials
-    wifi_msg.data_size = 0;
-    wifi_msg.data_bytes = NULL;
-
-    messagebroker_publish(&wifi_msg);
+    msg::publish<MSG_5002>(); // Get WiFi Credentials
     return CLI_OK_STATUS;
 }
 
@@ -679,13 +1249,22 @@ static int prv_cmd_wifi_get_status(int argc, char* argv[], void* context)
     (void)argv;
     (void)context;
 
-    // Publish message to NetworkTime requesting WiFi status
-    msg_t status_msg;
-    status_msg.msg_id = MSG_5003; // Get WiFi Status
-    status_msg.data_size = 0;
-    status_msg.data_bytes = NULL;
+    msg_wifi_status_reply_t reply;
+    if (!prv_query<MSG_5003>(&reply, "NetworkTime"))
+    {
+        return CLI_FAIL_STATUS;
+    }
+
+    if (!reply.is_connected)
+    {
+        cli_print("WiFi Status: Disconnected");
+        return CLI_OK_STATUS;
+    }
 
-    messagebroker_publish(&status_msg);
+    // The first octet is in the lowest byte
+    cli_print("WiFi Status: Connected to %s (IP: %u.%u.%u.%u)", reply.ssid, (unsigned)(reply.ip_address & 0xFF),
+              (unsigned)((reply.ip_address >> 8) & 0xFF), (unsigned)((reply.ip_address >> 16) & 0xFF),
+              (unsigned)((reply.ip_address >> 24) & 0xFF));
     return CLI_OK_STATUS;
 }
 
@@ -695,12 +1274,21 @@ static int prv_cmd_time_get_info(int argc, char* argv[], void* context)
     (void)argv;
     (void)context;
 
-    // Publish message to NetworkTime requesting time info
-    msg_t time_msg;
-    time_msg.msg_id = MSG_5004; // Get Time Info
-    time_msg.data_size = 0;
-    time_msg.data_bytes = NULL;
+    msg_time_info_reply_t reply;
+    if (!prv_query<MSG_5004>(&reply, "NetworkTime"))
+    {
+        return CLI_FAIL_STATUS;
+    }
 
-    messagebroker_publish(&time_msg);
+    if (!reply.is_synchronized)
+    {
+        cli_print("Time not synchronized");
+        return CLI_OK_STATUS;
+    }
+
+    const char* weekdays[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+    cli_print("Current time: %s, %04u-%02u-%02u %02u:%02u:%02u", weekdays[reply.weekday % 7], reply.year,
+              reply.month, reply.day, reply.hour, reply.minute, reply.second);
     return CLI_OK_STATUS;
 }
+
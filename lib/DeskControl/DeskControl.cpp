@@ -1,12 +1,16 @@
 #include "DeskControl.h"
 #include <Arduino.h>
+#include "Executor.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "MessageBroker.h"
 #include "MessageDefinitions.h"
+#include "MessageSchema.h"
 #include "custom_assert.h"
+#include "rtos_alloc.h"
+#include "test_support.h"
 
 // ###########################################################################
 // # Internal Configuration and Protocol Constants
@@ -44,9 +48,9 @@ const uint8_t CMD_PRESET4[FRAME_LENGTH] = {0x9B, 0x06, 0x02, 0x00, 0x01, 0xAC, 0
 // # Private function declarations
 // ###########################################################################
 static void prv_deskcontrol_task(void* parameter);
-static void prv_deskcontrol_init(void);
+STATIC void prv_deskcontrol_init(void);
 static void prv_deskcontrol_run(void);
-static void prv_msg_broker_callback(const msg_t* const message);
+static void prv_uart_receive_callback(void);
 static void prv_set_frame(const uint8_t* f);
 static void prv_disarm(void);
 static void prv_arm_with(const uint8_t* f);
@@ -65,6 +69,9 @@ static void prv_parse_height_message(const uint8_t* msg, size_t len);
 // Logging control
 static bool prv_logging_enabled = false;
 
+// Delivery queue of this task
+static msg_queue_t* prv_msg_queue = NULL;
+
 // State variables
 static uint8_t current_frame[FRAME_LENGTH];
 static bool armed = false;
@@ -94,17 +101,39 @@ TaskHandle_t deskcontrol_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_deskcontrol_task, // Task function
-                "DeskControlTask",    // Task name
-                4096,                 // Stack size (words)
-                NULL,                 // Task parameters
-                2,                    // Task priority
-                &task_handle          // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[DESKCONTROL_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_deskcontrol_task,   // Task function
+                                    "DeskControlTask",      // Task name
+                                    DESKCONTROL_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                   // Task parameters
+                                    2,                      // Task priority
+                                    task_stack,             // Task stack
+                                    &task_buffer            // Task control block
+    );
+#else
+    xTaskCreate(prv_deskcontrol_task,   // Task function
+                "DeskControlTask",      // Task name
+                DESKCONTROL_STACK_SIZE, // Stack size (bytes)
+                NULL,                   // Task parameters
+                2,                      // Task priority
+                &task_handle            // Task handle
     );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
 
+void deskcontrol_add_to_executor(void)
+{
+    // Received UART data is announced with MSG_1003, the callbacks do all the work
+    static const executor_module_t module = {"DeskControl", prv_deskcontrol_init, NULL};
+    executor_register(&module);
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
@@ -119,14 +148,12 @@ static void prv_deskcontrol_task(void* parameter)
     // Task main loop
     while (1)
     {
-        // Run the desk control processing
-        prv_deskcontrol_run();
-
-        delay(5);
+        // Sleep until a message arrives - received UART data is announced with MSG_1003
+        messagebroker_queue_process(prv_msg_queue, MESSAGEBROKER_WAIT_FOREVER);
     }
 }
 
-static void prv_deskcontrol_init(void)
+STATIC void prv_deskcontrol_init(void)
 {
     // Initialize UART for desk communication
     pinMode(WAKEUP_PIN, OUTPUT);
@@ -134,6 +161,7 @@ static void prv_deskcontrol_init(void)
 
     // Initialize UART: 9600 baud, 8N1
     SERIAL_INTERFACE.begin(9600, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    SERIAL_INTERFACE.onReceive(prv_uart_receive_callback);
 
     // Initialize state
     armed = false;
@@ -150,10 +178,14 @@ static void prv_deskcontrol_init(void)
     g_in_message = false;
     memset(g_msg_buffer, 0, sizeof(g_msg_buffer));
 
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
     // Subscribe to relevant messages
-    messagebroker_subscribe(MSG_0004, prv_msg_broker_callback); // Logging control
-    messagebroker_subscribe(MSG_1000, prv_msg_broker_callback); // desk command
-    messagebroker_subscribe(MSG_1002, prv_msg_broker_callback); // get desk height
+    messagebroker_subscribe_queued(MSG_0004, deskcontrol_msg_broker_callback, prv_msg_queue); // Logging control
+    messagebroker_subscribe_queued(MSG_1000, deskcontrol_msg_broker_callback, prv_msg_queue); // desk command
+    messagebroker_subscribe_queued(MSG_1002, deskcontrol_msg_broker_callback, prv_msg_queue); // get desk height
+    messagebroker_subscribe_queued(MSG_1003, deskcontrol_msg_broker_callback, prv_msg_queue); // UART data received
 }
 
 static void prv_deskcontrol_run(void)
@@ -237,60 +269,66 @@ static void prv_deskcontrol_run(void)
     }
 }
 
+static void prv_uart_receive_callback(void)
+{
+    // Runs in the UART event task of the Arduino core (HardwareSerial::onReceive), not in an ISR.
+    // The ISR ring only hands the notification over, so the bytes are parsed in the DeskControl task
+    // by prv_deskcontrol_run() on delivery of MSG_1003 and not in the driver's task. publish_from_isr
+    // works from task context because mb_port_signal_give_from_isr() checks xPortInIsrContext().
+    // A dropped notification is harmless, the desk sends continuously and the next one drains the UART
+    (void)msg::publish_from_isr<MSG_1003>();
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
 
-static void prv_msg_broker_callback(const msg_t* const message)
+void deskcontrol_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
     switch (message->msg_id)
     {
         case MSG_0004: // Set Logging State
-            if (message->data_size == sizeof(bool))
-            {
-                prv_logging_enabled = *(bool*)(message->data_bytes);
-                Serial.print("[DeskCtrl] Logging ");
-                Serial.println(prv_logging_enabled ? "enabled" : "disabled");
-            }
+            prv_logging_enabled = msg::payload<MSG_0004>(message);
+            Serial.print("[DeskCtrl] Logging ");
+            Serial.println(prv_logging_enabled ? "enabled" : "disabled");
             break;
 
         case MSG_1000: // Unified desk command
-            if (message->data_size == sizeof(desk_command_e) && message->data_bytes != NULL)
-            {
-
-                desk_command_e cmd = *(desk_command_e*)(message->data_bytes);
-
-                ASSERT(cmd > DESK_CMD_NONE);
-                ASSERT(cmd < DESK_CMD_LAST);
-
-                if (cmd == DESK_CMD_TOGGLE)
-                {
-                    cmd = (g_last_toggle_position == DESK_CMD_PRESET1) ? DESK_CMD_PRESET2 : DESK_CMD_PRESET1;
-                    g_last_toggle_position = cmd;
-                }
-                if (prv_logging_enabled)
-                {
-                    Serial.print("[DeskCtrl] Command: ");
-                    Serial.println(cmd);
-                }
+        {
+            desk_command_e cmd = msg::payload<MSG_1000>(message);
 
-                prv_execute_command(cmd);
-            }
-            break;
+            ASSERT(cmd > DESK_CMD_NONE);
+            ASSERT(cmd < DESK_CMD_LAST);
 
-        case MSG_1002: // Get desk height
-            if (g_height_valid)
+            if (cmd == DESK_CMD_TOGGLE)
             {
-                Serial.print("[DeskCtrl] Current height: ");
-                Serial.print(g_current_height_cm);
-                Serial.println(" cm");
+                cmd = (g_last_toggle_position == DESK_CMD_PRESET1) ? DESK_CMD_PRESET2 : DESK_CMD_PRESET1;
+                g_last_toggle_position = cmd;
             }
-            else
+            if (prv_logging_enabled)
             {
-                Serial.println("[DeskCtrl] Height not available yet");
+                Serial.print("[DeskCtrl] Command: ");
+                Serial.println(cmd);
             }
+
+            prv_execute_command(cmd);
+        }
+        break;
+
+        case MSG_1002: // Get desk height
+        {
+            msg_desk_height_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+            reply.is_valid = g_height_valid;
+            reply.height_cm = g_current_height_cm;
+            msg::reply<MSG_1002>(message, reply);
+        }
+        break;
+
+        case MSG_1003: // UART data received
+            prv_deskcontrol_run();
             break;
 
         default:
@@ -5,6 +5,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define DESKCONTROL_STACK_SIZE 4096 // Task stack in bytes
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -16,6 +18,12 @@ extern "C"
      */
     TaskHandle_t deskcontrol_create_task(void);
 
+    /**
+     * @brief Registers the DeskControl with the cooperative executor
+     *        (EXECUTOR_COOPERATIVE), instead of creating its task
+     */
+    void deskcontrol_add_to_executor(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,100 @@
+#include "Executor.h"
+#include <Arduino.h>
+#include "MessageBroker.h"
+#include "custom_assert.h"
+#include "rtos_alloc.h"
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+static void prv_executor_task(void* parameter);
+
+// ###########################################################################
+// # Private variables
+// ###########################################################################
+
+static const executor_module_t* prv_modules[EXECUTOR_MAX_MODULES];
+static u8 prv_nof_modules = 0;
+static bool prv_is_started = false;
+
+// ###########################################################################
+// # Public function implementations
+// ###########################################################################
+
+void executor_register(const executor_module_t* module)
+{
+    ASSERT(module != NULL);
+    ASSERT(module->init != NULL);
+    ASSERT(!prv_is_started);
+    ASSERT(prv_nof_modules < EXECUTOR_MAX_MODULES); // Increase EXECUTOR_MAX_MODULES
+
+    prv_modules[prv_nof_modules++] = module;
+}
+
+TaskHandle_t executor_create_task(void)
+{
+    TaskHandle_t task_handle = NULL;
+
+    ASSERT(!prv_is_started);
+    prv_is_started = true;
+
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[EXECUTOR_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_executor_task,   // Task function
+                                    "ExecutorTask",      // Task name
+                                    EXECUTOR_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                // Task parameters
+                                    2,                   // Task priority
+                                    task_stack,          // Task stack
+                                    &task_buffer         // Task control block
+    );
+#else
+    xTaskCreate(prv_executor_task,   // Task function
+                "ExecutorTask",      // Task name
+                EXECUTOR_STACK_SIZE, // Stack size (bytes)
+                NULL,                // Task parameters
+                2,                   // Task priority
+                &task_handle         // Task handle
+    );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
+
+    return task_handle;
+}
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+
+static void prv_executor_task(void* parameter)
+{
+    (void)parameter; // Unused parameter
+
+    for (u8 i = 0; i < prv_nof_modules; i++)
+    {
+        prv_modules[i]->init();
+    }
+
+    // Created by the first module that subscribes, or here if none does
+    msg_queue_t* queue = messagebroker_queue_get_context_queue();
+
+    // Task main loop
+    while (1)
+    {
+        // Every wake-up runs all modules: the queue does not tell whose event woke it
+        u32 wait_ms = MESSAGEBROKER_WAIT_FOREVER;
+        for (u8 i = 0; i < prv_nof_modules; i++)
+        {
+            if (prv_modules[i]->run != NULL)
+            {
+                u32 next_run_ms = prv_modules[i]->run();
+                wait_ms = (next_run_ms < wait_ms) ? next_run_ms : wait_ms;
+            }
+        }
+
+        // Sleep until a message, a notification of a module or the earliest deadline
+        messagebroker_queue_process(queue, wait_ms);
+    }
+}
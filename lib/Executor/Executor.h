@@ -0,0 +1,60 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "custom_types.h"
+
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// 1 = one cooperative executor task runs the modules, 0 = every module creates its own task
+#ifndef EXECUTOR_COOPERATIVE
+#define EXECUTOR_COOPERATIVE 0
+#endif
+
+// Task stack in bytes, the largest stack of the hosted modules (BLE scan evaluation of the PresenceDetector)
+#define EXECUTOR_STACK_SIZE 8192
+
+// Modules that can register with the executor
+#ifndef EXECUTOR_MAX_MODULES
+#define EXECUTOR_MAX_MODULES 8U
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * Hooks of a module that runs in the cooperative executor.
+     *
+     * The modules share the executor task and its delivery queue (see
+     * messagebroker_queue_get_context_queue()), a hook must never block: the other modules
+     * only run when it returns.
+     */
+    typedef struct
+    {
+        const char* name;
+        void (*init)(void); // Called once from the executor task, in the order of registration
+        u32 (*run)(void);   // Called after every wake-up of the executor, NULL = callbacks only.
+                            // Returns the ms until it has to run again without an event or
+                            // MESSAGEBROKER_WAIT_FOREVER - an event of another module may call it earlier
+    } executor_module_t;
+
+    /**
+     * @brief Adds a module to the executor, only before executor_create_task()
+     * @param module Hooks of the module, must stay valid (static)
+     */
+    void executor_register(const executor_module_t* module);
+
+    /**
+     * @brief Creates and starts the executor task, which initializes and runs the registered modules
+     * @return Task handle for the created task
+     */
+    TaskHandle_t executor_create_task(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // EXECUTOR_H
@@ -1,27 +1,238 @@
 #include "MessageBroker.h"
+#include <string.h>
+#include "MessageBrokerPort.h"
+#include "MessageCoalescing.h"
+#include "MessagePool.h"
+#include "MessagePriorities.h"
+#include "MessageRetained.h"
+#include "MessageRpc.h"
+#include "MessageTrace.h"
 #include "custom_assert.h"
 
 // ---------------------------------------------------------------------------
 // Defines and Macros
 // ---------------------------------------------------------------------------
-#define MESSAGE_BROKER_CALLBACK_ARRAY_SIZE 10U
+// Distinct subscriber callbacks, one bit each in the per-topic subscriber mask
+#define MESSAGEBROKER_MAX_SUBSCRIBERS 32U
 
 // ---------------------------------------------------------------------------
 // Private Types
 // ---------------------------------------------------------------------------
 typedef struct
+{
+    msg_callback_t callback;
+    msg_queue_t* queue; // NULL for synchronous delivery
+} msg_subscriber_t;
+
+typedef u32 msg_subscriber_mask_t;
+
+// Bit per queue of the queue pool, set while a publish has queued messages it has not signalled yet
+typedef u32 msg_queue_mask_t;
+
+typedef enum
+{
+    COALESCE_NONE = 0, // Every message is queued
+    COALESCE_LATEST,
+    COALESCE_DUPLICATES,
+} msg_coalescing_e;
+
+typedef struct
+{
+    u8 subscriber_index;
+    msg_id_e msg_id;
+    u16 data_size;
+    u8* data_bytes; // Pooled payload, the entry holds one reference
+#if MESSAGEBROKER_INSTRUMENTATION
+    u32 enqueue_cycles;
+#endif
+} msg_queue_entry_t;
+
+// FIFO of the queued messages of one priority class
+typedef struct
+{
+    msg_queue_entry_t entries[MESSAGEBROKER_QUEUE_DEPTH];
+    u16 head;
+    u16 count;
+} msg_queue_lane_t;
+
+#define MESSAGEBROKER_RETAINED_SLOT_ID(slot) slot,
+typedef enum
+{
+    RETAINED_SLOT_NONE = 0, // Topic is not retained
+    MESSAGE_RETAINED_SLOTS(MESSAGEBROKER_RETAINED_SLOT_ID) E_RETAINED_SLOT_COUNT
+} msg_retained_slot_id_e;
+
+// Last published message of a group of retained topics
+typedef struct
+{
+    bool is_valid;
+    msg_id_e msg_id;
+    u16 data_size;
+    u8* data_bytes; // Pooled payload, the slot holds one reference
+} msg_retained_slot_t;
+
+// Message published from inside a callback, waiting for the running fan-out to finish
+typedef struct
 {
     msg_id_e msg_id;
-    msg_callback_t callback_array[MESSAGE_BROKER_CALLBACK_ARRAY_SIZE];
-} msg_topic_t;
+    u16 data_size;
+    u8* data_bytes; // Pooled payload, the entry holds one reference
+} msg_deferred_entry_t;
+
+// Lives on the stack of the outermost messagebroker_publish() of a task
+typedef struct
+{
+    msg_deferred_entry_t entries[MESSAGEBROKER_DEFERRED_DEPTH];
+    u16 head;
+    u16 count;
+} msg_deferred_fifo_t;
+
+// Slot of the ISR ring, sequence tells producers and the consumer whose turn it is
+typedef struct
+{
+    u32 sequence;
+    msg_id_e msg_id;
+    u16 data_size;
+    u8 data_bytes[MESSAGEBROKER_ISR_PAYLOAD_SIZE];
+} msg_isr_slot_t;
+
+_Static_assert((MESSAGEBROKER_ISR_QUEUE_DEPTH & (MESSAGEBROKER_ISR_QUEUE_DEPTH - 1U)) == 0,
+               "MESSAGEBROKER_ISR_QUEUE_DEPTH must be a power of two");
+_Static_assert(MESSAGEBROKER_MAX_QUEUES <= 32U, "msg_queue_mask_t has one bit per queue");
+
+struct msg_queue
+{
+    msg_queue_lane_t lanes[E_MSG_PRIORITY_COUNT];
+    u32 dropped_count;
+    u32 coalesced_count;
+    u32 wakeup_count;  // Returns from the wait in messagebroker_queue_process()
+    u32 timeout_count; // ... because the timeout expired
+    void* owner;       // Context that created the queue, see mb_port_get_context()
+    mb_port_signal_t signal;
+};
+
+// ---------------------------------------------------------------------------
+// Private Function Declarations
+// ---------------------------------------------------------------------------
+#if !MESSAGEBROKER_STATIC_ROUTES
+static void prv_subscribe(msg_id_e topic, msg_callback_t callback, msg_queue_t* queue);
+static u8 prv_get_subscriber_index(msg_callback_t callback, msg_queue_t* queue);
+static bool prv_is_subscribed(u8 subscriber_index, msg_id_e topic);
+#endif
+static void prv_publish(const msg_t* const messages, u16 nof_messages);
+static void prv_fan_out(const msg_t* const message, msg_queue_mask_t* wake_mask);
+static void prv_wake_queues(msg_queue_mask_t wake_mask);
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+static void prv_set_wake_queue(u8 subscriber_index, msg_queue_t* queue);
+static void prv_add_wake_queue(u8 subscriber_index, msg_queue_mask_t* wake_mask);
+#endif
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+static msg_deferred_fifo_t* prv_get_dispatch_fifo(void* context);
+static void prv_defer(msg_deferred_fifo_t* fifo, const msg_t* const message);
+#endif
+static void prv_enqueue(msg_queue_t* queue, u8 subscriber_index, const msg_t* const message, u8** pooled_payload,
+                        msg_queue_mask_t* wake_mask);
+static msg_queue_entry_t* prv_find_pending(msg_queue_lane_t* lane, u8 subscriber_index, msg_id_e msg_id);
+static msg_queue_lane_t* prv_get_next_lane(msg_queue_t* queue, u8* priority);
+static u8* prv_acquire_pooled_payload(const msg_t* const message, u8** pooled_payload);
+static msg_subscriber_mask_t prv_store_retained(const msg_t* const message, u8** pooled_payload);
+#if !MESSAGEBROKER_STATIC_ROUTES
+static void prv_replay_retained(msg_id_e topic, u8 subscriber_index, const msg_retained_slot_t* retained);
+#endif
+static void prv_invoke(u8 subscriber_index, const msg_t* const message);
+static u32 prv_read_lock(void);
+static void prv_read_unlock(u32 epoch);
+#if MESSAGEBROKER_INSTRUMENTATION
+static void prv_record_callback_duration(u8 subscriber_index, u32 cycles);
+static void prv_record_lane_drop(u8 priority);
+static void prv_record_lane_wait(u8 priority, u32 cycles);
+static u8 prv_get_histogram_bucket(u32 cycles);
+static void prv_update_max(u32* max_cycles, u32 cycles);
+#endif
 
 // ---------------------------------------------------------------------------
 // Private Variables
 // ---------------------------------------------------------------------------
-static msg_topic_t* topic_library[E_TOPIC_LAST_TOPIC] = {NULL};
-static msg_topic_t topics[E_TOPIC_LAST_TOPIC] = {0};
+#if MESSAGEBROKER_STATIC_ROUTES
+// Generated from MessageRoutes.h - both tables are const and stay in flash
+#define MESSAGEBROKER_SUBSCRIBER_ENTRY(id, callback) [id] = {callback, NULL},
+static const msg_subscriber_t subscribers[E_SUBSCRIBER_COUNT] = {MESSAGE_SUBSCRIBERS(MESSAGEBROKER_SUBSCRIBER_ENTRY)};
+
+#define MESSAGEBROKER_ROUTE_ENTRY(topic, subscriber_mask) [topic] = (subscriber_mask),
+static const msg_subscriber_mask_t topic_subscriber_masks[E_TOPIC_LAST_TOPIC] = {
+    MESSAGE_ROUTES(MESSAGEBROKER_ROUTE_ENTRY)};
+
+// A topic that is routed twice fails here with a redeclared enumerator
+#define MESSAGEBROKER_ROUTE_UNIQUE(topic, subscriber_mask) msg_route_defined_once_##topic,
+enum
+{
+    MESSAGE_ROUTES(MESSAGEBROKER_ROUTE_UNIQUE)
+};
+
+_Static_assert(E_SUBSCRIBER_COUNT <= MESSAGEBROKER_MAX_SUBSCRIBERS, "Too many subscribers for the route masks");
+#else
+// Written under mb_port_lock() only, publishers read them lock-free: a subscriber entry is
+// complete before its bit is set in a topic mask and never changes afterwards
+static msg_subscriber_t subscribers[MESSAGEBROKER_MAX_SUBSCRIBERS] = {0};
+static u8 nof_subscribers = 0;
+static msg_subscriber_mask_t topic_subscriber_masks[E_TOPIC_LAST_TOPIC] = {0};
+
+// Queued deliveries (and publishes without dispatch slots) in progress per epoch,
+// messagebroker_synchronize() drains both epochs one after the other
+static u32 reader_epoch = 0;
+static u32 nof_readers[2] = {0};
+static bool is_synchronizing = false;
+#endif
 static bool is_initialized = false;
 
+#define MESSAGEBROKER_RETAINED_TOPIC_ENTRY(topic, slot) [topic] = (slot),
+static const u8 topic_retained_slots[E_TOPIC_LAST_TOPIC] = {MESSAGE_RETAINED_TOPICS(MESSAGEBROKER_RETAINED_TOPIC_ENTRY)};
+static msg_retained_slot_t retained_slots[E_RETAINED_SLOT_COUNT] = {0};
+
+#define MESSAGEBROKER_COALESCED_TOPIC_ENTRY(topic, policy) [topic] = (policy),
+static const u8 topic_coalescing[E_TOPIC_LAST_TOPIC] = {MESSAGE_COALESCED_TOPICS(MESSAGEBROKER_COALESCED_TOPIC_ENTRY)};
+
+#define MESSAGEBROKER_PRIORITY_TOPIC_ENTRY(topic, priority) [topic] = (priority),
+static const u8 topic_priorities[E_TOPIC_LAST_TOPIC] = {
+    MESSAGE_PRIORITY_TOPICS(MESSAGEBROKER_PRIORITY_TOPIC_ENTRY)};
+
+// Lanes in the order messagebroker_queue_process() services them
+static const u8 lane_service_order[E_MSG_PRIORITY_COUNT] = {MSG_PRIORITY_HIGH, MSG_PRIORITY_NORMAL, MSG_PRIORITY_LOW};
+
+static msg_queue_t queue_pool[MESSAGEBROKER_MAX_QUEUES] = {0};
+static u16 nof_allocated_queues = 0;
+
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+// Queue of the task behind a messagebroker_subscribe_queued() subscriber. The callback runs in the
+// publisher, the queue is only woken afterwards so that its task runs on the new state.
+static msg_queue_t* subscriber_wake_queues[MESSAGEBROKER_MAX_SUBSCRIBERS] = {0};
+#endif
+
+// Lock-free ring for messagebroker_publish_from_isr(), drained by the dispatcher task
+static msg_isr_slot_t isr_ring[MESSAGEBROKER_ISR_QUEUE_DEPTH];
+static u32 isr_enqueue_position = 0; // Shared by all producers, claimed with compare-and-swap
+static u32 isr_dequeue_position = 0; // Only touched by the dispatcher task
+static u32 isr_dropped_count = 0;
+static mb_port_signal_t isr_signal;
+static msg_queue_t* isr_wake_queue = NULL; // Woken instead of isr_signal, see messagebroker_isr_queue_set_wake_queue()
+
+// Tasks that are currently dispatching and the FIFO for their nested publishes.
+// An owner entry is only ever claimed and cleared by the owning task itself.
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+static void* dispatch_owners[MESSAGEBROKER_MAX_DISPATCH_CONTEXTS] = {0};
+static msg_deferred_fifo_t* dispatch_fifos[MESSAGEBROKER_MAX_DISPATCH_CONTEXTS] = {0};
+// Incremented when a dispatch ends, messagebroker_synchronize() waits for the dispatches it saw
+static u32 dispatch_generations[MESSAGEBROKER_MAX_DISPATCH_CONTEXTS] = {0};
+#endif
+static u32 deferred_dropped_count = 0;
+
+#if MESSAGEBROKER_INSTRUMENTATION
+// Updated with relaxed atomics - publishers run in several tasks, but must not contend on a lock
+static msg_topic_stats_t topic_stats[E_TOPIC_LAST_TOPIC];
+static msg_subscriber_stats_t subscriber_stats[MESSAGEBROKER_MAX_SUBSCRIBERS];
+static msg_lane_stats_t lane_stats[E_MSG_PRIORITY_COUNT];
+#endif
+
 // ---------------------------------------------------------------------------
 // Public Function Implementations
 // ---------------------------------------------------------------------------
@@ -29,71 +240,1159 @@ void messagebroker_init(void)
 {
     ASSERT(!is_initialized);
 
-    for (u16 msg_id = (E_TOPIC_FIRST_TOPIC + 1); msg_id < E_TOPIC_LAST_TOPIC; msg_id++)
+#if !MESSAGEBROKER_STATIC_ROUTES
+    for (u16 msg_id = 0; msg_id < E_TOPIC_LAST_TOPIC; msg_id++)
     {
-        topics[msg_id].msg_id = msg_id;
+        topic_subscriber_masks[msg_id] = 0;
+    }
 
-        for (u16 i = 0; i < MESSAGE_BROKER_CALLBACK_ARRAY_SIZE; i++)
-        {
-            topics[msg_id].callback_array[i] = NULL;
-        }
+    for (u16 i = 0; i < MESSAGEBROKER_MAX_SUBSCRIBERS; i++)
+    {
+        subscribers[i].callback = NULL;
+        subscribers[i].queue = NULL;
+    }
+    nof_subscribers = 0;
+#endif
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+    for (u16 i = 0; i < MESSAGEBROKER_MAX_SUBSCRIBERS; i++)
+    {
+        subscriber_wake_queues[i] = NULL;
+    }
+#endif
+
+    messagepool_init();
 
-        topic_library[msg_id] = &topics[msg_id];
+    for (u8 i = 0; i < E_RETAINED_SLOT_COUNT; i++)
+    {
+        retained_slots[i].is_valid = false;
+        retained_slots[i].data_bytes = NULL;
     }
+
+    for (u32 i = 0; i < MESSAGEBROKER_ISR_QUEUE_DEPTH; i++)
+    {
+        isr_ring[i].sequence = i;
+    }
+    isr_enqueue_position = 0;
+    isr_dequeue_position = 0;
+    isr_dropped_count = 0;
+    mb_port_signal_init(&isr_signal);
+    isr_wake_queue = NULL;
+
+#if MESSAGEBROKER_INSTRUMENTATION
+    messagebroker_reset_stats();
+#endif
+
+#if MESSAGEBROKER_TRACE
+    messagetrace_init();
+#endif
+
     is_initialized = true;
+
+    // Subscribes to the reply topics, so it comes after the broker is ready
+    messagerpc_init();
 }
 
+#if !MESSAGEBROKER_STATIC_ROUTES
 void messagebroker_subscribe(msg_id_e topic, msg_callback_t in_function_ptr)
+{
+    prv_subscribe(topic, in_function_ptr, NULL);
+}
+
+void messagebroker_subscribe_queued(msg_id_e topic, msg_callback_t callback, msg_queue_t* queue)
+{
+    ASSERT(queue != NULL);
+
+#if MESSAGEBROKER_ASYNC_DISPATCH
+    prv_subscribe(topic, callback, queue);
+#else
+    // Before the subscription, so that the replay of a retained topic wakes the queue as well
+    mb_port_lock();
+    u8 subscriber_index = prv_get_subscriber_index(callback, NULL);
+    mb_port_unlock();
+    prv_set_wake_queue(subscriber_index, queue);
+
+    prv_subscribe(topic, callback, NULL);
+#endif
+}
+
+void messagebroker_unsubscribe(msg_id_e topic, msg_callback_t callback)
 {
     { // Input Checks
         ASSERT(topic > E_TOPIC_FIRST_TOPIC);
         ASSERT(topic < E_TOPIC_LAST_TOPIC);
-        ASSERT(in_function_ptr != NULL);
+        ASSERT(callback != NULL);
         ASSERT(is_initialized);
     }
 
-    bool is_subscribed = false;
-    bool is_already_subscribed = false;
+    mb_port_lock();
+    u8 subscriber_index = 0;
+    while ((subscriber_index < nof_subscribers) && (subscribers[subscriber_index].callback != callback))
+    {
+        subscriber_index++;
+    }
+    ASSERT(subscriber_index < nof_subscribers); // Never subscribed
+
+    msg_subscriber_mask_t subscriber_bit = (msg_subscriber_mask_t)1U << subscriber_index;
+    msg_subscriber_mask_t subscriber_mask = topic_subscriber_masks[topic];
+    ASSERT((subscriber_mask & subscriber_bit) != 0); // Not subscribed to this topic
 
-    for (u16 i = 0; i < MESSAGE_BROKER_CALLBACK_ARRAY_SIZE; i++)
+    // Ordered before the epoch flip of a following messagebroker_synchronize()
+    __atomic_store_n(&topic_subscriber_masks[topic], subscriber_mask & ~subscriber_bit, __ATOMIC_SEQ_CST);
+    mb_port_unlock();
+}
+
+void messagebroker_synchronize(void)
+{
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+    // The caller's own delivery would never finish
+    ASSERT(prv_get_dispatch_fifo(mb_port_get_context()) == NULL);
+#endif
+
+    // Grace periods do not overlap, the flips of another caller would skip an epoch
+    while (__atomic_exchange_n(&is_synchronizing, true, __ATOMIC_ACQUIRE))
     {
-        if (topic_library[topic]->callback_array[i] == NULL)
+        mb_port_yield();
+    }
+
+    // A delivery that still sees an old mask may have read the epoch before a flip, so it can
+    // count in either epoch - retire both. New deliveries only delay the epoch they joined.
+    for (u8 i = 0; i < 2U; i++)
+    {
+        u32 retired_epoch = __atomic_fetch_add(&reader_epoch, 1U, __ATOMIC_SEQ_CST) & 1U;
+        while (__atomic_load_n(&nof_readers[retired_epoch], __ATOMIC_SEQ_CST) != 0)
         {
-            topic_library[topic]->callback_array[i] = in_function_ptr;
-            is_subscribed = true;
-            break;
+            mb_port_yield();
         }
-        else if (topic_library[topic]->callback_array[i] == in_function_ptr)
+    }
+
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+    // Publishes are tracked by their dispatch slot, wait for the ones that are running now
+    for (u8 slot = 0; slot < MESSAGEBROKER_MAX_DISPATCH_CONTEXTS; slot++)
+    {
+        void* owner = __atomic_load_n(&dispatch_owners[slot], __ATOMIC_SEQ_CST);
+        if (owner == NULL)
         {
-            is_already_subscribed = true;
-            break;
+            continue;
+        }
+
+        u32 generation = __atomic_load_n(&dispatch_generations[slot], __ATOMIC_ACQUIRE);
+        while ((__atomic_load_n(&dispatch_owners[slot], __ATOMIC_ACQUIRE) == owner) &&
+               (__atomic_load_n(&dispatch_generations[slot], __ATOMIC_ACQUIRE) == generation))
+        {
+            mb_port_yield();
         }
     }
+#endif
 
-    ASSERT(is_subscribed);
-    ASSERT(false == is_already_subscribed);
+    __atomic_store_n(&is_synchronizing, false, __ATOMIC_RELEASE);
 }
+#else
+void messagebroker_subscribe_queued(msg_id_e topic, msg_callback_t callback, msg_queue_t* queue)
+{
+    { // Input Checks
+        ASSERT(topic > E_TOPIC_FIRST_TOPIC);
+        ASSERT(topic < E_TOPIC_LAST_TOPIC);
+        ASSERT(callback != NULL);
+        ASSERT(queue != NULL);
+        ASSERT(is_initialized);
+    }
+
+    // The route is fixed, the call only tells the broker which task to wake after the callback
+    u8 subscriber_index = 0;
+    while ((subscriber_index < E_SUBSCRIBER_COUNT) && (subscribers[subscriber_index].callback != callback))
+    {
+        subscriber_index++;
+    }
+    ASSERT(subscriber_index < E_SUBSCRIBER_COUNT);                                    // Add to MESSAGE_SUBSCRIBERS
+    ASSERT((topic_subscriber_masks[topic] & SUBSCRIBER_BIT(subscriber_index)) != 0); // Add to MESSAGE_ROUTES
+
+    prv_set_wake_queue(subscriber_index, queue);
+}
+#endif
 
 void messagebroker_publish(const msg_t* const message)
+{
+    { // Input Checks
+        ASSERT(message != NULL);
+    }
+
+    prv_publish(message, 1);
+}
+
+void messagebroker_publish_batch(const msg_t* const messages, u16 nof_messages)
+{
+    { // Input Checks
+        ASSERT(messages != NULL);
+    }
+
+    prv_publish(messages, nof_messages);
+}
+
+u32 messagebroker_get_deferred_dropped_count(void)
+{
+    return __atomic_load_n(&deferred_dropped_count, __ATOMIC_RELAXED);
+}
+
+bool messagebroker_publish_from_isr(const msg_t* const message)
 {
     { // Input Checks
         ASSERT(is_initialized);
         ASSERT(message != NULL);
         ASSERT(message->msg_id > E_TOPIC_FIRST_TOPIC);
         ASSERT(message->msg_id < E_TOPIC_LAST_TOPIC);
+        ASSERT(message->data_size <= MESSAGEBROKER_ISR_PAYLOAD_SIZE); // Increase MESSAGEBROKER_ISR_PAYLOAD_SIZE
+        ASSERT((message->data_size == 0) || (message->data_bytes != NULL));
+    }
+
+    // Claim a slot - never blocks and never takes a lock, so nested interrupts are fine
+    msg_isr_slot_t* slot = NULL;
+    u32 position = __atomic_load_n(&isr_enqueue_position, __ATOMIC_RELAXED);
+    while (slot == NULL)
+    {
+        msg_isr_slot_t* candidate = &isr_ring[position % MESSAGEBROKER_ISR_QUEUE_DEPTH];
+        u32 sequence = __atomic_load_n(&candidate->sequence, __ATOMIC_ACQUIRE);
+        s32 difference = (s32)(sequence - position);
+
+        if (difference == 0)
+        {
+            // On failure position is reloaded with the current value and the loop retries
+            if (__atomic_compare_exchange_n(&isr_enqueue_position, &position, position + 1U, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                slot = candidate;
+            }
+        }
+        else if (difference < 0)
+        {
+            // Ring full, the dispatcher task is not keeping up
+            __atomic_fetch_add(&isr_dropped_count, 1U, __ATOMIC_RELAXED);
+            return false;
+        }
+        else
+        {
+            position = __atomic_load_n(&isr_enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->msg_id = message->msg_id;
+    slot->data_size = message->data_size;
+    if (message->data_size > 0)
+    {
+        memcpy(slot->data_bytes, message->data_bytes, message->data_size);
+    }
+
+    // Hand the slot over to the dispatcher task
+    __atomic_store_n(&slot->sequence, position + 1U, __ATOMIC_RELEASE);
+    msg_queue_t* wake_queue = __atomic_load_n(&isr_wake_queue, __ATOMIC_ACQUIRE);
+    mb_port_signal_give_from_isr((wake_queue != NULL) ? &wake_queue->signal : &isr_signal);
+
+    return true;
+}
+
+u16 messagebroker_isr_queue_process(u32 timeout_ms)
+{
+    ASSERT(is_initialized);
+
+    u16 nof_dispatched = 0;
+
+    // With a wake queue the caller already waited on that queue
+    if ((__atomic_load_n(&isr_wake_queue, __ATOMIC_ACQUIRE) == NULL) && !mb_port_signal_take(&isr_signal, timeout_ms))
+    {
+        return nof_dispatched;
+    }
+
+    while (true)
+    {
+        msg_isr_slot_t* slot = &isr_ring[isr_dequeue_position % MESSAGEBROKER_ISR_QUEUE_DEPTH];
+        u32 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != isr_dequeue_position + 1U)
+        {
+            break; // Empty, or the producer of the next slot has not finished writing yet
+        }
+
+        // Copy the message out and release the slot before the fan-out
+        u8 data_bytes[MESSAGEBROKER_ISR_PAYLOAD_SIZE];
+        msg_t message;
+        message.msg_id = slot->msg_id;
+        message.data_size = slot->data_size;
+        message.data_bytes = (slot->data_size > 0) ? data_bytes : NULL;
+        memcpy(data_bytes, slot->data_bytes, slot->data_size);
+
+        __atomic_store_n(&slot->sequence, isr_dequeue_position + MESSAGEBROKER_ISR_QUEUE_DEPTH, __ATOMIC_RELEASE);
+        isr_dequeue_position++;
+
+        messagebroker_publish(&message);
+        nof_dispatched++;
+    }
+
+    return nof_dispatched;
+}
+
+void messagebroker_isr_queue_set_wake_queue(msg_queue_t* queue)
+{
+    ASSERT(is_initialized);
+    __atomic_store_n(&isr_wake_queue, queue, __ATOMIC_RELEASE);
+}
+
+u32 messagebroker_isr_queue_get_dropped_count(void) { return __atomic_load_n(&isr_dropped_count, __ATOMIC_RELAXED); }
+
+msg_queue_t* messagebroker_queue_create(void)
+{
+    mb_port_lock();
+    ASSERT(nof_allocated_queues < MESSAGEBROKER_MAX_QUEUES); // Increase MESSAGEBROKER_MAX_QUEUES
+    msg_queue_t* queue = &queue_pool[nof_allocated_queues++];
+    queue->owner = mb_port_get_context(); // Under the lock, messagebroker_queue_find() reads it
+    mb_port_unlock();
+
+    for (u8 i = 0; i < E_MSG_PRIORITY_COUNT; i++)
+    {
+        queue->lanes[i].head = 0;
+        queue->lanes[i].count = 0;
+    }
+    queue->dropped_count = 0;
+    queue->coalesced_count = 0;
+    queue->wakeup_count = 0;
+    queue->timeout_count = 0;
+    mb_port_signal_init(&queue->signal);
+
+    return queue;
+}
+
+msg_queue_t* messagebroker_queue_find(const void* owner)
+{
+    msg_queue_t* queue = NULL;
+
+    mb_port_lock();
+    for (u16 i = 0; (i < nof_allocated_queues) && (queue == NULL); i++)
+    {
+        if (queue_pool[i].owner == owner)
+        {
+            queue = &queue_pool[i];
+        }
     }
+    mb_port_unlock();
+
+    return queue;
+}
 
-    msg_id_e topic = message->msg_id;
-    bool is_anyone_listening = false;
+msg_queue_t* messagebroker_queue_get_context_queue(void)
+{
+    // Only the calling task creates queues it owns, nobody can create this one in the meantime
+    msg_queue_t* queue = messagebroker_queue_find(mb_port_get_context());
+    return (queue != NULL) ? queue : messagebroker_queue_create();
+}
 
-    for (u8 i = 0; i < MESSAGE_BROKER_CALLBACK_ARRAY_SIZE; i++)
+u16 messagebroker_queue_process(msg_queue_t* queue, u32 timeout_ms)
+{
+    ASSERT(queue != NULL);
+
+    u16 nof_dispatched = 0;
+
+    // Only the owning task writes the counters, readers may see them one wake-up late
+    bool is_signalled = mb_port_signal_take(&queue->signal, timeout_ms);
+    queue->wakeup_count++;
+    if (!is_signalled)
     {
-        msg_callback_t callback = topic_library[topic]->callback_array[i];
-        if (callback != NULL)
+        queue->timeout_count++;
+        return nof_dispatched;
+    }
+
+    while (true)
+    {
+        // Take the entry out, so that publishers can reuse the slot while the callback runs
+        msg_queue_entry_t entry;
+        u8 priority;
+
+        // The lanes are checked again for every entry, a high priority message never waits for a drain
+        mb_port_lock();
+        msg_queue_lane_t* lane = prv_get_next_lane(queue, &priority);
+        if (lane != NULL)
+        {
+            entry = lane->entries[lane->head];
+            lane->head = (lane->head + 1) % MESSAGEBROKER_QUEUE_DEPTH;
+            lane->count--;
+        }
+        mb_port_unlock();
+
+        if (lane == NULL)
+        {
+            break;
+        }
+
+        msg_t message;
+        message.msg_id = entry.msg_id;
+        message.data_size = entry.data_size;
+        message.data_bytes = entry.data_bytes;
+
+        // Entries of a subscription that was removed while they were queued are dropped
+        u32 epoch = prv_read_lock();
+#if MESSAGEBROKER_STATIC_ROUTES
+        bool is_subscribed = true;
+#else
+        bool is_subscribed = prv_is_subscribed(entry.subscriber_index, entry.msg_id);
+#endif
+        if (is_subscribed)
         {
-            is_anyone_listening = true;
-            callback(message);
+#if MESSAGEBROKER_INSTRUMENTATION
+            prv_record_lane_wait(priority, mb_port_get_cycles() - entry.enqueue_cycles);
+#else
+            (void)priority;
+#endif
+            prv_invoke(entry.subscriber_index, &message);
+            nof_dispatched++;
         }
+        prv_read_unlock(epoch);
+
+        if (entry.data_bytes != NULL)
+        {
+            messagepool_release(entry.data_bytes);
+        }
+    }
+
+    return nof_dispatched;
+}
+
+void messagebroker_queue_notify(msg_queue_t* queue)
+{
+    ASSERT(queue != NULL);
+
+    // Also safe in task context, the port checks where it runs
+    mb_port_signal_give_from_isr(&queue->signal);
+}
+
+msg_priority_e messagebroker_get_topic_priority(msg_id_e topic)
+{
+    ASSERT(topic > E_TOPIC_FIRST_TOPIC);
+    ASSERT(topic < E_TOPIC_LAST_TOPIC);
+    return (msg_priority_e)topic_priorities[topic];
+}
+
+u32 messagebroker_queue_get_dropped_count(const msg_queue_t* queue)
+{
+    ASSERT(queue != NULL);
+    return queue->dropped_count;
+}
+
+u32 messagebroker_queue_get_coalesced_count(const msg_queue_t* queue)
+{
+    ASSERT(queue != NULL);
+    return queue->coalesced_count;
+}
+
+u16 messagebroker_get_nof_queues(void)
+{
+    mb_port_lock();
+    u16 nof_queues = nof_allocated_queues;
+    mb_port_unlock();
+    return nof_queues;
+}
+
+void messagebroker_get_queue_stats(u16 queue_index, msg_queue_stats_t* stats)
+{
+    ASSERT(queue_index < messagebroker_get_nof_queues());
+    ASSERT(stats != NULL);
+
+    const msg_queue_t* queue = &queue_pool[queue_index];
+    stats->owner = queue->owner;
+    stats->nof_wakeups = queue->wakeup_count;
+    stats->nof_timeouts = queue->timeout_count;
+    stats->nof_dropped = queue->dropped_count;
+    stats->nof_coalesced = queue->coalesced_count;
+}
+
+void messagebroker_get_memory_footprint(msg_memory_footprint_t* footprint)
+{
+    ASSERT(footprint != NULL);
+    memset(footprint, 0, sizeof(*footprint));
+
+#if !MESSAGEBROKER_STATIC_ROUTES
+    // With static routes both tables are const and live in flash
+    footprint->routing_bytes =
+        (u32)(sizeof(subscribers) + sizeof(topic_subscriber_masks) + sizeof(reader_epoch) + sizeof(nof_readers) +
+              sizeof(is_synchronizing));
+#endif
+    footprint->retained_bytes = (u32)sizeof(retained_slots);
+    footprint->queue_pool_bytes = (u32)sizeof(queue_pool);
+    footprint->isr_ring_bytes = (u32)(sizeof(isr_ring) + sizeof(isr_signal));
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+    footprint->dispatch_bytes = (u32)(sizeof(dispatch_owners) + sizeof(dispatch_fifos) + sizeof(dispatch_generations));
+    footprint->deferred_fifo_stack_bytes = (u32)sizeof(msg_deferred_fifo_t);
+#endif
+#if MESSAGEBROKER_INSTRUMENTATION
+    footprint->instrumentation_bytes = (u32)(sizeof(topic_stats) + sizeof(subscriber_stats) + sizeof(lane_stats));
+#endif
+#if MESSAGEBROKER_TRACE
+    footprint->trace_bytes = (u32)(MESSAGEBROKER_TRACE_DEPTH * sizeof(msg_trace_record_t));
+#endif
+
+    msg_rpc_stats_t rpc_stats;
+    messagerpc_get_stats(&rpc_stats);
+    footprint->rpc_bytes = rpc_stats.footprint_bytes;
+
+    messagepool_stats_t pool_stats;
+    messagepool_get_stats(&pool_stats);
+    footprint->payload_pool_bytes = pool_stats.footprint_bytes;
+
+    footprint->total_bytes = footprint->routing_bytes + footprint->retained_bytes + footprint->queue_pool_bytes +
+                             footprint->isr_ring_bytes + footprint->dispatch_bytes +
+                             footprint->instrumentation_bytes + footprint->trace_bytes + footprint->rpc_bytes +
+                             footprint->payload_pool_bytes;
+}
+
+#if MESSAGEBROKER_INSTRUMENTATION
+void messagebroker_get_topic_stats(msg_id_e topic, msg_topic_stats_t* stats)
+{
+    ASSERT(topic > E_TOPIC_FIRST_TOPIC);
+    ASSERT(topic < E_TOPIC_LAST_TOPIC);
+    ASSERT(stats != NULL);
+
+    stats->nof_publishes = __atomic_load_n(&topic_stats[topic].nof_publishes, __ATOMIC_RELAXED);
+    stats->nof_unheard_publishes = __atomic_load_n(&topic_stats[topic].nof_unheard_publishes, __ATOMIC_RELAXED);
+    stats->nof_coalesced = __atomic_load_n(&topic_stats[topic].nof_coalesced, __ATOMIC_RELAXED);
+}
+
+u8 messagebroker_get_nof_subscribers(void)
+{
+#if MESSAGEBROKER_STATIC_ROUTES
+    return E_SUBSCRIBER_COUNT;
+#else
+    return __atomic_load_n(&nof_subscribers, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void messagebroker_get_subscriber_stats(u8 subscriber_index, msg_subscriber_stats_t* stats)
+{
+    ASSERT(subscriber_index < messagebroker_get_nof_subscribers());
+    ASSERT(stats != NULL);
+
+    const msg_subscriber_stats_t* source = &subscriber_stats[subscriber_index];
+    stats->callback = subscribers[subscriber_index].callback;
+    stats->nof_calls = __atomic_load_n(&source->nof_calls, __ATOMIC_RELAXED);
+    stats->max_cycles = __atomic_load_n(&source->max_cycles, __ATOMIC_RELAXED);
+    for (u8 i = 0; i < MESSAGEBROKER_STATS_NOF_BUCKETS; i++)
+    {
+        stats->histogram[i] = __atomic_load_n(&source->histogram[i], __ATOMIC_RELAXED);
     }
+}
+
+void messagebroker_get_lane_stats(msg_priority_e priority, msg_lane_stats_t* stats)
+{
+    ASSERT(priority < E_MSG_PRIORITY_COUNT);
+    ASSERT(stats != NULL);
+
+    const msg_lane_stats_t* source = &lane_stats[priority];
+    stats->nof_deliveries = __atomic_load_n(&source->nof_deliveries, __ATOMIC_RELAXED);
+    stats->nof_dropped = __atomic_load_n(&source->nof_dropped, __ATOMIC_RELAXED);
+    stats->max_wait_cycles = __atomic_load_n(&source->max_wait_cycles, __ATOMIC_RELAXED);
+    for (u8 i = 0; i < MESSAGEBROKER_STATS_NOF_BUCKETS; i++)
+    {
+        stats->histogram[i] = __atomic_load_n(&source->histogram[i], __ATOMIC_RELAXED);
+    }
+}
+
+void messagebroker_reset_stats(void)
+{
+    memset(topic_stats, 0, sizeof(topic_stats));
+    memset(subscriber_stats, 0, sizeof(subscriber_stats));
+    memset(lane_stats, 0, sizeof(lane_stats));
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Private Function Implementations
+// ---------------------------------------------------------------------------
+#if !MESSAGEBROKER_STATIC_ROUTES
+static void prv_subscribe(msg_id_e topic, msg_callback_t in_function_ptr, msg_queue_t* queue)
+{
+    { // Input Checks
+        ASSERT(topic > E_TOPIC_FIRST_TOPIC);
+        ASSERT(topic < E_TOPIC_LAST_TOPIC);
+        ASSERT(in_function_ptr != NULL);
+        ASSERT(is_initialized);
+    }
+
+    // Subscribing and taking the retained snapshot under the same lock as prv_store_retained()
+    // means the subscriber gets either the replay or the live message of every publish
+    msg_retained_slot_t retained = {0};
+    u8 retained_slot = topic_retained_slots[topic];
+
+    mb_port_lock();
+    u8 subscriber_index = prv_get_subscriber_index(in_function_ptr, queue);
+    msg_subscriber_mask_t subscriber_bit = (msg_subscriber_mask_t)1U << subscriber_index;
+    msg_subscriber_mask_t subscriber_mask = topic_subscriber_masks[topic];
+
+    bool is_already_subscribed = ((subscriber_mask & subscriber_bit) != 0);
+    ASSERT(false == is_already_subscribed);
+
+    // Release: a publisher that sees the bit also sees the subscriber entry
+    __atomic_store_n(&topic_subscriber_masks[topic], subscriber_mask | subscriber_bit, __ATOMIC_RELEASE);
+    if ((retained_slot != RETAINED_SLOT_NONE) && retained_slots[retained_slot].is_valid &&
+        (retained_slots[retained_slot].msg_id == topic))
+    {
+        retained = retained_slots[retained_slot];
+        if (retained.data_bytes != NULL)
+        {
+            messagepool_retain(retained.data_bytes);
+        }
+    }
+    mb_port_unlock();
+
+    if (retained.is_valid)
+    {
+        prv_replay_retained(topic, subscriber_index, &retained);
+    }
+}
+
+static void prv_replay_retained(msg_id_e topic, u8 subscriber_index, const msg_retained_slot_t* retained)
+{
+    msg_t message;
+    message.msg_id = topic;
+    message.data_size = retained->data_size;
+    message.data_bytes = retained->data_bytes;
+
+    if (subscribers[subscriber_index].queue == NULL)
+    {
+        prv_invoke(subscriber_index, &message);
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+        msg_queue_mask_t wake_mask = 0;
+        prv_add_wake_queue(subscriber_index, &wake_mask);
+        prv_wake_queues(wake_mask);
+#endif
+    }
+    else
+    {
+        u8* pooled_payload = retained->data_bytes;
+        msg_queue_mask_t wake_mask = 0;
+        prv_enqueue(subscribers[subscriber_index].queue, subscriber_index, &message, &pooled_payload, &wake_mask);
+        prv_wake_queues(wake_mask);
+    }
+
+    if (retained->data_bytes != NULL)
+    {
+        messagepool_release(retained->data_bytes);
+    }
+}
+
+static u8 prv_get_subscriber_index(msg_callback_t callback, msg_queue_t* queue)
+{
+    for (u8 i = 0; i < nof_subscribers; i++)
+    {
+        if (subscribers[i].callback == callback)
+        {
+            // A callback is delivered either directly or through exactly one queue
+            ASSERT(subscribers[i].queue == queue);
+            return i;
+        }
+    }
+
+    // Entries are never reused, an unsubscribed callback keeps its index for a later subscribe
+    ASSERT(nof_subscribers < MESSAGEBROKER_MAX_SUBSCRIBERS); // Increase MESSAGEBROKER_MAX_SUBSCRIBERS
+    subscribers[nof_subscribers].callback = callback;
+    subscribers[nof_subscribers].queue = queue;
+    __atomic_store_n(&nof_subscribers, (u8)(nof_subscribers + 1U), __ATOMIC_RELEASE);
+
+    return nof_subscribers - 1U;
+}
+
+static bool prv_is_subscribed(u8 subscriber_index, msg_id_e topic)
+{
+    msg_subscriber_mask_t subscriber_mask = __atomic_load_n(&topic_subscriber_masks[topic], __ATOMIC_ACQUIRE);
+    return (subscriber_mask & ((msg_subscriber_mask_t)1U << subscriber_index)) != 0;
+}
+#endif
+
+static void prv_publish(const msg_t* const messages, u16 nof_messages)
+{
+    ASSERT(is_initialized);
+
+    for (u16 i = 0; i < nof_messages; i++)
+    { // Input Checks
+        ASSERT(messages[i].msg_id > E_TOPIC_FIRST_TOPIC);
+        ASSERT(messages[i].msg_id < E_TOPIC_LAST_TOPIC);
+
+#if MESSAGEBROKER_TRACE
+        // Recorded in publish order, a deferred message shows up before the fan-out it waits for
+        messagetrace_record(&messages[i]);
+#endif
+    }
+
+    // The queues are signalled once, after all messages of the publish are queued
+    msg_queue_mask_t wake_mask = 0;
+
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+    void* context = mb_port_get_context();
+
+    // A publish from inside a callback is queued behind the running fan-out instead of nesting
+    msg_deferred_fifo_t* nested_fifo = prv_get_dispatch_fifo(context);
+    if (nested_fifo != NULL)
+    {
+        for (u16 i = 0; i < nof_messages; i++)
+        {
+            prv_defer(nested_fifo, &messages[i]);
+        }
+        return;
+    }
+
+    // Outermost publish of this task - register the FIFO for nested publishes
+    msg_deferred_fifo_t fifo;
+    fifo.head = 0;
+    fifo.count = 0;
+    u8 slot = 0;
+    while (true)
+    {
+        ASSERT(slot < MESSAGEBROKER_MAX_DISPATCH_CONTEXTS); // Increase MESSAGEBROKER_MAX_DISPATCH_CONTEXTS
+
+        void* expected_owner = NULL;
+        // Sequentially consistent: the dispatch is either seen by synchronize() or sees its mask changes
+        if (__atomic_compare_exchange_n(&dispatch_owners[slot], &expected_owner, context, false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_RELAXED))
+        {
+            break;
+        }
+        slot++;
+    }
+    dispatch_fifos[slot] = &fifo;
+
+    for (u16 i = 0; i < nof_messages; i++)
+    {
+        prv_fan_out(&messages[i], &wake_mask);
+    }
+
+    // Deliver the deferred messages in publish order, they may defer further messages
+    while (fifo.count > 0)
+    {
+        msg_deferred_entry_t entry = fifo.entries[fifo.head];
+        fifo.head = (fifo.head + 1U) % MESSAGEBROKER_DEFERRED_DEPTH;
+        fifo.count--;
+
+        msg_t deferred;
+        deferred.msg_id = entry.msg_id;
+        deferred.data_size = entry.data_size;
+        deferred.data_bytes = entry.data_bytes;
+        prv_fan_out(&deferred, &wake_mask);
+
+        if (entry.data_bytes != NULL)
+        {
+            messagepool_release(entry.data_bytes);
+        }
+    }
+
+    dispatch_fifos[slot] = NULL;
+    __atomic_store_n(&dispatch_generations[slot], dispatch_generations[slot] + 1U, __ATOMIC_RELAXED);
+    __atomic_store_n(&dispatch_owners[slot], NULL, __ATOMIC_RELEASE);
+#else
+    u32 epoch = prv_read_lock();
+    for (u16 i = 0; i < nof_messages; i++)
+    {
+        prv_fan_out(&messages[i], &wake_mask);
+    }
+    prv_read_unlock(epoch);
+#endif
+
+    prv_wake_queues(wake_mask);
+}
+
+static void prv_enqueue(msg_queue_t* queue, u8 subscriber_index, const msg_t* const message, u8** pooled_payload,
+                        msg_queue_mask_t* wake_mask)
+{
+    ASSERT((message->data_size == 0) || (message->data_bytes != NULL));
+
+    u8 coalescing = topic_coalescing[message->msg_id];
+    u8 priority = topic_priorities[message->msg_id];
+    msg_queue_lane_t* lane = &queue->lanes[priority];
+
+    // A duplicate is dropped before it costs a pool block
+    if (coalescing == COALESCE_DUPLICATES)
+    {
+        mb_port_lock();
+        const msg_queue_entry_t* pending = prv_find_pending(lane, subscriber_index, message->msg_id);
+        bool is_duplicate = (pending != NULL) && (pending->data_size == message->data_size) &&
+                            ((message->data_size == 0) ||
+                             (memcmp(pending->data_bytes, message->data_bytes, message->data_size) == 0));
+        if (is_duplicate)
+        {
+            queue->coalesced_count++;
+        }
+        mb_port_unlock();
+
+        if (is_duplicate)
+        {
+#if MESSAGEBROKER_INSTRUMENTATION
+            __atomic_fetch_add(&topic_stats[message->msg_id].nof_coalesced, 1U, __ATOMIC_RELAXED);
+#endif
+            return;
+        }
+    }
+
+    // Take the reference of this entry before entering the critical section
+    u8* payload = NULL;
+    if (message->data_size > 0)
+    {
+        payload = prv_acquire_pooled_payload(message, pooled_payload);
+        if (payload == NULL)
+        {
+            mb_port_lock();
+            queue->dropped_count++; // Pool exhausted
+            mb_port_unlock();
+#if MESSAGEBROKER_INSTRUMENTATION
+            prv_record_lane_drop(priority);
+#endif
+            return;
+        }
+    }
+
+    u8* released_payload = NULL;
+    bool is_coalesced = false;
+    bool is_full = false;
+
+    mb_port_lock();
+    msg_queue_entry_t* pending =
+        (coalescing == COALESCE_LATEST) ? prv_find_pending(lane, subscriber_index, message->msg_id) : NULL;
+    if (pending != NULL)
+    {
+        // The pending entry is already signalled, it only takes the newer payload
+        released_payload = pending->data_bytes;
+        pending->data_size = message->data_size;
+        pending->data_bytes = payload;
+        queue->coalesced_count++;
+        is_coalesced = true;
+    }
+    else if (lane->count >= MESSAGEBROKER_QUEUE_DEPTH)
+    {
+        // Never block the publisher - the subscriber is not keeping up with this class
+        queue->dropped_count++;
+        released_payload = payload;
+        is_full = true;
+    }
+    else
+    {
+        msg_queue_entry_t* entry = &lane->entries[(lane->head + lane->count) % MESSAGEBROKER_QUEUE_DEPTH];
+        entry->subscriber_index = subscriber_index;
+        entry->msg_id = message->msg_id;
+        entry->data_size = message->data_size;
+        entry->data_bytes = payload;
+#if MESSAGEBROKER_INSTRUMENTATION
+        entry->enqueue_cycles = mb_port_get_cycles();
+#endif
+        lane->count++;
+    }
+    mb_port_unlock();
+
+    if (released_payload != NULL)
+    {
+        messagepool_release(released_payload);
+    }
+
+    if (is_coalesced)
+    {
+#if MESSAGEBROKER_INSTRUMENTATION
+        __atomic_fetch_add(&topic_stats[message->msg_id].nof_coalesced, 1U, __ATOMIC_RELAXED);
+#endif
+    }
+    else if (is_full)
+    {
+#if MESSAGEBROKER_INSTRUMENTATION
+        prv_record_lane_drop(priority);
+#endif
+    }
+    else
+    {
+        *wake_mask |= (msg_queue_mask_t)1U << (u32)(queue - queue_pool);
+    }
+}
+
+// Undelivered entry of the subscriber for the topic, call with the broker lock held.
+// A topic always maps to the same lane, so only that lane is searched.
+static msg_queue_entry_t* prv_find_pending(msg_queue_lane_t* lane, u8 subscriber_index, msg_id_e msg_id)
+{
+    for (u16 i = 0; i < lane->count; i++)
+    {
+        msg_queue_entry_t* entry = &lane->entries[(lane->head + i) % MESSAGEBROKER_QUEUE_DEPTH];
+        if ((entry->subscriber_index == subscriber_index) && (entry->msg_id == msg_id))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Highest priority lane with a pending entry or NULL, call with the broker lock held
+static msg_queue_lane_t* prv_get_next_lane(msg_queue_t* queue, u8* priority)
+{
+    for (u8 i = 0; i < E_MSG_PRIORITY_COUNT; i++)
+    {
+        msg_queue_lane_t* lane = &queue->lanes[lane_service_order[i]];
+        if (lane->count > 0)
+        {
+            *priority = lane_service_order[i];
+            return lane;
+        }
+    }
+    return NULL;
+}
+
+static void prv_wake_queues(msg_queue_mask_t wake_mask)
+{
+    while (wake_mask != 0)
+    {
+        u8 index = (u8)__builtin_ctz(wake_mask);
+        wake_mask &= (wake_mask - 1); // Clear the lowest set bit
+
+        mb_port_signal_give(&queue_pool[index].signal);
+    }
+}
+
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+static void prv_set_wake_queue(u8 subscriber_index, msg_queue_t* queue)
+{
+    ASSERT(subscriber_index < MESSAGEBROKER_MAX_SUBSCRIBERS);
+
+    // All queued subscriptions of a callback come from the task that owns the queue
+    msg_queue_t* previous = __atomic_exchange_n(&subscriber_wake_queues[subscriber_index], queue, __ATOMIC_RELEASE);
+    ASSERT((previous == NULL) || (previous == queue));
+}
+
+static void prv_add_wake_queue(u8 subscriber_index, msg_queue_mask_t* wake_mask)
+{
+    msg_queue_t* queue = __atomic_load_n(&subscriber_wake_queues[subscriber_index], __ATOMIC_ACQUIRE);
+    if (queue != NULL)
+    {
+        *wake_mask |= (msg_queue_mask_t)1U << (u32)(queue - queue_pool);
+    }
+}
+#endif
+
+static void prv_fan_out(const msg_t* const message, msg_queue_mask_t* wake_mask)
+{
+    // All queued deliveries of this publish share one pooled copy of the payload
+    u8* pooled_payload = NULL;
+
+    // Only visit the subscribers of this topic - the cost scales with the actual fan-out
+    msg_subscriber_mask_t pending = 0;
+    if (topic_retained_slots[message->msg_id] != RETAINED_SLOT_NONE)
+    {
+        pending = prv_store_retained(message, &pooled_payload);
+    }
+    else
+    {
+        pending = __atomic_load_n(&topic_subscriber_masks[message->msg_id], __ATOMIC_ACQUIRE);
+    }
+    bool is_anyone_listening = (pending != 0);
+
+    while (pending != 0)
+    {
+        u8 index = (u8)__builtin_ctz(pending);
+        pending &= (pending - 1); // Clear the lowest set bit
+
+        if (subscribers[index].queue == NULL)
+        {
+            prv_invoke(index, message);
+#if !MESSAGEBROKER_ASYNC_DISPATCH
+            prv_add_wake_queue(index, wake_mask);
+#endif
+        }
+        else
+        {
+            prv_enqueue(subscribers[index].queue, index, message, &pooled_payload, wake_mask);
+        }
+    }
+
+    if ((pooled_payload != NULL) && (pooled_payload != message->data_bytes))
+    {
+        messagepool_release(pooled_payload); // Reference of the copy, the queue entries hold their own
+    }
+
+#if MESSAGEBROKER_INSTRUMENTATION
+    __atomic_fetch_add(&topic_stats[message->msg_id].nof_publishes, 1U, __ATOMIC_RELAXED);
+    if (!is_anyone_listening)
+    {
+        __atomic_fetch_add(&topic_stats[message->msg_id].nof_unheard_publishes, 1U, __ATOMIC_RELAXED);
+    }
+#endif
+    (void)is_anyone_listening;
     // ASSERT(is_anyone_listening == true);
 }
+
+#if MESSAGEBROKER_DEFER_NESTED_PUBLISH
+static msg_deferred_fifo_t* prv_get_dispatch_fifo(void* context)
+{
+    for (u8 i = 0; i < MESSAGEBROKER_MAX_DISPATCH_CONTEXTS; i++)
+    {
+        if (__atomic_load_n(&dispatch_owners[i], __ATOMIC_RELAXED) == context)
+        {
+            return dispatch_fifos[i];
+        }
+    }
+    return NULL;
+}
+
+static void prv_defer(msg_deferred_fifo_t* fifo, const msg_t* const message)
+{
+    ASSERT(fifo->count < MESSAGEBROKER_DEFERRED_DEPTH); // Increase MESSAGEBROKER_DEFERRED_DEPTH
+
+    // The publishing callback's payload is gone once it returns, keep a pooled reference
+    u8* payload = NULL;
+    if (message->data_size > 0)
+    {
+        u8* pooled_payload = NULL;
+        payload = prv_acquire_pooled_payload(message, &pooled_payload);
+        if (payload == NULL)
+        {
+            __atomic_fetch_add(&deferred_dropped_count, 1U, __ATOMIC_RELAXED); // Pool exhausted
+            return;
+        }
+        if (payload != message->data_bytes)
+        {
+            messagepool_release(payload); // Drop the reference of the copy, the entry keeps its own
+        }
+    }
+
+    msg_deferred_entry_t* entry = &fifo->entries[(fifo->head + fifo->count) % MESSAGEBROKER_DEFERRED_DEPTH];
+    entry->msg_id = message->msg_id;
+    entry->data_size = message->data_size;
+    entry->data_bytes = payload;
+    fifo->count++;
+}
+#endif
+
+static u8* prv_acquire_pooled_payload(const msg_t* const message, u8** pooled_payload)
+{
+    ASSERT(message->data_size > 0);
+    ASSERT(message->data_bytes != NULL);
+
+    if (*pooled_payload == NULL)
+    {
+        if (messagepool_owns(message->data_bytes))
+        {
+            // Zero-copy hand-off, the publisher's reference keeps the block alive during the fan-out
+            *pooled_payload = message->data_bytes;
+        }
+        else
+        {
+            // Borrowed payload, copied once and released by messagebroker_publish() after the fan-out
+            u8* block = (u8*)messagepool_alloc(message->data_size);
+            if (block == NULL)
+            {
+                return NULL;
+            }
+            memcpy(block, message->data_bytes, message->data_size);
+            *pooled_payload = block;
+        }
+    }
+
+    messagepool_retain(*pooled_payload);
+    return *pooled_payload;
+}
+
+static msg_subscriber_mask_t prv_store_retained(const msg_t* const message, u8** pooled_payload)
+{
+    // The retained payload is acquired outside of the critical section
+    u8* payload = NULL;
+    if (message->data_size > 0)
+    {
+        payload = prv_acquire_pooled_payload(message, pooled_payload);
+    }
+    bool is_stored = (message->data_size == 0) || (payload != NULL);
+
+    msg_retained_slot_t* retained = &retained_slots[topic_retained_slots[message->msg_id]];
+
+    mb_port_lock();
+    u8* previous_payload = retained->data_bytes;
+    retained->is_valid = is_stored; // Pool exhausted - better no replay than an outdated one
+    retained->msg_id = message->msg_id;
+    retained->data_size = message->data_size;
+    retained->data_bytes = payload;
+    msg_subscriber_mask_t subscriber_mask = topic_subscriber_masks[message->msg_id];
+    mb_port_unlock();
+
+    if (previous_payload != NULL)
+    {
+        messagepool_release(previous_payload);
+    }
+
+    return subscriber_mask;
+}
+
+static void prv_invoke(u8 subscriber_index, const msg_t* const message)
+{
+#if MESSAGEBROKER_INSTRUMENTATION
+    u32 start_cycles = mb_port_get_cycles();
+    subscribers[subscriber_index].callback(message);
+    prv_record_callback_duration(subscriber_index, mb_port_get_cycles() - start_cycles);
+#else
+    subscribers[subscriber_index].callback(message);
+#endif
+}
+
+// Marks a delivery in progress for messagebroker_synchronize(), returns the epoch it counts in
+static u32 prv_read_lock(void)
+{
+#if MESSAGEBROKER_STATIC_ROUTES
+    return 0;
+#else
+    u32 epoch = __atomic_load_n(&reader_epoch, __ATOMIC_RELAXED) & 1U;
+    // Sequentially consistent: either synchronize() sees this reader or the reader sees the cleared bit
+    __atomic_fetch_add(&nof_readers[epoch], 1U, __ATOMIC_SEQ_CST);
+    return epoch;
+#endif
+}
+
+static void prv_read_unlock(u32 epoch)
+{
+#if MESSAGEBROKER_STATIC_ROUTES
+    (void)epoch;
+#else
+    __atomic_fetch_sub(&nof_readers[epoch], 1U, __ATOMIC_RELEASE);
+#endif
+}
+
+#if MESSAGEBROKER_INSTRUMENTATION
+static void prv_record_callback_duration(u8 subscriber_index, u32 cycles)
+{
+    msg_subscriber_stats_t* stats = &subscriber_stats[subscriber_index];
+
+    __atomic_fetch_add(&stats->nof_calls, 1U, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->histogram[prv_get_histogram_bucket(cycles)], 1U, __ATOMIC_RELAXED);
+    prv_update_max(&stats->max_cycles, cycles);
+}
+
+static void prv_record_lane_drop(u8 priority)
+{
+    __atomic_fetch_add(&lane_stats[priority].nof_dropped, 1U, __ATOMIC_RELAXED);
+}
+
+static void prv_record_lane_wait(u8 priority, u32 cycles)
+{
+    msg_lane_stats_t* stats = &lane_stats[priority];
+
+    __atomic_fetch_add(&stats->nof_deliveries, 1U, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->histogram[prv_get_histogram_bucket(cycles)], 1U, __ATOMIC_RELAXED);
+    prv_update_max(&stats->max_wait_cycles, cycles);
+}
+
+static u8 prv_get_histogram_bucket(u32 cycles)
+{
+    // Bucket 0 holds everything below 2^FIRST_BUCKET_LOG2 cycles, each further bucket doubles the range
+    u8 bucket = 0;
+    if (cycles >= (1UL << MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2))
+    {
+        u8 log2 = (u8)(31 - __builtin_clz(cycles));
+        bucket = (u8)(log2 - MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2 + 1U);
+        if (bucket >= MESSAGEBROKER_STATS_NOF_BUCKETS)
+        {
+            bucket = MESSAGEBROKER_STATS_NOF_BUCKETS - 1U;
+        }
+    }
+    return bucket;
+}
+
+static void prv_update_max(u32* max_cycles, u32 cycles)
+{
+    u32 current = __atomic_load_n(max_cycles, __ATOMIC_RELAXED);
+    while ((cycles > current) &&
+           !__atomic_compare_exchange_n(max_cycles, &current, cycles, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        // current was reloaded by the failed exchange
+    }
+}
+#endif
@@ -1,7 +1,10 @@
 #ifndef MESSAGEBROKER_H
 #define MESSAGEBROKER_H
 
+#include "MessageBrokerConfig.h"
 #include "MessageIDs.h"
+#include "MessagePool.h"
+#include "MessageRoutes.h"
 #include "custom_types.h"
 
 #ifdef __cplusplus
@@ -9,6 +12,14 @@ extern "C"
 {
 #endif /* __cplusplus */
 
+#define MESSAGEBROKER_WAIT_FOREVER (0xFFFFFFFFU)
+
+    /**
+     * data_bytes is either borrowed or pooled (messagepool_alloc()). A borrowed payload only
+     * has to stay valid during messagebroker_publish(), queued deliveries get a pooled copy.
+     * A pooled payload is handed off without copying. Callbacks may keep a pooled payload
+     * beyond their return with messagepool_retain() - never a borrowed one.
+     */
     typedef struct
     {
         msg_id_e msg_id;
@@ -18,11 +29,298 @@ extern "C"
 
     typedef void (*msg_callback_t)(const msg_t* const message);
 
+#define MESSAGEBROKER_SUBSCRIBER_ID(id, callback) id,
+    typedef enum
+    {
+        MESSAGE_SUBSCRIBERS(MESSAGEBROKER_SUBSCRIBER_ID) E_SUBSCRIBER_COUNT
+    } msg_subscriber_id_e;
+#undef MESSAGEBROKER_SUBSCRIBER_ID
+
+    // Subscriber callbacks of the modules, referenced by the static routes
+#define MESSAGEBROKER_SUBSCRIBER_PROTOTYPE(id, callback) void callback(const msg_t* const message);
+    MESSAGE_SUBSCRIBERS(MESSAGEBROKER_SUBSCRIBER_PROTOTYPE)
+#undef MESSAGEBROKER_SUBSCRIBER_PROTOTYPE
+
+    /**
+     * Bounded delivery queue of one subscriber task. Queued callbacks run in the
+     * context of the task that calls messagebroker_queue_process() on the queue.
+     */
+    typedef struct msg_queue msg_queue_t;
+
+    /**
+     * Priority class of a topic (MessagePriorities.h). Every queue has one lane per class,
+     * messagebroker_queue_process() always dispatches from the highest non-empty lane and
+     * a full lane only drops messages of its own class.
+     */
+    typedef enum
+    {
+        MSG_PRIORITY_NORMAL = 0, // Topics that are not listed in MessagePriorities.h
+        MSG_PRIORITY_HIGH,
+        MSG_PRIORITY_LOW,
+        E_MSG_PRIORITY_COUNT
+    } msg_priority_e;
+
     void messagebroker_init(void);
 
+    /**
+     * @brief Delivers the message to all subscribers of its topic
+     *
+     * A publish from inside a subscriber callback does not nest: it is deferred until the
+     * running fan-out has finished and then delivered in publish order. Stack use stays at
+     * one dispatch level, no matter how long the chain of callback publishes gets.
+     */
+    void messagebroker_publish(const msg_t* const message);
+
+    /**
+     * @brief Delivers the messages in order, like consecutive messagebroker_publish() calls
+     *
+     * Every subscriber queue is signalled once for the whole batch instead of once per
+     * message, and the queued deliveries of a burst are merged as configured in
+     * MessageCoalescing.h. Messages published by callbacks during the batch are delivered
+     * after the last message of the batch.
+     *
+     * @param messages Array of nof_messages messages, the payload rules of messagebroker_publish() apply
+     */
+    void messagebroker_publish_batch(const msg_t* const messages, u16 nof_messages);
+
+    /**
+     * @brief Get the number of deferred publishes dropped because the MessagePool was exhausted
+     */
+    u32 messagebroker_get_deferred_dropped_count(void);
+
+    /**
+     * @brief Publishes from interrupt context (or any other context that must not block)
+     *
+     * The message is copied into a lock-free ring and published by the dispatcher task,
+     * which calls messagebroker_isr_queue_process(). Safe against nested interrupts and
+     * concurrent producers.
+     *
+     * @param message Payload of at most MESSAGEBROKER_ISR_PAYLOAD_SIZE bytes, borrowed
+     * @return false if the ring was full and the message was dropped
+     */
+    bool messagebroker_publish_from_isr(const msg_t* const message);
+
+    /**
+     * @brief Waits up to timeout_ms for messages from interrupt context and publishes all pending ones
+     *
+     * Must only be called by a single task - the dispatcher task.
+     *
+     * @param timeout_ms Maximum wait time or MESSAGEBROKER_WAIT_FOREVER
+     * @return Number of published messages
+     */
+    u16 messagebroker_isr_queue_process(u32 timeout_ms);
+
+    /**
+     * @brief Wakes the queue instead of the dispatcher task when an interrupt publishes
+     *
+     * For a task that waits on its delivery queue and also dispatches the ISR ring, like the
+     * cooperative executor: it calls messagebroker_isr_queue_process() after every return of
+     * messagebroker_queue_process(), which then ignores its timeout and never waits.
+     *
+     * @param queue Queue of the dispatching task, NULL = back to the dispatcher task
+     */
+    void messagebroker_isr_queue_set_wake_queue(msg_queue_t* queue);
+
+    /**
+     * @brief Get the number of messages dropped because the ISR ring was full
+     */
+    u32 messagebroker_isr_queue_get_dropped_count(void);
+
+    /**
+     * @brief Allocates a delivery queue from the broker's static queue pool
+     * @return Queue handle (never NULL)
+     */
+    msg_queue_t* messagebroker_queue_create(void);
+
+    /**
+     * @brief Get the first queue created by the given context
+     * @param owner Context as returned by mb_port_get_context() (the TaskHandle_t on FreeRTOS)
+     * @return Queue handle or NULL if the context has none
+     */
+    msg_queue_t* messagebroker_queue_find(const void* owner);
+
+    /**
+     * @brief Get the delivery queue of the calling task, created on first use
+     *
+     * Modules that run in the same task share its queue, so one wait serves all of them
+     * (see the cooperative executor).
+     */
+    msg_queue_t* messagebroker_queue_get_context_queue(void);
+
+#if MESSAGEBROKER_STATIC_ROUTES
+    // The wiring is fixed at compile time (MessageRoutes.h) - subscriptions compile to nothing
+#define messagebroker_subscribe(topic, callback)   ((void)(topic), (void)(callback))
+#define messagebroker_unsubscribe(topic, callback) ((void)(topic), (void)(callback))
+#define messagebroker_synchronize()                ((void)0)
+
+    /**
+     * @brief Wakes the queue after every delivery to the callback, the route itself comes from MessageRoutes.h
+     */
+    void messagebroker_subscribe_queued(msg_id_e topic, msg_callback_t callback, msg_queue_t* queue);
+#else
+    /**
+     * @brief Subscribes a callback that runs in the context of the publisher
+     *
+     * Subscriptions can change at any time, publishers never wait for them: they deliver
+     * according to the subscriber masks at the start of their fan-out.
+     */
     void messagebroker_subscribe(msg_id_e topic, msg_callback_t callback);
 
-    void messagebroker_publish(const msg_t* const message);
+    /**
+     * @brief Subscribes a callback that is delivered through the given queue
+     *
+     * With MESSAGEBROKER_ASYNC_DISPATCH disabled the callback runs in the publisher like with
+     * messagebroker_subscribe(), and the queue is woken afterwards. Modules can use the queued API
+     * unconditionally, their task runs after every message either way.
+     */
+    void messagebroker_subscribe_queued(msg_id_e topic, msg_callback_t callback, msg_queue_t* queue);
+
+    /**
+     * @brief Removes the subscription of the callback to the topic, without blocking any publisher
+     *
+     * Queued messages of the subscription are dropped. A publish that started before the
+     * call can still deliver the message it is working on, call messagebroker_synchronize()
+     * before the callback or its data go away.
+     */
+    void messagebroker_unsubscribe(msg_id_e topic, msg_callback_t callback);
+
+    /**
+     * @brief Waits until every delivery that started before the call has finished
+     *
+     * Must not be called from a subscriber callback.
+     */
+    void messagebroker_synchronize(void);
+#endif
+
+    /**
+     * @brief Get the priority class of a topic (MessagePriorities.h)
+     */
+    msg_priority_e messagebroker_get_topic_priority(msg_id_e topic);
+
+    /**
+     * @brief Waits up to timeout_ms for queued messages and dispatches all pending ones
+     *
+     * High priority messages are dispatched first, also those that arrive while the queue
+     * is being drained.
+     *
+     * @param queue Queue owned by the calling task
+     * @param timeout_ms Maximum wait time or MESSAGEBROKER_WAIT_FOREVER
+     * @return Number of dispatched messages
+     */
+    u16 messagebroker_queue_process(msg_queue_t* queue, u32 timeout_ms);
+
+    /**
+     * @brief Wakes the task that waits in messagebroker_queue_process() without a message
+     *
+     * For events from outside the broker - received UART data, a WiFi event, a timer - so the
+     * task can block on its queue instead of polling. messagebroker_queue_process() then
+     * returns 0. Safe from interrupt context; notifications are not counted, several of them
+     * before the task runs wake it once.
+     */
+    void messagebroker_queue_notify(msg_queue_t* queue);
+
+    /**
+     * @brief Get the number of messages dropped because the queue was full
+     */
+    u32 messagebroker_queue_get_dropped_count(const msg_queue_t* queue);
+
+    /**
+     * @brief Get the number of deliveries merged into a pending entry of the queue (MessageCoalescing.h)
+     */
+    u32 messagebroker_queue_get_coalesced_count(const msg_queue_t* queue);
+
+    typedef struct
+    {
+        void* owner;      // Context that created the queue (the TaskHandle_t on FreeRTOS)
+        u32 nof_wakeups;  // Returns from the wait in messagebroker_queue_process()
+        u32 nof_timeouts; // ... because the timeout expired, a task that polls has mostly these
+        u32 nof_dropped;
+        u32 nof_coalesced;
+    } msg_queue_stats_t;
+
+    /**
+     * @brief Get the number of queues created with messagebroker_queue_create()
+     */
+    u16 messagebroker_get_nof_queues(void);
+
+    /**
+     * @brief Get the wake-up and drop counters of a queue, for finding tasks that poll
+     * @param queue_index 0 .. messagebroker_get_nof_queues() - 1, in creation order
+     */
+    void messagebroker_get_queue_stats(u16 queue_index, msg_queue_stats_t* stats);
+
+    // Statically allocated RAM of the broker in bytes, as configured in MessageBrokerConfig.h
+    typedef struct
+    {
+        u32 routing_bytes;        // Subscriber table and per-topic subscriber masks
+        u32 retained_bytes;       // Retained topic slots
+        u32 queue_pool_bytes;     // Delivery queues for messagebroker_queue_create()
+        u32 isr_ring_bytes;       // Ring of messagebroker_publish_from_isr()
+        u32 dispatch_bytes;       // Dispatch context table for deferred nested publishes
+        u32 instrumentation_bytes;
+        u32 trace_bytes;          // Trace recorder ring
+        u32 rpc_bytes;            // Pending request/reply calls
+        u32 payload_pool_bytes;   // MessagePool blocks and reference counts
+        u32 total_bytes;
+        u32 deferred_fifo_stack_bytes; // Taken from the stack of every outermost publish, not in total_bytes
+    } msg_memory_footprint_t;
+
+    /**
+     * @brief Get the static RAM footprint of the broker and its payload pool
+     */
+    void messagebroker_get_memory_footprint(msg_memory_footprint_t* footprint);
+
+#if MESSAGEBROKER_INSTRUMENTATION
+    typedef struct
+    {
+        u32 nof_publishes;
+        u32 nof_unheard_publishes; // Published while nobody was subscribed
+        u32 nof_coalesced;         // Queued deliveries merged into a pending one (MessageCoalescing.h)
+    } msg_topic_stats_t;
+
+    typedef struct
+    {
+        msg_callback_t callback;
+        u32 nof_calls;
+        u32 max_cycles;
+        u32 histogram[MESSAGEBROKER_STATS_NOF_BUCKETS]; // See MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2
+    } msg_subscriber_stats_t;
+
+    // Queued deliveries of one priority class, summed over all queues
+    typedef struct
+    {
+        u32 nof_deliveries;
+        u32 nof_dropped;                                // Lane full or MessagePool exhausted
+        u32 max_wait_cycles;                            // From the publish to the start of the callback
+        u32 histogram[MESSAGEBROKER_STATS_NOF_BUCKETS]; // Wait time, see MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2
+    } msg_lane_stats_t;
+
+    /**
+     * @brief Get the publish counters of a topic
+     */
+    void messagebroker_get_topic_stats(msg_id_e topic, msg_topic_stats_t* stats);
+
+    /**
+     * @brief Get the number of distinct subscriber callbacks
+     */
+    u8 messagebroker_get_nof_subscribers(void);
+
+    /**
+     * @brief Get the callback duration statistics of a subscriber, measured in CPU cycles
+     * @param subscriber_index 0 .. messagebroker_get_nof_subscribers() - 1
+     */
+    void messagebroker_get_subscriber_stats(u8 subscriber_index, msg_subscriber_stats_t* stats);
+
+    /**
+     * @brief Get the queueing latency statistics of a priority lane, measured in CPU cycles
+     */
+    void messagebroker_get_lane_stats(msg_priority_e priority, msg_lane_stats_t* stats);
+
+    /**
+     * @brief Clears all topic, subscriber and lane statistics
+     */
+    void messagebroker_reset_stats(void);
+#endif
 
 #ifdef __cplusplus
 }
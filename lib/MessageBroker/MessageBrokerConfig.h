@@ -0,0 +1,108 @@
+#ifndef MESSAGEBROKERCONFIG_H
+#define MESSAGEBROKERCONFIG_H
+
+/**
+ * Build configuration of the MessageBroker. Every option can be overridden with
+ * a -D flag in the build_flags of platformio.ini.
+ */
+
+// Async dispatch: publishers copy the message into the subscriber's queue and return
+#ifndef MESSAGEBROKER_ASYNC_DISPATCH
+#define MESSAGEBROKER_ASYNC_DISPATCH 0
+#endif
+
+// Static routes: topic -> subscriber wiring from MessageRoutes.h instead of runtime subscriptions
+#ifndef MESSAGEBROKER_STATIC_ROUTES
+#define MESSAGEBROKER_STATIC_ROUTES 0
+#endif
+
+#if MESSAGEBROKER_STATIC_ROUTES && MESSAGEBROKER_ASYNC_DISPATCH
+#error "Static routes deliver synchronously, disable MESSAGEBROKER_ASYNC_DISPATCH"
+#endif
+
+#ifndef MESSAGEBROKER_MAX_QUEUES
+#define MESSAGEBROKER_MAX_QUEUES 8U
+#endif
+
+// Entries per priority lane of a queue (MessagePriorities.h), a queue holds E_MSG_PRIORITY_COUNT lanes.
+// The modules of the cooperative executor share one queue (EXECUTOR_COOPERATIVE).
+// Without async dispatch the queues only wake up their task, nothing is ever enqueued
+#ifndef MESSAGEBROKER_QUEUE_DEPTH
+#if MESSAGEBROKER_ASYNC_DISPATCH
+#define MESSAGEBROKER_QUEUE_DEPTH 8U
+#else
+#define MESSAGEBROKER_QUEUE_DEPTH 1U
+#endif
+#endif
+
+// Publishes from inside a callback are deferred until the running fan-out is done (0 = nest them)
+#ifndef MESSAGEBROKER_DEFER_NESTED_PUBLISH
+#define MESSAGEBROKER_DEFER_NESTED_PUBLISH 1
+#endif
+
+// Number of messages a single dispatch can defer
+#ifndef MESSAGEBROKER_DEFERRED_DEPTH
+#define MESSAGEBROKER_DEFERRED_DEPTH 8U
+#endif
+
+// Tasks that can be inside messagebroker_publish() at the same time
+#ifndef MESSAGEBROKER_MAX_DISPATCH_CONTEXTS
+#define MESSAGEBROKER_MAX_DISPATCH_CONTEXTS 12U
+#endif
+
+// Instrumentation: per-topic publish counters, per-subscriber callback duration and per-lane wait histograms
+#ifndef MESSAGEBROKER_INSTRUMENTATION
+#define MESSAGEBROKER_INSTRUMENTATION 0
+#endif
+
+// Histogram bucket i counts callbacks below 2^(MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2 + i) cycles,
+// the last bucket counts everything above
+#ifndef MESSAGEBROKER_STATS_NOF_BUCKETS
+#define MESSAGEBROKER_STATS_NOF_BUCKETS 16U
+#endif
+
+#ifndef MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2
+#define MESSAGEBROKER_STATS_FIRST_BUCKET_LOG2 8U
+#endif
+
+// Messages published from interrupt context, drained by the dispatcher task (power of two)
+#ifndef MESSAGEBROKER_ISR_QUEUE_DEPTH
+#define MESSAGEBROKER_ISR_QUEUE_DEPTH 16U
+#endif
+
+// Payloads from interrupt context are copied into the ring slot, so keep them small
+#ifndef MESSAGEBROKER_ISR_PAYLOAD_SIZE
+#define MESSAGEBROKER_ISR_PAYLOAD_SIZE 8U
+#endif
+
+// Trace recorder: every publish is written into a RAM ring of binary records (see MessageTrace.h)
+#ifndef MESSAGEBROKER_TRACE
+#define MESSAGEBROKER_TRACE 0
+#endif
+
+// Number of records in the trace ring (power of two), older records are overwritten
+#ifndef MESSAGEBROKER_TRACE_DEPTH
+#define MESSAGEBROKER_TRACE_DEPTH 64U
+#endif
+
+// Leading payload bytes stored per record, longer payloads are truncated
+#ifndef MESSAGEBROKER_TRACE_PAYLOAD_SIZE
+#define MESSAGEBROKER_TRACE_PAYLOAD_SIZE 16U
+#endif
+
+// Request/reply calls (messagerpc_call()) that can wait for their reply at the same time
+#ifndef MESSAGEBROKER_RPC_MAX_PENDING
+#define MESSAGEBROKER_RPC_MAX_PENDING 4U
+#endif
+
+// Largest payload that fits a pool block (WiFi credentials "ssid|password" string)
+#ifndef MESSAGEPOOL_BLOCK_SIZE
+#define MESSAGEPOOL_BLOCK_SIZE 100U
+#endif
+
+// Payload blocks shared by all publishers and queued subscribers
+#ifndef MESSAGEPOOL_NOF_BLOCKS
+#define MESSAGEPOOL_NOF_BLOCKS 16U
+#endif
+
+#endif // MESSAGEBROKERCONFIG_H
@@ -0,0 +1,104 @@
+#ifndef MESSAGEBROKERPORT_H
+#define MESSAGEBROKERPORT_H
+
+#include "custom_types.h"
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#define MB_PORT_WAIT_FOREVER (0xFFFFFFFFU)
+
+    /**
+     * Wake-up object of a queue consumer. Giving an already given signal is a no-op,
+     * the consumer drains everything that is pending once it wakes up.
+     */
+#if defined(ESP_PLATFORM)
+    typedef struct
+    {
+        StaticSemaphore_t buffer;
+        SemaphoreHandle_t handle;
+    } mb_port_signal_t;
+#else
+    typedef struct
+    {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        bool is_given;
+    } mb_port_signal_t;
+#endif
+
+    /**
+     * @brief Enters the broker critical section (short, non-blocking sections only)
+     */
+    void mb_port_lock(void);
+
+    /**
+     * @brief Leaves the broker critical section
+     */
+    void mb_port_unlock(void);
+
+    /**
+     * @brief Initializes a signal in the not-given state
+     * @param signal Signal storage owned by the caller
+     */
+    void mb_port_signal_init(mb_port_signal_t* signal);
+
+    /**
+     * @brief Wakes up the consumer waiting on the signal
+     * @param signal Initialized signal
+     */
+    void mb_port_signal_give(mb_port_signal_t* signal);
+
+    /**
+     * @brief Waits until the signal is given or the timeout expires
+     * @param signal Initialized signal
+     * @param timeout_ms Timeout in milliseconds or MB_PORT_WAIT_FOREVER
+     * @return true if the signal was given, false on timeout
+     */
+    bool mb_port_signal_take(mb_port_signal_t* signal, u32 timeout_ms);
+
+    /**
+     * @brief Wakes up the consumer from interrupt context (also safe to call from a task)
+     * @param signal Initialized signal
+     */
+    void mb_port_signal_give_from_isr(mb_port_signal_t* signal);
+
+    /**
+     * @brief Get an identifier of the calling task or thread, never NULL
+     */
+    void* mb_port_get_context(void);
+
+    /**
+     * @brief Reads the free-running CPU cycle counter (nanoseconds on the host)
+     */
+    u32 mb_port_get_cycles(void);
+
+    /**
+     * @brief Get the number of mb_port_get_cycles() ticks per microsecond
+     */
+    u32 mb_port_get_cycles_per_us(void);
+
+    /**
+     * @brief Get a free-running microsecond time stamp (wraps after about 71 minutes)
+     */
+    u32 mb_port_get_time_us(void);
+
+    /**
+     * @brief Gives up the CPU for a moment, also to tasks of lower priority
+     */
+    void mb_port_yield(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MESSAGEBROKERPORT_H
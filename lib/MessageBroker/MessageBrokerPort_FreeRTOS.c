@@ -0,0 +1,69 @@
+#if defined(ESP_PLATFORM)
+
+#include "MessageBrokerPort.h"
+#include "custom_assert.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+static portMUX_TYPE prv_broker_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void mb_port_lock(void) { portENTER_CRITICAL(&prv_broker_mux); }
+
+void mb_port_unlock(void) { portEXIT_CRITICAL(&prv_broker_mux); }
+
+void mb_port_signal_init(mb_port_signal_t* signal)
+{
+    ASSERT(signal != NULL);
+
+    signal->handle = xSemaphoreCreateBinaryStatic(&signal->buffer);
+    ASSERT(signal->handle != NULL);
+}
+
+void mb_port_signal_give(mb_port_signal_t* signal)
+{
+    ASSERT(signal != NULL);
+
+    // A failing give only means that the signal is already pending
+    (void)xSemaphoreGive(signal->handle);
+}
+
+void mb_port_signal_give_from_isr(mb_port_signal_t* signal)
+{
+    if (!xPortInIsrContext())
+    {
+        mb_port_signal_give(signal);
+        return;
+    }
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    (void)xSemaphoreGiveFromISR(signal->handle, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+bool mb_port_signal_take(mb_port_signal_t* signal, u32 timeout_ms)
+{
+    ASSERT(signal != NULL);
+
+    TickType_t ticks = (timeout_ms == MB_PORT_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xSemaphoreTake(signal->handle, ticks) == pdTRUE;
+}
+
+void* mb_port_get_context(void) { return (void*)xTaskGetCurrentTaskHandle(); }
+
+u32 mb_port_get_cycles(void) { return (u32)esp_cpu_get_cycle_count(); }
+
+u32 mb_port_get_cycles_per_us(void) { return esp_rom_get_cpu_ticks_per_us(); }
+
+u32 mb_port_get_time_us(void) { return (u32)esp_timer_get_time(); }
+
+void mb_port_yield(void) { vTaskDelay(1); }
+
+#endif // ESP_PLATFORM
@@ -0,0 +1,104 @@
+#if !defined(ESP_PLATFORM)
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include "MessageBrokerPort.h"
+#include "custom_assert.h"
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+static pthread_mutex_t prv_broker_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void mb_port_lock(void) { pthread_mutex_lock(&prv_broker_mutex); }
+
+void mb_port_unlock(void) { pthread_mutex_unlock(&prv_broker_mutex); }
+
+void mb_port_signal_init(mb_port_signal_t* signal)
+{
+    ASSERT(signal != NULL);
+
+    pthread_mutex_init(&signal->mutex, NULL);
+    pthread_cond_init(&signal->cond, NULL);
+    signal->is_given = false;
+}
+
+void mb_port_signal_give(mb_port_signal_t* signal)
+{
+    ASSERT(signal != NULL);
+
+    pthread_mutex_lock(&signal->mutex);
+    signal->is_given = true;
+    pthread_cond_signal(&signal->cond);
+    pthread_mutex_unlock(&signal->mutex);
+}
+
+// There are no interrupts on the host, "ISR" producers are plain threads
+void mb_port_signal_give_from_isr(mb_port_signal_t* signal) { mb_port_signal_give(signal); }
+
+bool mb_port_signal_take(mb_port_signal_t* signal, u32 timeout_ms)
+{
+    ASSERT(signal != NULL);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms != MB_PORT_WAIT_FOREVER)
+    {
+        deadline.tv_sec += timeout_ms / 1000U;
+        deadline.tv_nsec += (long)(timeout_ms % 1000U) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&signal->mutex);
+    int status = 0;
+    while (!signal->is_given && status != ETIMEDOUT)
+    {
+        if (timeout_ms == MB_PORT_WAIT_FOREVER)
+        {
+            status = pthread_cond_wait(&signal->cond, &signal->mutex);
+        }
+        else
+        {
+            status = pthread_cond_timedwait(&signal->cond, &signal->mutex, &deadline);
+        }
+    }
+    bool is_given = signal->is_given;
+    signal->is_given = false;
+    pthread_mutex_unlock(&signal->mutex);
+
+    return is_given;
+}
+
+void* mb_port_get_context(void)
+{
+    static __thread u8 thread_marker; // One distinct address per thread
+    return &thread_marker;
+}
+
+u32 mb_port_get_cycles(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u32)((u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec);
+}
+
+u32 mb_port_get_cycles_per_us(void) { return 1000U; }
+
+u32 mb_port_get_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u32)((u64)now.tv_sec * 1000000ULL + (u64)now.tv_nsec / 1000ULL);
+}
+
+void mb_port_yield(void) { (void)sched_yield(); }
+
+#endif // !ESP_PLATFORM
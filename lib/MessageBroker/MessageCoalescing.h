@@ -0,0 +1,35 @@
+#ifndef MESSAGECOALESCING_H_
+#define MESSAGECOALESCING_H_
+
+/**
+ * Coalescing of queued deliveries (MESSAGEBROKER_ASYNC_DISPATCH).
+ *
+ * A message for a subscriber that still has an undelivered message of the same topic
+ * in its queue is merged according to the policy of the topic:
+ *
+ * COALESCE_LATEST     The pending entry takes the new payload and keeps its place in the
+ *                     queue. For topics that set a value, only the last one matters.
+ * COALESCE_DUPLICATES The new message is dropped if its payload equals the pending one.
+ *                     For notifications and queries - correlated requests (MessageRpc.h)
+ *                     differ in their ID and are never merged.
+ *
+ * Topics that are not listed are always queued, synchronous deliveries are never merged.
+ */
+
+#define MESSAGE_COALESCED_TOPICS(X)                                                                                    \
+    X(MSG_0003, COALESCE_LATEST)     /* Logging Application Control */                                                 \
+    X(MSG_0004, COALESCE_LATEST)     /* Logging Desk Control */                                                        \
+    X(MSG_0005, COALESCE_LATEST)     /* Logging Presence Detector */                                                   \
+    X(MSG_0006, COALESCE_LATEST)     /* Logging Network Time */                                                        \
+    X(MSG_1002, COALESCE_DUPLICATES) /* Get Desk Height */                                                             \
+    X(MSG_1003, COALESCE_DUPLICATES) /* Desk UART Data Received, one delivery reads all pending bytes */               \
+    X(MSG_2003, COALESCE_LATEST)     /* Set Presence Threshold */                                                      \
+    X(MSG_2004, COALESCE_DUPLICATES) /* Get Presence Threshold */                                                      \
+    X(MSG_4001, COALESCE_LATEST)     /* Set Timer Interval, each delivery writes the flash */                          \
+    X(MSG_4002, COALESCE_DUPLICATES) /* Get Timer Interval */                                                          \
+    X(MSG_4003, COALESCE_DUPLICATES) /* Get Elapsed Timer Time */                                                      \
+    X(MSG_5001, COALESCE_LATEST)     /* Set WiFi Credentials, each delivery reconnects */                              \
+    X(MSG_5003, COALESCE_DUPLICATES) /* Get WiFi Status */                                                             \
+    X(MSG_5004, COALESCE_DUPLICATES) /* Get Time Info */
+
+#endif /* MESSAGECOALESCING_H_ */
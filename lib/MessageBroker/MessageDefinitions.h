@@ -1,6 +1,7 @@
 #ifndef MESSAGE_DEFINITIONS_H
 #define MESSAGE_DEFINITIONS_H
 
+#include "MessageRpc.h"
 #include "custom_types.h"
 
 /*********************************************
@@ -29,4 +30,83 @@ typedef struct
     u32 timestamp_sec; // Time stamp in seconds
 } msg_countdown_timestamp_t;
 
+/*********************************************
+ * Timer Service (TimerManager)
+ ********************************************/
+typedef enum
+{
+    TIMER_ID_COUNTDOWN = 0,  // Countdown of the ApplicationControl (MSG_3001/MSG_3002), expires with MSG_3003
+    TIMER_ID_PRESENCE_SCAN,  // PresenceDetector: evaluation of the BLE scan results
+    TIMER_ID_TIME_SYNC,      // NetworkTime: next NTP synchronization
+    TIMER_ID_PRESENCE_GRACE, // ApplicationControl: presence lost, the paused countdown resumes if it returns in time
+    TIMER_ID_LAST
+} timer_id_e;
+
+typedef struct
+{
+    timer_id_e timer_id;
+    u32 delay_ms;  // Time until the first expiry
+    u32 period_ms; // Time between the following expiries, 0 = one-shot
+} msg_timer_start_t; // MSG_3004
+
+/*********************************************
+ * Query Replies (see MessageRpc.h)
+ ********************************************/
+typedef struct
+{
+    msg_reply_header_t header;
+    bool is_valid; // false until the desk has reported its height
+    float height_cm;
+} msg_desk_height_reply_t; // MSG_1004
+
+typedef struct
+{
+    msg_reply_header_t header;
+    s32 threshold; // Number of close devices that count as presence
+} msg_presence_threshold_reply_t; // MSG_2005
+
+typedef struct
+{
+    msg_reply_header_t header;
+    u32 active_mask;                 // Bit n = timer n is running
+    u32 paused_mask;                 // Bit n = timer n is paused
+    u32 remaining_ms[TIMER_ID_LAST]; // Time until the next expiry or left when paused, 0 if the timer is stopped
+} msg_timers_reply_t; // MSG_3008
+
+typedef struct
+{
+    msg_reply_header_t header;
+    u32 interval_ms;
+} msg_timer_interval_reply_t; // MSG_4004
+
+typedef struct
+{
+    msg_reply_header_t header;
+    bool is_running;
+    bool is_paused; // Presence lost, the countdown waits for the grace period
+    u32 elapsed_ms; // Time the countdown has run without its pauses, 0 if it is not running
+    u32 interval_ms;
+} msg_elapsed_time_reply_t; // MSG_4005
+
+typedef struct
+{
+    msg_reply_header_t header;
+    bool is_connected;
+    u32 ip_address; // IPv4 address, first octet in the lowest byte, 0 if not connected
+    char ssid[33];  // Zero terminated, empty if not connected
+} msg_wifi_status_reply_t; // MSG_5005
+
+typedef struct
+{
+    msg_reply_header_t header;
+    bool is_synchronized; // The fields below are only valid if the time is synchronized
+    u16 year;
+    u8 month;   // 1 .. 12
+    u8 day;     // 1 .. 31
+    u8 weekday; // 0 = Sunday
+    u8 hour;
+    u8 minute;
+    u8 second;
+} msg_time_info_reply_t; // MSG_5006
+
 #endif // MESSAGE_DEFINITIONS_H
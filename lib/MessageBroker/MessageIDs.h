@@ -22,28 +22,42 @@ typedef enum
     MSG_1000, // Move Desk to up, down, p1, p2, p3, p4, wake, memory
     MSG_1001, // Toggle Desk Position
     MSG_1002, // Get Desk Height (query current height)
+    MSG_1003, // Desk UART Data Received (published from the UART receive callback)
+    MSG_1004, // Desk Height Reply (msg_desk_height_reply_t)
 
     // Messages for the Presence Detector
     MSG_2001, // Presence Detected
     MSG_2002, // No Presence Detected
     MSG_2003, // Set Presence Threshold (number of close devices)
     MSG_2004, // Get Presence Threshold (query current threshold)
+    MSG_2005, // Presence Threshold Reply (msg_presence_threshold_reply_t)
 
-    // Messages for the Countdown Timer
+    // Messages for the Countdown Timer and the Timer Service
     MSG_3001, // Start Countdown with Time Stamp
     MSG_3002, // Stop Countdown
     MSG_3003, // Countdown finished
+    MSG_3004, // Start Timer (msg_timer_start_t)
+    MSG_3005, // Stop Timer
+    MSG_3006, // Timer Expired
+    MSG_3007, // Get Timers (query remaining time of all timers)
+    MSG_3008, // Timers Reply (msg_timers_reply_t)
+    MSG_3009, // Pause Timer (keeps the remaining time)
+    MSG_3010, // Resume Timer
 
     // Application Control Configuration Messages
     MSG_4001, // Set Timer Interval (in minutes)
     MSG_4002, // Get Timer Interval (query current interval)
     MSG_4003, // Get Elapsed Timer Time (query how long timer has been running)
+    MSG_4004, // Timer Interval Reply (msg_timer_interval_reply_t)
+    MSG_4005, // Elapsed Timer Time Reply (msg_elapsed_time_reply_t)
 
     // Network Time Module Messages
     MSG_5001, // Set WiFi Credentials
     MSG_5002, // Get WiFi Credentials
     MSG_5003, // Get WiFi Status
     MSG_5004, // Get Time Info
+    MSG_5005, // WiFi Status Reply (msg_wifi_status_reply_t)
+    MSG_5006, // Time Info Reply (msg_time_info_reply_t)
 
     E_TOPIC_LAST_TOPIC // Last Topic - DO NOT USE (Only for boundary checks)
 } msg_id_e;
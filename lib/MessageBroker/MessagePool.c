@@ -0,0 +1,173 @@
+#include "MessagePool.h"
+#include "MessageBrokerPort.h"
+#include "custom_assert.h"
+
+// ---------------------------------------------------------------------------
+// Defines and Macros
+// ---------------------------------------------------------------------------
+#define MESSAGEPOOL_NO_BLOCK 0xFFFFU
+
+// ---------------------------------------------------------------------------
+// Private Types
+// ---------------------------------------------------------------------------
+// The union keeps every block aligned, so payloads can be accessed as u32/u64 structs
+typedef union
+{
+    u8 bytes[MESSAGEPOOL_BLOCK_SIZE];
+    u64 alignment;
+} messagepool_block_t;
+
+_Static_assert(MESSAGEPOOL_NOF_BLOCKS < MESSAGEPOOL_NO_BLOCK, "Too many pool blocks for the free list indices");
+_Static_assert(MESSAGEPOOL_BLOCK_SIZE <= 0xFFFFU, "Pool blocks are addressed with u16 sizes");
+
+// ---------------------------------------------------------------------------
+// Private Function Declarations
+// ---------------------------------------------------------------------------
+static u16 prv_get_block_index(const void* payload);
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+static messagepool_block_t blocks[MESSAGEPOOL_NOF_BLOCKS];
+// Atomic, so that references can be taken while the caller holds the broker lock
+static u32 reference_counts[MESSAGEPOOL_NOF_BLOCKS] = {0};
+static u16 next_free_block[MESSAGEPOOL_NOF_BLOCKS] = {0};
+static u16 free_list_head = MESSAGEPOOL_NO_BLOCK;
+
+static u16 nof_used_blocks = 0;
+static u16 peak_used_blocks = 0;
+static u32 nof_allocations = 0;
+static u32 nof_failed_allocations = 0;
+static u64 total_alloc_cycles = 0;
+static u32 max_alloc_cycles = 0;
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void messagepool_init(void)
+{
+    mb_port_lock();
+    for (u16 i = 0; i < MESSAGEPOOL_NOF_BLOCKS; i++)
+    {
+        reference_counts[i] = 0;
+        next_free_block[i] = (((u32)i + 1U) < MESSAGEPOOL_NOF_BLOCKS) ? (u16)(i + 1) : MESSAGEPOOL_NO_BLOCK;
+    }
+    free_list_head = 0;
+
+    nof_used_blocks = 0;
+    peak_used_blocks = 0;
+    nof_allocations = 0;
+    nof_failed_allocations = 0;
+    total_alloc_cycles = 0;
+    max_alloc_cycles = 0;
+    mb_port_unlock();
+}
+
+void* messagepool_alloc(u16 size)
+{
+    ASSERT(size > 0);
+    ASSERT(size <= MESSAGEPOOL_BLOCK_SIZE); // Increase MESSAGEPOOL_BLOCK_SIZE
+
+    u32 start_cycles = mb_port_get_cycles();
+
+    mb_port_lock();
+    u16 index = free_list_head;
+    if (index == MESSAGEPOOL_NO_BLOCK)
+    {
+        nof_failed_allocations++;
+        mb_port_unlock();
+        return NULL;
+    }
+
+    free_list_head = next_free_block[index];
+    __atomic_store_n(&reference_counts[index], 1U, __ATOMIC_RELAXED);
+
+    nof_used_blocks++;
+    if (nof_used_blocks > peak_used_blocks)
+    {
+        peak_used_blocks = nof_used_blocks;
+    }
+
+    // Measured inside the critical section, so it includes the time spent waiting for the lock
+    u32 elapsed_cycles = mb_port_get_cycles() - start_cycles;
+    nof_allocations++;
+    total_alloc_cycles += elapsed_cycles;
+    if (elapsed_cycles > max_alloc_cycles)
+    {
+        max_alloc_cycles = elapsed_cycles;
+    }
+    mb_port_unlock();
+
+    return blocks[index].bytes;
+}
+
+void messagepool_retain(const void* payload)
+{
+    u16 index = prv_get_block_index(payload);
+    ASSERT(index != MESSAGEPOOL_NO_BLOCK); // Only pooled payloads can be retained
+
+    u32 previous_count = __atomic_fetch_add(&reference_counts[index], 1U, __ATOMIC_RELAXED);
+    ASSERT(previous_count > 0); // Use after release
+}
+
+void messagepool_release(const void* payload)
+{
+    u16 index = prv_get_block_index(payload);
+    ASSERT(index != MESSAGEPOOL_NO_BLOCK); // Only pooled payloads can be released
+
+    u32 previous_count = __atomic_fetch_sub(&reference_counts[index], 1U, __ATOMIC_ACQ_REL);
+    ASSERT(previous_count > 0); // Double release
+
+    if (previous_count == 1)
+    {
+        // Last reference gone, nobody else can reach the block anymore
+        mb_port_lock();
+        next_free_block[index] = free_list_head;
+        free_list_head = index;
+        nof_used_blocks--;
+        mb_port_unlock();
+    }
+}
+
+bool messagepool_owns(const void* payload) { return prv_get_block_index(payload) != MESSAGEPOOL_NO_BLOCK; }
+
+void messagepool_get_stats(messagepool_stats_t* stats)
+{
+    ASSERT(stats != NULL);
+
+    mb_port_lock();
+    stats->nof_blocks = MESSAGEPOOL_NOF_BLOCKS;
+    stats->block_size = MESSAGEPOOL_BLOCK_SIZE;
+    stats->nof_used_blocks = nof_used_blocks;
+    stats->peak_used_blocks = peak_used_blocks;
+    stats->nof_allocations = nof_allocations;
+    stats->nof_failed_allocations = nof_failed_allocations;
+    stats->avg_alloc_cycles = (nof_allocations > 0) ? (u32)(total_alloc_cycles / nof_allocations) : 0;
+    stats->max_alloc_cycles = max_alloc_cycles;
+    mb_port_unlock();
+
+    stats->cycles_per_us = mb_port_get_cycles_per_us();
+    stats->footprint_bytes = (u32)(sizeof(blocks) + sizeof(reference_counts) + sizeof(next_free_block));
+}
+
+// ---------------------------------------------------------------------------
+// Private Function Implementations
+// ---------------------------------------------------------------------------
+static u16 prv_get_block_index(const void* payload)
+{
+    const u8* first = blocks[0].bytes;
+    const u8* address = (const u8*)payload;
+
+    if ((address < first) || (address >= (const u8*)&blocks[MESSAGEPOOL_NOF_BLOCKS]))
+    {
+        return MESSAGEPOOL_NO_BLOCK;
+    }
+
+    size_t offset = (size_t)(address - first);
+    if ((offset % sizeof(messagepool_block_t)) != 0)
+    {
+        return MESSAGEPOOL_NO_BLOCK; // Points into the middle of a block
+    }
+
+    return (u16)(offset / sizeof(messagepool_block_t));
+}
@@ -0,0 +1,71 @@
+#ifndef MESSAGEPOOL_H
+#define MESSAGEPOOL_H
+
+#include "MessageBrokerConfig.h"
+#include "custom_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * Fixed-block, reference counted payload buffers for msg_t.data_bytes.
+     *
+     * A publisher allocates a block, writes the payload into it, publishes and releases
+     * its own reference. Every queued delivery holds a reference of its own, so the
+     * block stays valid until the last subscriber has processed it. A subscriber that
+     * wants to keep a pooled payload beyond its callback calls messagepool_retain().
+     */
+
+    typedef struct
+    {
+        u16 nof_blocks;
+        u16 block_size;
+        u16 nof_used_blocks;
+        u16 peak_used_blocks;
+        u32 nof_allocations;
+        u32 nof_failed_allocations;
+        u32 avg_alloc_cycles;
+        u32 max_alloc_cycles;
+        u32 cycles_per_us;
+        u32 footprint_bytes; // Static RAM of the blocks and their bookkeeping
+    } messagepool_stats_t;
+
+    /**
+     * @brief Puts all blocks back on the free list and clears the statistics
+     */
+    void messagepool_init(void);
+
+    /**
+     * @brief Allocates a payload block with a reference count of one
+     * @param size Payload size in bytes, at most MESSAGEPOOL_BLOCK_SIZE
+     * @return Block or NULL if the pool is exhausted
+     */
+    void* messagepool_alloc(u16 size);
+
+    /**
+     * @brief Takes an additional reference on a pooled payload (lock-free)
+     */
+    void messagepool_retain(const void* payload);
+
+    /**
+     * @brief Drops a reference, the block returns to the pool with the last one
+     */
+    void messagepool_release(const void* payload);
+
+    /**
+     * @brief Checks whether the pointer is the start of a pool block
+     */
+    bool messagepool_owns(const void* payload);
+
+    /**
+     * @brief Get a snapshot of the pool occupancy and allocation latency
+     */
+    void messagepool_get_stats(messagepool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MESSAGEPOOL_H
@@ -0,0 +1,37 @@
+#ifndef MESSAGEPRIORITIES_H_
+#define MESSAGEPRIORITIES_H_
+
+/**
+ * Priority classes of queued deliveries (MESSAGEBROKER_ASYNC_DISPATCH).
+ *
+ * MSG_PRIORITY_HIGH   The desk movement path. A desk command must not wait behind a
+ *                     flood of console queries in the DeskControl queue.
+ * MSG_PRIORITY_LOW    Queries, logging toggles and test messages - whatever a console user
+ *                     can publish in bulk.
+ *
+ * Topics that are not listed are MSG_PRIORITY_NORMAL. A task dispatches its queue strictly by
+ * class, so a steady stream of high priority messages delays the lower lanes indefinitely.
+ * Synchronous deliveries run in the publisher and have no priority.
+ */
+
+#define MESSAGE_PRIORITY_TOPICS(X)                                                                                     \
+    X(MSG_0001, MSG_PRIORITY_LOW)  /* Chaos Elephant */                                                                \
+    X(MSG_0002, MSG_PRIORITY_LOW)  /* Tickly Giraffe */                                                                \
+    X(MSG_0003, MSG_PRIORITY_LOW)  /* Logging Application Control */                                                   \
+    X(MSG_0004, MSG_PRIORITY_LOW)  /* Logging Desk Control */                                                          \
+    X(MSG_0005, MSG_PRIORITY_LOW)  /* Logging Presence Detector */                                                     \
+    X(MSG_0006, MSG_PRIORITY_LOW)  /* Logging Network Time */                                                          \
+    X(MSG_1000, MSG_PRIORITY_HIGH) /* Move Desk */                                                                     \
+    X(MSG_1001, MSG_PRIORITY_HIGH) /* Toggle Desk Position */                                                          \
+    X(MSG_1002, MSG_PRIORITY_LOW)  /* Get Desk Height */                                                               \
+    X(MSG_1003, MSG_PRIORITY_HIGH) /* Desk UART Data Received, the desk expects the command frame in time */           \
+    X(MSG_2004, MSG_PRIORITY_LOW)  /* Get Presence Threshold */                                                        \
+    X(MSG_3003, MSG_PRIORITY_HIGH) /* Countdown finished, moves the desk */                                            \
+    X(MSG_3007, MSG_PRIORITY_LOW)  /* Get Timers */                                                                    \
+    X(MSG_4002, MSG_PRIORITY_LOW)  /* Get Timer Interval */                                                            \
+    X(MSG_4003, MSG_PRIORITY_LOW)  /* Get Elapsed Timer Time */                                                        \
+    X(MSG_5002, MSG_PRIORITY_LOW)  /* Get WiFi Credentials */                                                          \
+    X(MSG_5003, MSG_PRIORITY_LOW)  /* Get WiFi Status */                                                               \
+    X(MSG_5004, MSG_PRIORITY_LOW)  /* Get Time Info */
+
+#endif /* MESSAGEPRIORITIES_H_ */
@@ -0,0 +1,19 @@
+#ifndef MESSAGERETAINED_H_
+#define MESSAGERETAINED_H_
+
+/**
+ * Retained topics: the broker keeps the last published message of a retained topic
+ * and replays it to every subscriber that subscribes later.
+ *
+ * Topics that describe one state share a slot, e.g. "present" and "not present".
+ * Only the topic that was published last is replayed, a late subscriber never sees
+ * an outdated state. Retained payloads are held in the MessagePool.
+ */
+
+#define MESSAGE_RETAINED_SLOTS(X) X(RETAINED_SLOT_PRESENCE)
+
+#define MESSAGE_RETAINED_TOPICS(X)                                                                                     \
+    X(MSG_2001, RETAINED_SLOT_PRESENCE) /* Presence Detected */                                                       \
+    X(MSG_2002, RETAINED_SLOT_PRESENCE) /* No Presence Detected */
+
+#endif /* MESSAGERETAINED_H_ */
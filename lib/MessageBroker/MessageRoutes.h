@@ -0,0 +1,78 @@
+#ifndef MESSAGEROUTES_H_
+#define MESSAGEROUTES_H_
+
+/**
+ * Compile-time wiring of topics to subscribers (MESSAGEBROKER_STATIC_ROUTES=1).
+ *
+ * MESSAGE_SUBSCRIBERS lists every subscriber callback exactly once - the position in
+ * the list is the subscriber's bit in the route masks (at most 32 subscribers).
+ * MESSAGE_ROUTES lists every topic that has subscribers, at most once per topic.
+ *
+ * Keep this file in sync with the messagebroker_subscribe*() calls of the modules,
+ * which are used instead when the static routes are disabled.
+ */
+
+#define MESSAGE_SUBSCRIBERS(X)                                                                                         \
+    X(SUBSCRIBER_MAIN, main_msg_broker_callback)                                                                       \
+    X(SUBSCRIBER_APPCTRL, applicationcontrol_msg_broker_callback)                                                      \
+    X(SUBSCRIBER_CONSOLE, console_msg_broker_callback)                                                                 \
+    X(SUBSCRIBER_DESKCTRL, deskcontrol_msg_broker_callback)                                                            \
+    X(SUBSCRIBER_NETTIME, networktime_msg_broker_callback)                                                             \
+    X(SUBSCRIBER_PRESENCE, presencedetector_msg_broker_callback)                                                       \
+    X(SUBSCRIBER_TIMERMGR, timermanager_msg_broker_callback)                                                           \
+    X(SUBSCRIBER_RPC, messagerpc_msg_broker_callback)
+
+#define SUBSCRIBER_BIT(subscriber) (1UL << (subscriber))
+
+#define MESSAGE_ROUTES(X)                                                                                              \
+    /* Test Messages */                                                                                                \
+    X(MSG_0001, SUBSCRIBER_BIT(SUBSCRIBER_CONSOLE))                                                                    \
+                                                                                                                       \
+    /* Logging Control Messages */                                                                                     \
+    X(MSG_0003, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                                                    \
+    X(MSG_0004, SUBSCRIBER_BIT(SUBSCRIBER_DESKCTRL))                                                                   \
+    X(MSG_0005, SUBSCRIBER_BIT(SUBSCRIBER_PRESENCE))                                                                   \
+    X(MSG_0006, SUBSCRIBER_BIT(SUBSCRIBER_NETTIME))                                                                    \
+                                                                                                                       \
+    /* Messages for Desk Control */                                                                                    \
+    X(MSG_1000, SUBSCRIBER_BIT(SUBSCRIBER_DESKCTRL))                                                                   \
+    X(MSG_1002, SUBSCRIBER_BIT(SUBSCRIBER_DESKCTRL))                                                                   \
+    X(MSG_1003, SUBSCRIBER_BIT(SUBSCRIBER_DESKCTRL))                                                                   \
+    X(MSG_1004, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+                                                                                                                       \
+    /* Messages for the Presence Detector */                                                                           \
+    X(MSG_2001, SUBSCRIBER_BIT(SUBSCRIBER_MAIN) | SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                  \
+    X(MSG_2002, SUBSCRIBER_BIT(SUBSCRIBER_MAIN) | SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                  \
+    X(MSG_2003, SUBSCRIBER_BIT(SUBSCRIBER_PRESENCE))                                                                   \
+    X(MSG_2004, SUBSCRIBER_BIT(SUBSCRIBER_PRESENCE))                                                                   \
+    X(MSG_2005, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+                                                                                                                       \
+    /* Messages for the Countdown Timer and the Timer Service */                                                       \
+    X(MSG_3001, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3002, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3003, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL) | SUBSCRIBER_BIT(SUBSCRIBER_CONSOLE))                               \
+    X(MSG_3004, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3005, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3006, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL) | SUBSCRIBER_BIT(SUBSCRIBER_NETTIME) |                              \
+                    SUBSCRIBER_BIT(SUBSCRIBER_PRESENCE))                                                               \
+    X(MSG_3007, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3008, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+    X(MSG_3009, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+    X(MSG_3010, SUBSCRIBER_BIT(SUBSCRIBER_TIMERMGR))                                                                   \
+                                                                                                                       \
+    /* Application Control Configuration Messages */                                                                  \
+    X(MSG_4001, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                                                    \
+    X(MSG_4002, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                                                    \
+    X(MSG_4003, SUBSCRIBER_BIT(SUBSCRIBER_APPCTRL))                                                                    \
+    X(MSG_4004, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+    X(MSG_4005, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+                                                                                                                       \
+    /* Network Time Module Messages */                                                                                 \
+    X(MSG_5001, SUBSCRIBER_BIT(SUBSCRIBER_NETTIME))                                                                    \
+    X(MSG_5002, SUBSCRIBER_BIT(SUBSCRIBER_NETTIME))                                                                    \
+    X(MSG_5003, SUBSCRIBER_BIT(SUBSCRIBER_NETTIME))                                                                    \
+    X(MSG_5004, SUBSCRIBER_BIT(SUBSCRIBER_NETTIME))                                                                    \
+    X(MSG_5005, SUBSCRIBER_BIT(SUBSCRIBER_RPC))                                                                        \
+    X(MSG_5006, SUBSCRIBER_BIT(SUBSCRIBER_RPC))
+
+#endif /* MESSAGEROUTES_H_ */
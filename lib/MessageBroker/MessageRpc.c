@@ -0,0 +1,243 @@
+#include "MessageRpc.h"
+#include <string.h>
+#include "MessageBrokerPort.h"
+#include "custom_assert.h"
+
+// ---------------------------------------------------------------------------
+// Private Types
+// ---------------------------------------------------------------------------
+// Call waiting for its reply, the fields are guarded by mb_port_lock()
+typedef struct
+{
+    bool is_pending;
+    bool is_answered;
+    u16 correlation_id;
+    msg_id_e reply_topic;
+    void* reply;
+    u16 reply_size;
+    msg_queue_t* queue; // Delivery queue of the caller, dispatched while it waits (NULL = wait on signal)
+    mb_port_signal_t signal;
+} msg_rpc_call_t;
+
+// ---------------------------------------------------------------------------
+// Private Function Declarations
+// ---------------------------------------------------------------------------
+static msg_rpc_call_t* prv_claim_call(msg_id_e reply_topic, void* reply, u16 reply_size);
+static bool prv_wait_for_reply(msg_rpc_call_t* call, u32 timeout_ms);
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+static msg_rpc_call_t calls[MESSAGEBROKER_RPC_MAX_PENDING];
+static u16 next_correlation_id = 1;
+static msg_rpc_stats_t stats = {0};
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void messagerpc_init(void)
+{
+    for (u8 i = 0; i < MESSAGEBROKER_RPC_MAX_PENDING; i++)
+    {
+        calls[i].is_pending = false;
+        calls[i].is_answered = false;
+        mb_port_signal_init(&calls[i].signal);
+    }
+    next_correlation_id = 1;
+    memset(&stats, 0, sizeof(stats));
+
+#define MESSAGERPC_SUBSCRIBE(topic) messagebroker_subscribe(topic, messagerpc_msg_broker_callback);
+    MESSAGE_REPLY_TOPICS(MESSAGERPC_SUBSCRIBE)
+#undef MESSAGERPC_SUBSCRIBE
+}
+
+msg_rpc_status_e messagerpc_call(msg_id_e request_topic, msg_id_e reply_topic, void* reply, u16 reply_size,
+                                 u32 timeout_ms)
+{
+    { // Input Checks
+        ASSERT(reply != NULL);
+        ASSERT(reply_size >= sizeof(msg_reply_header_t));
+    }
+
+    msg_rpc_call_t* call = prv_claim_call(reply_topic, reply, reply_size);
+
+    msg_request_t request;
+    request.correlation_id = call->correlation_id;
+
+    msg_t message;
+    message.msg_id = request_topic;
+    message.data_size = sizeof(request);
+    message.data_bytes = (u8*)&request;
+
+    u32 start_us = mb_port_get_time_us();
+    messagebroker_publish(&message);
+    bool is_answered = prv_wait_for_reply(call, timeout_ms);
+    u32 latency_us = mb_port_get_time_us() - start_us;
+
+    mb_port_lock();
+    // A reply that comes in right after the timeout still counts, it is already in the buffer
+    is_answered = call->is_answered;
+    call->is_pending = false;
+    if (is_answered)
+    {
+        stats.max_latency_us = (latency_us > stats.max_latency_us) ? latency_us : stats.max_latency_us;
+    }
+    else
+    {
+        stats.nof_timeouts++;
+    }
+    mb_port_unlock();
+
+    return is_answered ? MSG_RPC_OK : MSG_RPC_TIMEOUT;
+}
+
+void messagerpc_reply(const msg_t* const request, msg_id_e reply_topic, void* reply, u16 reply_size)
+{
+    { // Input Checks
+        ASSERT(request != NULL);
+        ASSERT(reply != NULL);
+        ASSERT(reply_size >= sizeof(msg_reply_header_t));
+    }
+
+    msg_reply_header_t* header = (msg_reply_header_t*)reply;
+    header->correlation_id = 0;
+    if ((request->data_size >= sizeof(msg_request_t)) && (request->data_bytes != NULL))
+    {
+        header->correlation_id = ((const msg_request_t*)request->data_bytes)->correlation_id;
+    }
+
+    msg_t message;
+    message.msg_id = reply_topic;
+    message.data_size = reply_size;
+    message.data_bytes = (u8*)reply;
+    messagebroker_publish(&message);
+}
+
+void messagerpc_get_stats(msg_rpc_stats_t* out_stats)
+{
+    ASSERT(out_stats != NULL);
+
+    mb_port_lock();
+    *out_stats = stats;
+    mb_port_unlock();
+    out_stats->footprint_bytes = (u32)sizeof(calls);
+}
+
+// Matches replies to the pending calls, runs in the context of the replying task
+void messagerpc_msg_broker_callback(const msg_t* const message)
+{
+    ASSERT(message != NULL);
+
+    if ((message->data_size < sizeof(msg_reply_header_t)) || (message->data_bytes == NULL))
+    {
+        mb_port_lock();
+        stats.nof_unmatched_replies++;
+        mb_port_unlock();
+        return;
+    }
+
+    u16 correlation_id = ((const msg_reply_header_t*)message->data_bytes)->correlation_id;
+    msg_rpc_call_t* answered_call = NULL;
+    msg_queue_t* wake_queue = NULL;
+
+    mb_port_lock();
+    for (u8 i = 0; (i < MESSAGEBROKER_RPC_MAX_PENDING) && (correlation_id != 0); i++)
+    {
+        msg_rpc_call_t* call = &calls[i];
+        if (call->is_pending && !call->is_answered && (call->correlation_id == correlation_id) &&
+            (call->reply_topic == message->msg_id) && (call->reply_size == message->data_size))
+        {
+            memcpy(call->reply, message->data_bytes, message->data_size);
+            call->is_answered = true;
+            answered_call = call;
+            wake_queue = call->queue;
+            break;
+        }
+    }
+    if (answered_call == NULL)
+    {
+        stats.nof_unmatched_replies++;
+    }
+    mb_port_unlock();
+
+    if (wake_queue != NULL)
+    {
+        messagebroker_queue_notify(wake_queue);
+    }
+    else if (answered_call != NULL)
+    {
+        mb_port_signal_give(&answered_call->signal);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Private Function Implementations
+// ---------------------------------------------------------------------------
+static msg_rpc_call_t* prv_claim_call(msg_id_e reply_topic, void* reply, u16 reply_size)
+{
+    msg_rpc_call_t* call = NULL;
+    msg_queue_t* queue = messagebroker_queue_find(mb_port_get_context()); // Takes the lock itself
+
+    mb_port_lock();
+    for (u8 i = 0; i < MESSAGEBROKER_RPC_MAX_PENDING; i++)
+    {
+        if (!calls[i].is_pending)
+        {
+            call = &calls[i];
+            break;
+        }
+    }
+    ASSERT(call != NULL); // Increase MESSAGEBROKER_RPC_MAX_PENDING
+
+    call->is_pending = true;
+    call->is_answered = false;
+    call->correlation_id = next_correlation_id;
+    call->reply_topic = reply_topic;
+    call->reply = reply;
+    call->reply_size = reply_size;
+    call->queue = queue;
+
+    next_correlation_id = (next_correlation_id == 0xFFFFU) ? 1U : (u16)(next_correlation_id + 1U);
+    stats.nof_calls++;
+    mb_port_unlock();
+
+    return call;
+}
+
+// The signal can still be given from an earlier call of the slot, only is_answered counts
+static bool prv_wait_for_reply(msg_rpc_call_t* call, u32 timeout_ms)
+{
+    u32 start_us = mb_port_get_time_us();
+    u32 remaining_ms = timeout_ms;
+
+    while (true)
+    {
+        mb_port_lock();
+        bool is_answered = call->is_answered;
+        mb_port_unlock();
+
+        if (is_answered)
+        {
+            return true;
+        }
+        if (call->queue != NULL)
+        {
+            // The handler of the request may share the task of the caller (cooperative executor), keep dispatching
+            if (remaining_ms == 0)
+            {
+                return false;
+            }
+            messagebroker_queue_process(call->queue, remaining_ms);
+        }
+        else if (!mb_port_signal_take(&call->signal, remaining_ms))
+        {
+            return false;
+        }
+
+        if (timeout_ms != MESSAGEBROKER_WAIT_FOREVER)
+        {
+            u32 elapsed_ms = (mb_port_get_time_us() - start_us) / 1000U;
+            remaining_ms = (elapsed_ms < timeout_ms) ? timeout_ms - elapsed_ms : 0U;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef MESSAGERPC_H
+#define MESSAGERPC_H
+
+#include "MessageBroker.h"
+#include "MessageBrokerConfig.h"
+#include "custom_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * Request/reply on top of the broker.
+     *
+     * A query topic (e.g. MSG_1002) carries a msg_request_t, the handler answers on the
+     * reply topic of the query (e.g. MSG_1004) with a typed payload that starts with a
+     * msg_reply_header_t. The correlation ID of the request is copied into the reply, so
+     * concurrent callers only see their own answer. Everybody else can subscribe to the
+     * reply topic and gets every answer, e.g. a remote interface that polls the state.
+     *
+     * messagerpc_call() publishes the request and blocks until the reply arrives or the
+     * timeout expires. Replies are matched by the RPC subscriber of the reply topics, in
+     * the context of the replying task.
+     * A caller that owns a delivery queue keeps dispatching it while it waits, so the
+     * handler can also run in the task of the caller.
+     */
+
+    // Reply topics, the RPC subscriber is wired to all of them (also add them to MessageRoutes.h)
+#define MESSAGE_REPLY_TOPICS(X)                                                                                        \
+    X(MSG_1004) /* Desk Height Reply */                                                                                \
+    X(MSG_2005) /* Presence Threshold Reply */                                                                         \
+    X(MSG_3008) /* Timers Reply */                                                                                     \
+    X(MSG_4004) /* Timer Interval Reply */                                                                             \
+    X(MSG_4005) /* Elapsed Timer Time Reply */                                                                         \
+    X(MSG_5005) /* WiFi Status Reply */                                                                                \
+    X(MSG_5006) /* Time Info Reply */
+
+    typedef struct
+    {
+        u16 correlation_id; // 0 = uncorrelated, the reply is published all the same
+    } msg_request_t;
+
+    // First member of every reply payload
+    typedef struct
+    {
+        u16 correlation_id; // Copied from the request
+    } msg_reply_header_t;
+
+    typedef enum
+    {
+        MSG_RPC_OK = 0,
+        MSG_RPC_TIMEOUT, // No reply within the timeout, a late reply is dropped
+    } msg_rpc_status_e;
+
+    typedef struct
+    {
+        u32 nof_calls;
+        u32 nof_timeouts;
+        u32 nof_unmatched_replies; // Late, uncorrelated or of the wrong size
+        u32 max_latency_us;        // Longest request to reply time of a successful call
+        u32 footprint_bytes;       // Static RAM of the pending call table
+    } msg_rpc_stats_t;
+
+    /**
+     * @brief Clears the pending calls and the statistics (called by messagebroker_init())
+     */
+    void messagerpc_init(void);
+
+    /**
+     * @brief Publishes a request and waits for the matching reply
+     *
+     * Must not be called from inside a subscriber callback: the request would be deferred
+     * behind the running fan-out and the call could only time out.
+     *
+     * @param request_topic Query topic, e.g. MSG_1002
+     * @param reply_topic Reply topic of the query, e.g. MSG_1004
+     * @param reply Buffer for the typed reply payload (starting with msg_reply_header_t)
+     * @param reply_size Size of the reply type, replies of another size are not accepted
+     * @param timeout_ms Maximum wait time or MESSAGEBROKER_WAIT_FOREVER
+     * @return MSG_RPC_OK if reply holds the answer
+     */
+    msg_rpc_status_e messagerpc_call(msg_id_e request_topic, msg_id_e reply_topic, void* reply, u16 reply_size,
+                                     u32 timeout_ms);
+
+    /**
+     * @brief Answers a request, called by the handler of the query topic
+     * @param request Request as delivered to the handler, an empty payload is answered uncorrelated
+     * @param reply_topic Reply topic of the query
+     * @param reply Typed reply payload, its msg_reply_header_t is filled in here
+     * @param reply_size Size of the reply type
+     */
+    void messagerpc_reply(const msg_t* const request, msg_id_e reply_topic, void* reply, u16 reply_size);
+
+    /**
+     * @brief Get the call and reply counters
+     */
+    void messagerpc_get_stats(msg_rpc_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MESSAGERPC_H
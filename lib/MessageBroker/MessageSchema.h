@@ -0,0 +1,277 @@
+#ifndef MESSAGESCHEMA_H_
+#define MESSAGESCHEMA_H_
+
+#ifndef __cplusplus
+#error "MessageSchema.h is the C++ layer, C code publishes msg_t through MessageBroker.h"
+#endif
+
+#include <string.h>
+#include <type_traits>
+#include "MessageBroker.h"
+#include "MessageBrokerConfig.h"
+#include "MessageDefinitions.h"
+#include "MessageRpc.h"
+#include "custom_types.h"
+
+/**
+ * Typed topics for the C++ modules.
+ *
+ * MESSAGE_SCHEMA binds every topic to its payload type at compile time:
+ *   msg::publish<MSG_1000>(DESK_CMD_UP);                      // only compiles with a desk_command_e
+ *   desk_command_e cmd = msg::payload<MSG_1000>(message);    // no size check, no cast
+ *
+ * The templates compile down to a msg_t and the C API of the broker, so the C code and the
+ * trace format see the same payloads as before. The subscriber relies on the publisher:
+ * payloads that do not come from a typed publish (e.g. a replayed trace) are checked once
+ * with msg::is_valid() before they are published.
+ *
+ * msg_none_t topics carry no payload, msg_text_t topics a zero terminated string and the
+ * queries of MESSAGE_QUERIES a msg_request_t (empty = uncorrelated, see MessageRpc.h).
+ */
+
+struct msg_none_t
+{
+};
+
+struct msg_text_t
+{
+};
+
+// X(topic, payload type) - one entry for every topic of MessageIDs.h
+#define MESSAGE_SCHEMA(X)                                                                                              \
+    X(MSG_0001, msg_text_t)                     /* Chaos Elephant */                                                   \
+    X(MSG_0002, msg_none_t)                     /* Tickly Giraffe */                                                   \
+    X(MSG_0003, bool)                           /* Logging Application Control */                                      \
+    X(MSG_0004, bool)                           /* Logging Desk Control */                                             \
+    X(MSG_0005, bool)                           /* Logging Presence Detector */                                        \
+    X(MSG_0006, bool)                           /* Logging Network Time */                                             \
+    X(MSG_1000, desk_command_e)                 /* Move Desk */                                                        \
+    X(MSG_1001, msg_none_t)                     /* Toggle Desk Position */                                             \
+    X(MSG_1002, msg_request_t)                  /* Get Desk Height */                                                  \
+    X(MSG_1003, msg_none_t)                     /* Desk UART Data Received */                                          \
+    X(MSG_1004, msg_desk_height_reply_t)        /* Desk Height Reply */                                                \
+    X(MSG_2001, msg_none_t)                     /* Presence Detected */                                                \
+    X(MSG_2002, msg_none_t)                     /* No Presence Detected */                                             \
+    X(MSG_2003, s32)                            /* Set Presence Threshold */                                           \
+    X(MSG_2004, msg_request_t)                  /* Get Presence Threshold */                                           \
+    X(MSG_2005, msg_presence_threshold_reply_t) /* Presence Threshold Reply */                                         \
+    X(MSG_3001, u32)                            /* Start Countdown, duration in ms */                                  \
+    X(MSG_3002, msg_none_t)                     /* Stop Countdown */                                                   \
+    X(MSG_3003, msg_none_t)                     /* Countdown finished */                                               \
+    X(MSG_3004, msg_timer_start_t)              /* Start Timer */                                                      \
+    X(MSG_3005, timer_id_e)                     /* Stop Timer */                                                       \
+    X(MSG_3006, timer_id_e)                     /* Timer Expired */                                                    \
+    X(MSG_3007, msg_request_t)                  /* Get Timers */                                                       \
+    X(MSG_3008, msg_timers_reply_t)             /* Timers Reply */                                                     \
+    X(MSG_3009, timer_id_e)                     /* Pause Timer */                                                      \
+    X(MSG_3010, timer_id_e)                     /* Resume Timer */                                                     \
+    X(MSG_4001, u32)                            /* Set Timer Interval, in ms */                                        \
+    X(MSG_4002, msg_request_t)                  /* Get Timer Interval */                                               \
+    X(MSG_4003, msg_request_t)                  /* Get Elapsed Timer Time */                                           \
+    X(MSG_4004, msg_timer_interval_reply_t)     /* Timer Interval Reply */                                             \
+    X(MSG_4005, msg_elapsed_time_reply_t)       /* Elapsed Timer Time Reply */                                         \
+    X(MSG_5001, msg_text_t)                     /* Set WiFi Credentials, "ssid|password" */                            \
+    X(MSG_5002, msg_none_t)                     /* Get WiFi Credentials */                                             \
+    X(MSG_5003, msg_request_t)                  /* Get WiFi Status */                                                  \
+    X(MSG_5004, msg_request_t)                  /* Get Time Info */                                                    \
+    X(MSG_5005, msg_wifi_status_reply_t)        /* WiFi Status Reply */                                                \
+    X(MSG_5006, msg_time_info_reply_t)          /* Time Info Reply */
+
+// X(query topic, reply topic)
+#define MESSAGE_QUERIES(X)                                                                                             \
+    X(MSG_1002, MSG_1004)                                                                                              \
+    X(MSG_2004, MSG_2005)                                                                                              \
+    X(MSG_3007, MSG_3008)                                                                                              \
+    X(MSG_4002, MSG_4004)                                                                                              \
+    X(MSG_4003, MSG_4005)                                                                                              \
+    X(MSG_5003, MSG_5005)                                                                                              \
+    X(MSG_5004, MSG_5006)
+
+namespace msg
+{
+
+// ###########################################################################
+// # Bindings
+// ###########################################################################
+template <msg_id_e ID>
+struct topic; // Not defined - a topic without a schema entry does not compile
+
+template <msg_id_e ID>
+struct query; // Only defined for the query topics
+
+#define MESSAGESCHEMA_TOPIC(id, type)                                                                                  \
+    template <>                                                                                                        \
+    struct topic<id>                                                                                                   \
+    {                                                                                                                  \
+        typedef type payload_t;                                                                                        \
+    };
+MESSAGE_SCHEMA(MESSAGESCHEMA_TOPIC)
+#undef MESSAGESCHEMA_TOPIC
+
+#define MESSAGESCHEMA_QUERY(id, reply_id)                                                                              \
+    template <>                                                                                                        \
+    struct query<id>                                                                                                   \
+    {                                                                                                                  \
+        static constexpr msg_id_e reply_topic = reply_id;                                                              \
+    };
+MESSAGE_QUERIES(MESSAGESCHEMA_QUERY)
+#undef MESSAGESCHEMA_QUERY
+
+#define MESSAGESCHEMA_COUNT(id, type) +1
+static_assert((0 MESSAGE_SCHEMA(MESSAGESCHEMA_COUNT)) == (E_TOPIC_LAST_TOPIC - 1), "Add the topic to MESSAGE_SCHEMA");
+#undef MESSAGESCHEMA_COUNT
+
+template <msg_id_e ID>
+using payload_t = typename topic<ID>::payload_t;
+
+template <msg_id_e ID>
+using reply_t = payload_t<query<ID>::reply_topic>;
+
+template <msg_id_e ID>
+struct is_value_topic
+    : std::integral_constant<bool, !std::is_same<payload_t<ID>, msg_none_t>::value &&
+                                       !std::is_same<payload_t<ID>, msg_text_t>::value>
+{
+};
+
+// ###########################################################################
+// # Publish
+// ###########################################################################
+template <msg_id_e ID, typename T>
+inline void publish(const T& payload)
+{
+    static_assert(std::is_same<T, payload_t<ID>>::value, "Payload type does not match the topic (MESSAGE_SCHEMA)");
+    static_assert(is_value_topic<ID>::value, "Use publish<ID>() or publish_text<ID>() for this topic");
+    static_assert(sizeof(T) <= MESSAGEPOOL_BLOCK_SIZE, "Increase MESSAGEPOOL_BLOCK_SIZE");
+
+    // Borrowed payload, the broker copies it for every delivery that outlives the call
+    msg_t message;
+    message.msg_id = ID;
+    message.data_size = (u16)sizeof(T);
+    message.data_bytes = (u8*)&payload;
+    messagebroker_publish(&message);
+}
+
+template <msg_id_e ID>
+inline void publish(void)
+{
+    static_assert(std::is_same<payload_t<ID>, msg_none_t>::value, "The topic carries a payload (MESSAGE_SCHEMA)");
+
+    msg_t message;
+    message.msg_id = ID;
+    message.data_size = 0;
+    message.data_bytes = NULL;
+    messagebroker_publish(&message);
+}
+
+template <msg_id_e ID>
+inline bool publish_from_isr(void)
+{
+    static_assert(std::is_same<payload_t<ID>, msg_none_t>::value, "Only notifications are published from an ISR");
+
+    msg_t message;
+    message.msg_id = ID;
+    message.data_size = 0;
+    message.data_bytes = NULL;
+    return messagebroker_publish_from_isr(&message);
+}
+
+/**
+ * @brief Publishes a zero terminated string, e.g. from a pool block for a zero-copy hand-off
+ */
+template <msg_id_e ID>
+inline void publish_text(const char* text)
+{
+    static_assert(std::is_same<payload_t<ID>, msg_text_t>::value, "The topic does not carry text (MESSAGE_SCHEMA)");
+
+    msg_t message;
+    message.msg_id = ID;
+    message.data_size = (u16)(strlen(text) + 1U);
+    message.data_bytes = (u8*)text;
+    messagebroker_publish(&message);
+}
+
+// ###########################################################################
+// # Receive
+// ###########################################################################
+/**
+ * @brief Typed view of the payload, only valid during the callback
+ */
+template <msg_id_e ID>
+inline const payload_t<ID>& payload(const msg_t* const message)
+{
+    static_assert(is_value_topic<ID>::value, "The topic carries no value payload (MESSAGE_SCHEMA)");
+    return *reinterpret_cast<const payload_t<ID>*>(message->data_bytes);
+}
+
+template <msg_id_e ID>
+inline const char* text(const msg_t* const message)
+{
+    static_assert(std::is_same<payload_t<ID>, msg_text_t>::value, "The topic does not carry text (MESSAGE_SCHEMA)");
+    return reinterpret_cast<const char*>(message->data_bytes);
+}
+
+// ###########################################################################
+// # Request/Reply
+// ###########################################################################
+template <msg_id_e ID, typename T>
+inline msg_rpc_status_e call(T* reply, u32 timeout_ms)
+{
+    static_assert(std::is_same<T, reply_t<ID>>::value, "Reply type does not match the query (MESSAGE_QUERIES)");
+    return messagerpc_call(ID, query<ID>::reply_topic, reply, (u16)sizeof(T), timeout_ms);
+}
+
+template <msg_id_e ID, typename T>
+inline void reply(const msg_t* const request, T& reply)
+{
+    static_assert(std::is_same<T, reply_t<ID>>::value, "Reply type does not match the query (MESSAGE_QUERIES)");
+    messagerpc_reply(request, query<ID>::reply_topic, &reply, (u16)sizeof(T));
+}
+
+// ###########################################################################
+// # Untyped Payloads
+// ###########################################################################
+template <typename T>
+inline bool is_valid_payload(const msg_t* const message)
+{
+    return (message->data_size == sizeof(T)) && (message->data_bytes != NULL);
+}
+
+template <>
+inline bool is_valid_payload<msg_none_t>(const msg_t* const message)
+{
+    return message->data_size == 0;
+}
+
+template <>
+inline bool is_valid_payload<msg_text_t>(const msg_t* const message)
+{
+    return (message->data_size > 0) && (message->data_bytes != NULL) &&
+           (message->data_bytes[message->data_size - 1U] == '\0');
+}
+
+template <>
+inline bool is_valid_payload<msg_request_t>(const msg_t* const message)
+{
+    return (message->data_size == 0) ||
+           ((message->data_size == sizeof(msg_request_t)) && (message->data_bytes != NULL));
+}
+
+/**
+ * @brief Checks a msg_t from outside the typed layer against MESSAGE_SCHEMA
+ */
+inline bool is_valid(const msg_t* const message)
+{
+    switch (message->msg_id)
+    {
+#define MESSAGESCHEMA_CHECK(id, type)                                                                                  \
+    case id: return is_valid_payload<type>(message);
+        MESSAGE_SCHEMA(MESSAGESCHEMA_CHECK)
+#undef MESSAGESCHEMA_CHECK
+        default: return false;
+    }
+}
+
+} // namespace msg
+
+#endif /* MESSAGESCHEMA_H_ */
@@ -0,0 +1,103 @@
+#include "MessageTrace.h"
+
+#if MESSAGEBROKER_TRACE
+
+#include <string.h>
+#include "MessageBrokerPort.h"
+#include "custom_assert.h"
+#include "monotonic_time.h"
+
+// ---------------------------------------------------------------------------
+// Private Types
+// ---------------------------------------------------------------------------
+_Static_assert((MESSAGEBROKER_TRACE_DEPTH & (MESSAGEBROKER_TRACE_DEPTH - 1U)) == 0,
+               "MESSAGEBROKER_TRACE_DEPTH must be a power of two");
+_Static_assert((MESSAGEBROKER_TRACE_PAYLOAD_SIZE % 8U) == 0, "Keep trace records free of padding");
+_Static_assert(MESSAGEBROKER_TRACE_PAYLOAD_SIZE <= 0xFFU, "The header stores the payload size as u8");
+_Static_assert(E_TOPIC_LAST_TOPIC <= 0xFFU, "Trace records store the msg_id as u8");
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+static msg_trace_record_t records[MESSAGEBROKER_TRACE_DEPTH];
+static u32 write_position = 0; // Total number of records written since the last clear
+static bool is_recording = false;
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void messagetrace_init(void)
+{
+    messagetrace_clear();
+    messagetrace_set_enabled(true);
+}
+
+void messagetrace_record(const msg_t* const message)
+{
+    if (!__atomic_load_n(&is_recording, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    // Claiming a record is a single atomic add, so tasks and interrupts never wait for each other
+    u32 position = __atomic_fetch_add(&write_position, 1U, __ATOMIC_RELAXED);
+    msg_trace_record_t* record = &records[position % MESSAGEBROKER_TRACE_DEPTH];
+
+    record->timestamp_us = monotonic_time_get_us();
+    record->publisher = (u32)(uintptr_t)mb_port_get_context();
+    record->data_size = message->data_size;
+    record->msg_id = (u8)message->msg_id;
+    record->reserved = 0;
+
+    u16 nof_bytes = message->data_size;
+    if (nof_bytes > MESSAGEBROKER_TRACE_PAYLOAD_SIZE)
+    {
+        nof_bytes = MESSAGEBROKER_TRACE_PAYLOAD_SIZE;
+    }
+    if (nof_bytes > 0)
+    {
+        memcpy(record->data_bytes, message->data_bytes, nof_bytes);
+    }
+}
+
+void messagetrace_set_enabled(bool is_enabled) { __atomic_store_n(&is_recording, is_enabled, __ATOMIC_RELAXED); }
+
+void messagetrace_clear(void)
+{
+    bool was_recording = __atomic_exchange_n(&is_recording, false, __ATOMIC_RELAXED);
+    memset(records, 0, sizeof(records));
+    __atomic_store_n(&write_position, 0U, __ATOMIC_RELAXED);
+    __atomic_store_n(&is_recording, was_recording, __ATOMIC_RELAXED);
+}
+
+void messagetrace_get_header(msg_trace_header_t* header)
+{
+    ASSERT(header != NULL);
+
+    u32 nof_written = __atomic_load_n(&write_position, __ATOMIC_RELAXED);
+
+    header->magic = MESSAGETRACE_MAGIC;
+    header->version = MESSAGETRACE_VERSION;
+    header->payload_size = MESSAGEBROKER_TRACE_PAYLOAD_SIZE;
+    header->record_size = sizeof(msg_trace_record_t);
+    header->nof_records = (nof_written < MESSAGEBROKER_TRACE_DEPTH) ? nof_written : MESSAGEBROKER_TRACE_DEPTH;
+    header->nof_overwritten = nof_written - header->nof_records;
+}
+
+bool messagetrace_get_record(u32 index, msg_trace_record_t* record)
+{
+    ASSERT(record != NULL);
+
+    msg_trace_header_t header;
+    messagetrace_get_header(&header);
+    if (index >= header.nof_records)
+    {
+        return false;
+    }
+
+    u32 position = header.nof_overwritten + index;
+    *record = records[position % MESSAGEBROKER_TRACE_DEPTH];
+    return true;
+}
+
+#endif // MESSAGEBROKER_TRACE
@@ -0,0 +1,83 @@
+#ifndef MESSAGETRACE_H
+#define MESSAGETRACE_H
+
+#include "MessageBroker.h"
+#include "MessageBrokerConfig.h"
+#include "custom_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * Recorder of published messages (MESSAGEBROKER_TRACE).
+     *
+     * messagebroker_publish() writes one binary record per message into a RAM ring of
+     * MESSAGEBROKER_TRACE_DEPTH records, the oldest records are overwritten. Recording
+     * never blocks and never takes a lock, so it is safe from every task.
+     *
+     * Binary dump format (little endian, as on the ESP32-C6 and x86 hosts):
+     *   msg_trace_header_t, followed by header.nof_records msg_trace_record_t, oldest first.
+     */
+
+#define MESSAGETRACE_MAGIC   0x5254424DUL // "MBTR"
+#define MESSAGETRACE_VERSION 2U // 2: 64 bit time stamps
+
+    typedef struct
+    {
+        u32 magic;           // MESSAGETRACE_MAGIC
+        u8 version;          // MESSAGETRACE_VERSION
+        u8 payload_size;     // MESSAGEBROKER_TRACE_PAYLOAD_SIZE
+        u16 record_size;     // sizeof(msg_trace_record_t)
+        u32 nof_records;     // Records following the header
+        u32 nof_overwritten; // Records lost since the last clear
+    } msg_trace_header_t;
+
+    typedef struct
+    {
+        u64 timestamp_us; // monotonic_time_get_us() at publish
+        u32 publisher;    // Publishing task (FreeRTOS task handle)
+        u16 data_size;    // Full payload size, data_bytes holds at most the first payload_size bytes
+        u8 msg_id;        // msg_id_e
+        u8 reserved;
+        u8 data_bytes[MESSAGEBROKER_TRACE_PAYLOAD_SIZE];
+    } msg_trace_record_t;
+
+    /**
+     * @brief Clears the ring and enables recording
+     */
+    void messagetrace_init(void);
+
+    /**
+     * @brief Appends a record for the message (called by messagebroker_publish())
+     */
+    void messagetrace_record(const msg_t* const message);
+
+    /**
+     * @brief Pauses or resumes recording, pause it while reading the records
+     */
+    void messagetrace_set_enabled(bool is_enabled);
+
+    /**
+     * @brief Discards all records
+     */
+    void messagetrace_clear(void);
+
+    /**
+     * @brief Get the dump header describing the current content of the ring
+     */
+    void messagetrace_get_header(msg_trace_header_t* header);
+
+    /**
+     * @brief Get a record of the ring
+     * @param index 0 (oldest) .. header.nof_records - 1
+     * @return false if the index is out of range
+     */
+    bool messagetrace_get_record(u32 index, msg_trace_record_t* record);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MESSAGETRACE_H
@@ -0,0 +1,83 @@
+#include "MessageDispatcher.h"
+#include <Arduino.h>
+#include "Executor.h"
+#include "MessageBroker.h"
+#include "custom_assert.h"
+#include "rtos_alloc.h"
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+static void prv_messagedispatcher_task(void* parameter);
+static void prv_messagedispatcher_executor_init(void);
+static u32 prv_messagedispatcher_executor_run(void);
+
+// ###########################################################################
+// # Public function implementations
+// ###########################################################################
+
+TaskHandle_t messagedispatcher_create_task(void)
+{
+    TaskHandle_t task_handle = NULL;
+
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[MESSAGEDISPATCHER_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_messagedispatcher_task,   // Task function
+                                    "MessageDispatcherTask",      // Task name
+                                    MESSAGEDISPATCHER_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                         // Task parameters
+                                    3,                            // Task priority (above the modules)
+                                    task_stack,                   // Task stack
+                                    &task_buffer                  // Task control block
+    );
+#else
+    xTaskCreate(prv_messagedispatcher_task,   // Task function
+                "MessageDispatcherTask",      // Task name
+                MESSAGEDISPATCHER_STACK_SIZE, // Stack size (bytes)
+                NULL,                         // Task parameters
+                3,                            // Task priority (above the modules)
+                &task_handle                  // Task handle
+    );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
+
+    return task_handle;
+}
+
+void messagedispatcher_add_to_executor(void)
+{
+    static const executor_module_t module = {"MessageDispatcher", prv_messagedispatcher_executor_init,
+                                             prv_messagedispatcher_executor_run};
+    executor_register(&module);
+}
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+
+static void prv_messagedispatcher_task(void* parameter)
+{
+    (void)parameter; // Unused parameter
+
+    // Task main loop
+    while (1)
+    {
+        // Sleep until an interrupt publishes, then fan the messages out to the subscribers
+        messagebroker_isr_queue_process(MESSAGEBROKER_WAIT_FOREVER);
+    }
+}
+
+static void prv_messagedispatcher_executor_init(void)
+{
+    // Interrupts wake the executor instead of a dispatcher task
+    messagebroker_isr_queue_set_wake_queue(messagebroker_queue_get_context_queue());
+}
+
+static u32 prv_messagedispatcher_executor_run(void)
+{
+    // Registered first, so the other modules see the hardware events of this wake-up
+    messagebroker_isr_queue_process(0);
+    return MESSAGEBROKER_WAIT_FOREVER;
+}
@@ -0,0 +1,32 @@
+#ifndef MESSAGEDISPATCHER_H
+#define MESSAGEDISPATCHER_H
+
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define MESSAGEDISPATCHER_STACK_SIZE 4096 // Task stack in bytes
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * @brief Creates and starts the MessageDispatcher task, which publishes the
+     *        messages of messagebroker_publish_from_isr()
+     * @return Task handle for the created task
+     */
+    TaskHandle_t messagedispatcher_create_task(void);
+
+    /**
+     * @brief Registers the MessageDispatcher with the cooperative executor
+     *        (EXECUTOR_COOPERATIVE), instead of creating its task
+     */
+    void messagedispatcher_add_to_executor(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MESSAGEDISPATCHER_H
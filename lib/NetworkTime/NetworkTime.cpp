@@ -34,8 +34,11 @@
 #include <time.h>
 #include "MessageBroker.h"
 #include "MessageDefinitions.h"
+#include "MessageSchema.h"
 #include "custom_assert.h"
 #include "custom_types.h"
+#include "monotonic_time.h"
+#include "rtos_alloc.h"
 
 // ###########################################################################
 // # Internal Configuration
@@ -45,6 +48,7 @@
 #define WIFI_MAX_PASSWORD_LEN      64
 #define WIFI_CONNECTION_TIMEOUT_MS 10000
 #define TIME_SYNC_INTERVAL_MS      3600000 // Sync every hour
+#define WIFI_RETRY_INTERVAL_MS     1000    // Reconnect and failed sync attempts
 #define NTP_SERVER                 "pool.ntp.org"
 #define GMT_OFFSET_SEC             3600 // GMT+1 (adjust for your timezone)
 #define DAYLIGHT_OFFSET_SEC        3600 // Daylight saving time offset
@@ -61,12 +65,13 @@ typedef struct
 // ###########################################################################
 static void prv_networktime_task(void* parameter);
 static void prv_networktime_init(void);
-static void prv_networktime_run(void);
+static u32 prv_networktime_run(void);
+static void prv_wifi_event_callback(arduino_event_id_t event);
 static void prv_load_wifi_credentials_from_flash(void);
 static void prv_save_wifi_credentials_to_flash(void);
 static bool prv_connect_to_wifi(void);
 static void prv_sync_time_with_ntp(void);
-static void prv_msg_broker_callback(const msg_t* const message);
+static void prv_start_sync_timer(void);
 
 // ###########################################################################
 // # Private variables
@@ -77,7 +82,8 @@ static bool g_wifi_connected = false;
 static bool g_time_synchronized = false;
 static bool prv_logging_enabled = false;
 static Preferences prv_preferences;
-static unsigned long last_sync_time = 0;
+static bool g_is_sync_due = false; // Set by TIMER_ID_TIME_SYNC, cleared by a successful sync
+static msg_queue_t* prv_msg_queue = NULL;
 
 // ###########################################################################
 // # Public function implementations
@@ -87,13 +93,28 @@ TaskHandle_t networktime_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_networktime_task, // Task function
-                "NetworkTimeTask",    // Task name
-                4096,                 // Stack size (words)
-                NULL,                 // Task parameters
-                2,                    // Task priority
-                &task_handle          // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[NETWORKTIME_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_networktime_task,   // Task function
+                                    "NetworkTimeTask",      // Task name
+                                    NETWORKTIME_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                   // Task parameters
+                                    2,                      // Task priority
+                                    task_stack,             // Task stack
+                                    &task_buffer            // Task control block
     );
+#else
+    xTaskCreate(prv_networktime_task,   // Task function
+                "NetworkTimeTask",      // Task name
+                NETWORKTIME_STACK_SIZE, // Stack size (bytes)
+                NULL,                   // Task parameters
+                2,                      // Task priority
+                &task_handle            // Task handle
+    );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
@@ -159,6 +180,12 @@ void networktime_set_wifi_credentials(const char* ssid, const char* password)
     {
         prv_sync_time_with_ntp();
     }
+
+    // The task sleeps without credentials, let it take over the connection
+    if (prv_msg_queue != NULL)
+    {
+        messagebroker_queue_notify(prv_msg_queue);
+    }
 }
 
 bool networktime_get_wifi_credentials(char* ssid, char* password)
@@ -191,8 +218,10 @@ static void prv_networktime_task(void* parameter)
 
     while (1)
     {
-        prv_networktime_run();
-        delay(1000); // Check every second
+        u32 next_run_ms = prv_networktime_run();
+
+        // Sleep until a message, a WiFi event or the next sync or reconnect attempt
+        messagebroker_queue_process(prv_msg_queue, next_run_ms);
     }
 }
 
@@ -201,12 +230,23 @@ static void prv_networktime_init(void)
     // Load WiFi credentials from flash
     prv_load_wifi_credentials_from_flash();
 
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
     // Subscribe to logging control messages
-    messagebroker_subscribe(MSG_0006, prv_msg_broker_callback); // Enable/Disable Logging
-    messagebroker_subscribe(MSG_5001, prv_msg_broker_callback); // Set WiFi Credentials
-    messagebroker_subscribe(MSG_5002, prv_msg_broker_callback); // Get WiFi Credentials
-    messagebroker_subscribe(MSG_5003, prv_msg_broker_callback); // Get WiFi Status
-    messagebroker_subscribe(MSG_5004, prv_msg_broker_callback); // Get Time Info
+    messagebroker_subscribe_queued(MSG_0006, networktime_msg_broker_callback, prv_msg_queue); // Enable/Disable Logging
+    messagebroker_subscribe_queued(MSG_5001, networktime_msg_broker_callback, prv_msg_queue); // Set WiFi Credentials
+    messagebroker_subscribe_queued(MSG_5002, networktime_msg_broker_callback, prv_msg_queue); // Get WiFi Credentials
+    messagebroker_subscribe_queued(MSG_5003, networktime_msg_broker_callback, prv_msg_queue); // Get WiFi Status
+    messagebroker_subscribe_queued(MSG_5004, networktime_msg_broker_callback, prv_msg_queue); // Get Time Info
+    messagebroker_subscribe_queued(MSG_3006, networktime_msg_broker_callback, prv_msg_queue); // Timer Expired
+
+    // First periodic sync an hour after boot, a successful sync restarts the timer
+    prv_start_sync_timer();
+
+    // Connection changes wake the task, it does not poll the WiFi status
+    WiFi.onEvent(prv_wifi_event_callback, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(prv_wifi_event_callback, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
 
     // Try to connect to WiFi if credentials exist
     if (g_wifi_credentials.credentials_exist)
@@ -222,44 +262,63 @@ static void prv_networktime_init(void)
     }
 }
 
-static void prv_networktime_run(void)
+// Returns the time in ms until the task has to run again without being woken
+static u32 prv_networktime_run(void)
 {
+    // Nothing to do until credentials are set, networktime_set_wifi_credentials() wakes the task
+    if (!g_wifi_credentials.credentials_exist)
+    {
+        return MESSAGEBROKER_WAIT_FOREVER;
+    }
+
     // Check WiFi connection status
-    if (g_wifi_credentials.credentials_exist)
+    if (WiFi.status() != WL_CONNECTED)
     {
-        if (WiFi.status() == WL_CONNECTED)
+        if (g_wifi_connected)
         {
-            if (!g_wifi_connected)
+            g_wifi_connected = false;
+            g_time_synchronized = false;
+            if (prv_logging_enabled)
             {
-                g_wifi_connected = true;
-                if (prv_logging_enabled)
-                {
-                    Serial.println("[NetTime] WiFi connected");
-                }
-            }
-
-            // Periodic time sync
-            if (millis() - last_sync_time > TIME_SYNC_INTERVAL_MS)
-            {
-                prv_sync_time_with_ntp();
+                Serial.println("[NetTime] WiFi disconnected, attempting reconnect...");
             }
         }
-        else
-        {
-            if (g_wifi_connected)
-            {
-                g_wifi_connected = false;
-                g_time_synchronized = false;
-                if (prv_logging_enabled)
-                {
-                    Serial.println("[NetTime] WiFi disconnected, attempting reconnect...");
-                }
-            }
 
-            // Try to reconnect
-            prv_connect_to_wifi();
+        // Try to reconnect
+        prv_connect_to_wifi();
+        return WIFI_RETRY_INTERVAL_MS;
+    }
+
+    if (!g_wifi_connected)
+    {
+        g_wifi_connected = true;
+        if (prv_logging_enabled)
+        {
+            Serial.println("[NetTime] WiFi connected");
         }
     }
+
+    // Periodic time sync
+    if (g_is_sync_due)
+    {
+        prv_sync_time_with_ntp();
+    }
+
+    // A failed sync is retried, otherwise the sync timer or a disconnect (prv_wifi_event_callback()) wake the task
+    return g_is_sync_due ? WIFI_RETRY_INTERVAL_MS : MESSAGEBROKER_WAIT_FOREVER;
+}
+
+static void prv_start_sync_timer(void)
+{
+    msg_timer_start_t sync_timer = {TIMER_ID_TIME_SYNC, TIME_SYNC_INTERVAL_MS, 0};
+    msg::publish<MSG_3004>(sync_timer); // Start Timer
+}
+
+static void prv_wifi_event_callback(arduino_event_id_t event)
+{
+    // Runs in the WiFi event task, the connection is handled by prv_networktime_run()
+    (void)event;
+    messagebroker_queue_notify(prv_msg_queue);
 }
 
 static void prv_load_wifi_credentials_from_flash(void)
@@ -321,8 +380,8 @@ static bool prv_connect_to_wifi(void)
     WiFi.mode(WIFI_STA);
     WiFi.begin(g_wifi_credentials.ssid, g_wifi_credentials.password);
 
-    unsigned long start_time = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - start_time) < WIFI_CONNECTION_TIMEOUT_MS)
+    u64 start_time = monotonic_time_get_ms();
+    while (WiFi.status() != WL_CONNECTED && (monotonic_time_get_ms() - start_time) < WIFI_CONNECTION_TIMEOUT_MS)
     {
         delay(500);
         Serial.print(".");
@@ -376,7 +435,8 @@ static void prv_sync_time_with_ntp(void)
         Serial.print("[NetTime] Current time: ");
         Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
         g_time_synchronized = true;
-        last_sync_time = millis();
+        g_is_sync_due = false;
+        prv_start_sync_timer();
     }
     else
     {
@@ -386,19 +446,16 @@ static void prv_sync_time_with_ntp(void)
     }
 }
 
-static void prv_msg_broker_callback(const msg_t* const message)
+void networktime_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
     switch (message->msg_id)
     {
         case MSG_0006: // Set Logging State
-            if (message->data_size == sizeof(bool))
-            {
-                prv_logging_enabled = *(bool*)(message->data_bytes);
-                Serial.print("[NetTime] Logging ");
-                Serial.println(prv_logging_enabled ? "enabled" : "disabled");
-            }
+            prv_logging_enabled = msg::payload<MSG_0006>(message);
+            Serial.print("[NetTime] Logging ");
+            Serial.println(prv_logging_enabled ? "enabled" : "disabled");
             break;
 
         case MSG_5001: // Set WiFi Credentials (should not be used directly, use console command)
@@ -419,44 +476,45 @@ static void prv_msg_broker_callback(const msg_t* const message)
             break;
 
         case MSG_5003: // Get WiFi Status
-            Serial.print("[NetTime] WiFi Status: ");
+        {
+            msg_wifi_status_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+            reply.is_connected = g_wifi_connected;
             if (g_wifi_connected)
             {
-                Serial.print("Connected to ");
-                Serial.print(g_wifi_credentials.ssid);
-                Serial.print(" (IP: ");
-                Serial.print(WiFi.localIP());
-                Serial.println(")");
-            }
-            else
-            {
-                Serial.println("Disconnected");
+                IPAddress ip = WiFi.localIP();
+                reply.ip_address = (u32)ip[0] | ((u32)ip[1] << 8) | ((u32)ip[2] << 16) | ((u32)ip[3] << 24);
+                strncpy(reply.ssid, g_wifi_credentials.ssid, sizeof(reply.ssid) - 1);
             }
-            break;
+            msg::reply<MSG_5003>(message, reply);
+        }
+        break;
 
         case MSG_5004: // Get Time Info
-            if (g_time_synchronized)
+        {
+            msg_time_info_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+
+            struct tm timeinfo;
+            if (g_time_synchronized && getLocalTime(&timeinfo))
             {
-                struct tm timeinfo;
-                if (getLocalTime(&timeinfo))
-                {
-                    Serial.print("[NetTime] Current time: ");
-                    Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
-                    Serial.print("[NetTime] Hour: ");
-                    Serial.print(timeinfo.tm_hour);
-                    Serial.print(", Weekday: ");
-                    const char* weekdays[] = {"Sunday",   "Monday", "Tuesday", "Wednesday",
-                                              "Thursday", "Friday", "Saturday"};
-                    Serial.println(weekdays[timeinfo.tm_wday]);
-                }
-                else
-                {
-                    Serial.println("[NetTime] Failed to get local time");
-                }
+                reply.is_synchronized = true;
+                reply.year = (u16)(timeinfo.tm_year + 1900);
+                reply.month = (u8)(timeinfo.tm_mon + 1);
+                reply.day = (u8)timeinfo.tm_mday;
+                reply.weekday = (u8)timeinfo.tm_wday;
+                reply.hour = (u8)timeinfo.tm_hour;
+                reply.minute = (u8)timeinfo.tm_min;
+                reply.second = (u8)timeinfo.tm_sec;
             }
-            else
+            msg::reply<MSG_5004>(message, reply);
+        }
+        break;
+
+        case MSG_3006: // Timer Expired
+            if (msg::payload<MSG_3006>(message) == TIMER_ID_TIME_SYNC)
             {
-                Serial.println("[NetTime] Time not synchronized");
+                g_is_sync_due = true;
             }
             break;
 
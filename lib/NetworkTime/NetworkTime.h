@@ -6,6 +6,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define NETWORKTIME_STACK_SIZE 4096 // Task stack in bytes
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -3,9 +3,14 @@
 #include <NimBLEDevice.h>
 #include <Preferences.h>
 #include <vector>
+#include "Executor.h"
 #include "MessageBroker.h"
+#include "MessageDefinitions.h"
+#include "MessageSchema.h"
 #include "custom_assert.h"
 #include "custom_types.h"
+#include "rtos_alloc.h"
+#include "test_support.h"
 
 // ###########################################################################
 // # Internal Configuration
@@ -37,8 +42,9 @@ static bool is_initialized = false;
 static bool scan_started = false;
 static NimBLEScan* pBLEScan = nullptr;
 static bool is_logging_enabled = false;
-static unsigned long last_scan_time = 0;
+static bool is_scan_due = false; // Set by TIMER_ID_PRESENCE_SCAN
 static Preferences prv_preferences; // Preferences object for NVS storage
+static msg_queue_t* prv_msg_queue = NULL;
 
 // Presence detection state
 static bool presence_detected = false;
@@ -60,9 +66,8 @@ struct DeviceInfo
 // ###########################################################################
 
 static void prv_presencedetector_task(void* parameter);
-static void prv_presencedetector_init(void);
-static void prv_presencedetector_run(void);
-static void prv_msg_broker_callback(const msg_t* const message);
+STATIC void prv_presencedetector_init(void);
+STATIC u32 prv_presencedetector_run(void);
 static float prv_estimate_distance(int rssi);
 static std::vector<DeviceInfo> prv_create_device_list(const NimBLEScanResults& results);
 static int prv_count_close_devices(const std::vector<DeviceInfo>& devices);
@@ -82,17 +87,38 @@ TaskHandle_t presencedetector_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_presencedetector_task, // Task function
-                "PresenceDetectorTask",    // Task name
-                8192,                      // Stack size (words) - increased for BLE
-                NULL,                      // Task parameters
-                1,                         // Task priority
-                &task_handle               // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[PRESENCEDETECTOR_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_presencedetector_task,   // Task function
+                                    "PresenceDetectorTask",      // Task name
+                                    PRESENCEDETECTOR_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                        // Task parameters
+                                    1,                           // Task priority
+                                    task_stack,                  // Task stack
+                                    &task_buffer                 // Task control block
     );
+#else
+    xTaskCreate(prv_presencedetector_task,   // Task function
+                "PresenceDetectorTask",      // Task name
+                PRESENCEDETECTOR_STACK_SIZE, // Stack size (bytes)
+                NULL,                        // Task parameters
+                1,                           // Task priority
+                &task_handle                 // Task handle
+    );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
 
+void presencedetector_add_to_executor(void)
+{
+    static const executor_module_t module = {"PresenceDetector", prv_presencedetector_init, prv_presencedetector_run};
+    executor_register(&module);
+}
+
 // ###########################################################################
 // # Private Function Implementations
 // ###########################################################################
@@ -108,13 +134,14 @@ static void prv_presencedetector_task(void* parameter)
     while (1)
     {
         // Run the presence detector processing
-        prv_presencedetector_run();
+        u32 next_run_ms = prv_presencedetector_run();
 
-        delay(5);
+        // Sleep until a message or the scan timer arrives
+        messagebroker_queue_process(prv_msg_queue, next_run_ms);
     }
 }
 
-static void prv_presencedetector_init(void)
+STATIC void prv_presencedetector_init(void)
 {
     ASSERT(!is_initialized);
 
@@ -130,14 +157,20 @@ static void prv_presencedetector_init(void)
     pBLEScan->setInterval(100);    // Scan interval in ms
     pBLEScan->setWindow(99);       // Scan window in ms
 
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
     // Subscribe to logging control messages
-    messagebroker_subscribe(MSG_0005, prv_msg_broker_callback);
+    messagebroker_subscribe_queued(MSG_0005, presencedetector_msg_broker_callback, prv_msg_queue);
 
     // Subscribe to presence threshold setting message
-    messagebroker_subscribe(MSG_2003, prv_msg_broker_callback);
+    messagebroker_subscribe_queued(MSG_2003, presencedetector_msg_broker_callback, prv_msg_queue);
 
     // Subscribe to presence threshold query message
-    messagebroker_subscribe(MSG_2004, prv_msg_broker_callback);
+    messagebroker_subscribe_queued(MSG_2004, presencedetector_msg_broker_callback, prv_msg_queue);
+
+    // Subscribe to the timer service, which tells when the scan results are due
+    messagebroker_subscribe_queued(MSG_3006, presencedetector_msg_broker_callback, prv_msg_queue);
 
     // Don't start scanning immediately - do it in run() to avoid blocking during init
     scan_started = false;
@@ -145,7 +178,8 @@ static void prv_presencedetector_init(void)
     is_initialized = true;
 }
 
-static void prv_presencedetector_run(void)
+// The scan results are evaluated on the events of the scan timer, the task never has to wake up on its own
+STATIC u32 prv_presencedetector_run(void)
 {
     ASSERT(is_initialized);
 
@@ -154,59 +188,68 @@ static void prv_presencedetector_run(void)
     {
         pBLEScan->start(0, false, false); // 0 = continuous scan, no callback, don't restart
         scan_started = true;
-        last_scan_time = millis();
-        return; // Skip first iteration to let scan stabilize
+
+        // The first interval lets the scan stabilize
+        msg_timer_start_t scan_timer = {TIMER_ID_PRESENCE_SCAN, SCAN_INTERVAL_MS, SCAN_INTERVAL_MS};
+        msg::publish<MSG_3004>(scan_timer); // Start Timer
+        return MESSAGEBROKER_WAIT_FOREVER;
     }
 
     // Process scan results at regular intervals
-    unsigned long current_time = millis();
-    if (current_time - last_scan_time >= SCAN_INTERVAL_MS)
+    if (is_scan_due)
     {
-        last_scan_time = current_time;
+        is_scan_due = false;
         prv_process_scan_results();
     }
+
+    return MESSAGEBROKER_WAIT_FOREVER;
 }
 
 // ###########################################################################
 // # Private Function Implementations
 // ###########################################################################
 
-static void prv_msg_broker_callback(const msg_t* const message)
+void presencedetector_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
     switch (message->msg_id)
     {
         case MSG_0005: // Set Logging State
-            if (message->data_size == sizeof(bool))
-            {
-                is_logging_enabled = *(bool*)(message->data_bytes);
-                Serial.print("[PresenceDetect] Logging ");
-                Serial.println(is_logging_enabled ? "enabled" : "disabled");
-            }
+            is_logging_enabled = msg::payload<MSG_0005>(message);
+            Serial.print("[PresenceDetect] Logging ");
+            Serial.println(is_logging_enabled ? "enabled" : "disabled");
             break;
         case MSG_2003: // Set Presence Threshold
-            if (message->data_size == sizeof(int))
+        {
+            s32 new_threshold = msg::payload<MSG_2003>(message);
+            if (new_threshold > 0)
             {
-                int new_threshold = *(int*)(message->data_bytes);
-                if (new_threshold > 0)
-                {
-                    presence_threshold = new_threshold;
-                    prv_save_threshold_to_flash(); // Save to flash
-                    Serial.print("[PresenceDetect] Threshold set to ");
-                    Serial.print(presence_threshold);
-                    Serial.println(" devices");
-                }
-                else
-                {
-                    Serial.println("[PresenceDetect] Invalid threshold value (must be > 0)");
-                }
+                presence_threshold = new_threshold;
+                prv_save_threshold_to_flash(); // Save to flash
+                Serial.print("[PresenceDetect] Threshold set to ");
+                Serial.print(presence_threshold);
+                Serial.println(" devices");
             }
-            break;
+            else
+            {
+                Serial.println("[PresenceDetect] Invalid threshold value (must be > 0)");
+            }
+        }
+        break;
         case MSG_2004: // Get Presence Threshold
-            Serial.print("[PresenceDetect] Current threshold: ");
-            Serial.print(presence_threshold);
-            Serial.println(" devices");
+        {
+            msg_presence_threshold_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+            reply.threshold = presence_threshold;
+            msg::reply<MSG_2004>(message, reply);
+        }
+        break;
+        case MSG_3006: // Timer Expired
+            if (msg::payload<MSG_3006>(message) == TIMER_ID_PRESENCE_SCAN)
+            {
+                is_scan_due = true;
+            }
             break;
         default:
             // Unknown message ID
@@ -330,13 +373,8 @@ static void prv_check_and_publish_presence_state(int close_device_count)
     // Only publish if state changed or if logging is enabled
     if (state_changed || is_logging_enabled)
     {
-        msg_t presence_msg;
-        presence_msg.data_size = 0;
-        presence_msg.data_bytes = NULL;
-
         if (presence_detected)
         {
-            presence_msg.msg_id = MSG_2001; // Presence Detected
             if (is_logging_enabled)
             {
                 Serial.print("[PresenceDetect] Person ");
@@ -350,7 +388,6 @@ static void prv_check_and_publish_presence_state(int close_device_count)
         }
         else
         {
-            presence_msg.msg_id = MSG_2002; // No Presence Detected
             if (is_logging_enabled)
             {
                 Serial.print("[PresenceDetect] Person ");
@@ -363,9 +400,13 @@ static void prv_check_and_publish_presence_state(int close_device_count)
             }
         }
 
-        if (state_changed)
+        if (state_changed && presence_detected)
+        {
+            msg::publish<MSG_2001>(); // Presence Detected
+        }
+        else if (state_changed)
         {
-            messagebroker_publish(&presence_msg);
+            msg::publish<MSG_2002>(); // No Presence Detected
         }
     }
 }
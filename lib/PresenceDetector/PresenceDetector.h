@@ -5,6 +5,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define PRESENCEDETECTOR_STACK_SIZE 8192 // Task stack in bytes, increased for BLE
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -16,6 +18,12 @@ extern "C"
      */
     TaskHandle_t presencedetector_create_task(void);
 
+    /**
+     * @brief Registers the PresenceDetector with the cooperative executor
+     *        (EXECUTOR_COOPERATIVE), instead of creating its task
+     */
+    void presencedetector_add_to_executor(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,124 @@
+#include "StackMonitor.h"
+#include <Arduino.h>
+#include "custom_assert.h"
+#include "monotonic_time.h"
+#include "rtos_alloc.h"
+#include "freertos/timers.h"
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+static void prv_sample_timer_callback(TimerHandle_t timer);
+static u32 prv_get_suggested_size(u32 max_used);
+
+// ###########################################################################
+// # Private variables
+// ###########################################################################
+
+// The timer service task writes the u32 fields, readers may see a sample one period late
+static stackmonitor_task_stats_t prv_tasks[STACKMONITOR_MAX_TASKS];
+static u8 prv_nof_tasks = 0;
+static TimerHandle_t prv_sample_timer = NULL;
+
+// ###########################################################################
+// # Public function implementations
+// ###########################################################################
+
+void stackmonitor_add_task(TaskHandle_t task_handle, u32 stack_size)
+{
+    ASSERT(prv_sample_timer == NULL);
+    ASSERT(stack_size > 0);
+
+    if (task_handle == NULL)
+    {
+        return;
+    }
+
+    ASSERT(prv_nof_tasks < STACKMONITOR_MAX_TASKS); // Increase STACKMONITOR_MAX_TASKS
+
+    stackmonitor_task_stats_t* task = &prv_tasks[prv_nof_tasks++];
+    task->task_handle = task_handle;
+    task->stack_size = stack_size;
+    task->max_used = 0;
+    task->suggested_size = 0;
+    task->last_increase_ms = 0;
+    task->nof_samples = 0;
+}
+
+void stackmonitor_start(void)
+{
+    ASSERT(prv_sample_timer == NULL);
+
+#if RTOS_STATIC_ALLOCATION
+    static StaticTimer_t sample_timer_buffer;
+    prv_sample_timer = xTimerCreateStatic("StackMonitor",                         // Timer name
+                                          pdMS_TO_TICKS(STACKMONITOR_PERIOD_MS), // Sampling period
+                                          pdTRUE,                                // Auto-reload
+                                          NULL,                                  // Timer ID
+                                          prv_sample_timer_callback,             // Callback function
+                                          &sample_timer_buffer                   // Timer control block
+    );
+#else
+    prv_sample_timer = xTimerCreate("StackMonitor",                         // Timer name
+                                    pdMS_TO_TICKS(STACKMONITOR_PERIOD_MS), // Sampling period
+                                    pdTRUE,                                // Auto-reload
+                                    NULL,                                  // Timer ID
+                                    prv_sample_timer_callback              // Callback function
+    );
+#endif
+    ASSERT(prv_sample_timer != NULL); // Not enough memory to create timer
+
+    stackmonitor_sample();
+
+    BaseType_t status = xTimerStart(prv_sample_timer, 0);
+    ASSERT(status == pdPASS);
+}
+
+void stackmonitor_sample(void)
+{
+    for (u8 i = 0; i < prv_nof_tasks; i++)
+    {
+        stackmonitor_task_stats_t* task = &prv_tasks[i];
+
+        // Minimum free stack since the task started, in bytes on ESP-IDF
+        u32 min_free = (u32)uxTaskGetStackHighWaterMark(task->task_handle);
+        u32 used = (min_free < task->stack_size) ? (task->stack_size - min_free) : 0;
+
+        if (used > task->max_used)
+        {
+            task->max_used = used;
+            task->suggested_size = prv_get_suggested_size(used);
+            task->last_increase_ms = monotonic_time_get_ms();
+        }
+        task->nof_samples++;
+    }
+}
+
+u8 stackmonitor_get_nof_tasks(void) { return prv_nof_tasks; }
+
+void stackmonitor_get_task_stats(u8 index, stackmonitor_task_stats_t* stats)
+{
+    ASSERT(index < prv_nof_tasks);
+    ASSERT(stats != NULL);
+
+    *stats = prv_tasks[index];
+}
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+
+static void prv_sample_timer_callback(TimerHandle_t timer)
+{
+    ASSERT(timer == prv_sample_timer);
+    stackmonitor_sample();
+}
+
+static u32 prv_get_suggested_size(u32 max_used)
+{
+    u32 headroom = (max_used * STACKMONITOR_MARGIN_PERCENT) / 100U;
+    headroom = (headroom < STACKMONITOR_MIN_HEADROOM) ? STACKMONITOR_MIN_HEADROOM : headroom;
+
+    u32 size = max_used + headroom;
+    return ((size + STACKMONITOR_GRANULARITY - 1U) / STACKMONITOR_GRANULARITY) * STACKMONITOR_GRANULARITY;
+}
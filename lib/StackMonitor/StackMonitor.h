@@ -0,0 +1,77 @@
+#ifndef STACKMONITOR_H
+#define STACKMONITOR_H
+
+#include "custom_types.h"
+
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Tasks that can be monitored
+#ifndef STACKMONITOR_MAX_TASKS
+#define STACKMONITOR_MAX_TASKS 10U
+#endif
+
+// Sampling period of the high-water marks
+#ifndef STACKMONITOR_PERIOD_MS
+#define STACKMONITOR_PERIOD_MS 10000U
+#endif
+
+// Suggested stack = worst case use + STACKMONITOR_MARGIN_PERCENT, at least STACKMONITOR_MIN_HEADROOM bytes more,
+// rounded up to STACKMONITOR_GRANULARITY. The worst case so far is not the worst case there is: run every
+// command and every error path (no WiFi, desk not connected, ...) before taking the suggestion.
+#define STACKMONITOR_MARGIN_PERCENT 25U
+#define STACKMONITOR_MIN_HEADROOM   512U
+#define STACKMONITOR_GRANULARITY    256U
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    typedef struct
+    {
+        TaskHandle_t task_handle;
+        u32 stack_size;        // As passed to xTaskCreate, in bytes
+        u32 max_used;          // Worst case stack use seen so far, in bytes
+        u32 suggested_size;    // Stack size with margin for the worst case, see STACKMONITOR_MARGIN_PERCENT
+        u64 last_increase_ms;  // Uptime when max_used last grew
+        u32 nof_samples;
+    } stackmonitor_task_stats_t;
+
+    /**
+     * @brief Adds a task to the monitor, call before stackmonitor_start()
+     * @param task_handle Task to watch, NULL is ignored (a task of the mode that is not used)
+     * @param stack_size Stack size passed to xTaskCreate, in bytes
+     */
+    void stackmonitor_add_task(TaskHandle_t task_handle, u32 stack_size);
+
+    /**
+     * @brief Starts sampling the high-water marks every STACKMONITOR_PERIOD_MS
+     *
+     * Runs in the FreeRTOS timer service task, one sample walks the unused part of every
+     * monitored stack.
+     */
+    void stackmonitor_start(void);
+
+    /**
+     * @brief Samples all monitored tasks right away, e.g. before a report
+     */
+    void stackmonitor_sample(void);
+
+    /**
+     * @brief Get the number of monitored tasks
+     */
+    u8 stackmonitor_get_nof_tasks(void);
+
+    /**
+     * @brief Get the worst case use and the suggested stack size of a task
+     * @param index 0 .. stackmonitor_get_nof_tasks() - 1, in the order of stackmonitor_add_task()
+     */
+    void stackmonitor_get_task_stats(u8 index, stackmonitor_task_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // STACKMONITOR_H
@@ -0,0 +1,163 @@
+#include "TaskProfiler.h"
+#include <Arduino.h>
+#include "MessageBroker.h"
+#include "custom_assert.h"
+#include "monotonic_time.h"
+
+// ###########################################################################
+// # Private types
+// ###########################################################################
+typedef struct
+{
+    TaskHandle_t task_handle;
+    u32 run_time;
+    u32 nof_wakeups;
+} taskprofiler_counters_t;
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+#if TASKPROFILER_AVAILABLE
+static u32 prv_get_nof_wakeups(TaskHandle_t task_handle);
+static const taskprofiler_counters_t* prv_find_previous(TaskHandle_t task_handle);
+static void prv_sort_by_run_time(void);
+#endif
+
+// ###########################################################################
+// # Private variables
+// ###########################################################################
+
+#if TASKPROFILER_AVAILABLE
+// Static, the sample runs on the console stack and a TaskStatus_t takes 40 bytes
+static TaskStatus_t prv_task_status[TASKPROFILER_MAX_TASKS];
+static taskprofiler_counters_t prv_previous[TASKPROFILER_MAX_TASKS];
+static u8 prv_nof_previous = 0;
+static u32 prv_previous_total_run_time = 0;
+#endif
+
+static taskprofiler_task_stats_t prv_stats[TASKPROFILER_MAX_TASKS];
+static u8 prv_nof_stats = 0;
+static u32 prv_interval = 0;
+static u32 prv_sample_duration_us = 0;
+
+// ###########################################################################
+// # Public function implementations
+// ###########################################################################
+
+u8 taskprofiler_sample(void)
+{
+#if TASKPROFILER_AVAILABLE
+    u64 start_us = monotonic_time_get_us();
+
+    // Suspends the scheduler while it copies the task list
+    u32 total_run_time = 0;
+    UBaseType_t nof_tasks = uxTaskGetSystemState(prv_task_status, TASKPROFILER_MAX_TASKS, &total_run_time);
+    ASSERT(nof_tasks > 0); // Increase TASKPROFILER_MAX_TASKS
+
+    // Unsigned differences stay right across one wrap of the counters
+    prv_interval = total_run_time - prv_previous_total_run_time;
+    u64 capacity = (u64)prv_interval * portNUM_PROCESSORS;
+    u32 nof_wakeups[TASKPROFILER_MAX_TASKS];
+
+    for (u8 i = 0; i < nof_tasks; i++)
+    {
+        const TaskStatus_t* status = &prv_task_status[i];
+        const taskprofiler_counters_t* previous = prv_find_previous(status->xHandle);
+        taskprofiler_task_stats_t* stats = &prv_stats[i];
+        nof_wakeups[i] = prv_get_nof_wakeups(status->xHandle);
+
+        stats->task_handle = status->xHandle;
+        stats->name = status->pcTaskName;
+        stats->state = status->eCurrentState;
+        stats->priority = status->uxCurrentPriority;
+
+        // A task created since the previous sample started from 0
+        stats->run_time = status->ulRunTimeCounter - ((previous != NULL) ? previous->run_time : 0U);
+        stats->cpu_permille = (capacity > 0) ? (u32)(((u64)stats->run_time * 1000ULL) / capacity) : 0U;
+        stats->nof_wakeups = nof_wakeups[i];
+        if ((nof_wakeups[i] != TASKPROFILER_NO_WAKEUPS) && (previous != NULL))
+        {
+            stats->nof_wakeups = nof_wakeups[i] - previous->nof_wakeups;
+        }
+    }
+
+    // Deleted tasks drop out here
+    for (u8 i = 0; i < nof_tasks; i++)
+    {
+        prv_previous[i].task_handle = prv_task_status[i].xHandle;
+        prv_previous[i].run_time = prv_task_status[i].ulRunTimeCounter;
+        prv_previous[i].nof_wakeups = nof_wakeups[i];
+    }
+    prv_nof_previous = (u8)nof_tasks;
+    prv_previous_total_run_time = total_run_time;
+    prv_nof_stats = (u8)nof_tasks;
+
+    prv_sort_by_run_time();
+
+    prv_sample_duration_us = (u32)(monotonic_time_get_us() - start_us);
+    return prv_nof_stats;
+#else
+    return 0;
+#endif
+}
+
+void taskprofiler_get_task_stats(u8 index, taskprofiler_task_stats_t* stats)
+{
+    ASSERT(index < prv_nof_stats);
+    ASSERT(stats != NULL);
+
+    *stats = prv_stats[index];
+}
+
+u32 taskprofiler_get_interval(void) { return prv_interval; }
+
+u32 taskprofiler_get_sample_duration_us(void) { return prv_sample_duration_us; }
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+
+#if TASKPROFILER_AVAILABLE
+static u32 prv_get_nof_wakeups(TaskHandle_t task_handle)
+{
+    // A queue belongs to the task that created it, the executor task owns the shared one
+    for (u16 i = 0; i < messagebroker_get_nof_queues(); i++)
+    {
+        msg_queue_stats_t queue_stats;
+        messagebroker_get_queue_stats(i, &queue_stats);
+        if (queue_stats.owner == (void*)task_handle)
+        {
+            return queue_stats.nof_wakeups;
+        }
+    }
+    return TASKPROFILER_NO_WAKEUPS;
+}
+
+static const taskprofiler_counters_t* prv_find_previous(TaskHandle_t task_handle)
+{
+    for (u8 i = 0; i < prv_nof_previous; i++)
+    {
+        if (prv_previous[i].task_handle == task_handle)
+        {
+            return &prv_previous[i];
+        }
+    }
+    return NULL;
+}
+
+static void prv_sort_by_run_time(void)
+{
+    // Insertion sort, a few dozen tasks at most
+    for (u8 i = 1; i < prv_nof_stats; i++)
+    {
+        taskprofiler_task_stats_t stats = prv_stats[i];
+        u8 j = i;
+        while ((j > 0) && (prv_stats[j - 1].run_time < stats.run_time))
+        {
+            prv_stats[j] = prv_stats[j - 1];
+            j--;
+        }
+        prv_stats[j] = stats;
+    }
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef TASKPROFILER_H
+#define TASKPROFILER_H
+
+#include "custom_types.h"
+
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Tasks that fit in one sample, ESP-IDF runs about ten tasks of its own (idle, timers, BLE, WiFi, ...)
+#ifndef TASKPROFILER_MAX_TASKS
+#define TASKPROFILER_MAX_TASKS 24U
+#endif
+
+// The run time counters of FreeRTOS (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, on by default in arduino-esp32)
+#if (configGENERATE_RUN_TIME_STATS == 1) && (configUSE_TRACE_FACILITY == 1)
+#define TASKPROFILER_AVAILABLE 1
+#else
+#define TASKPROFILER_AVAILABLE 0
+#endif
+
+#define TASKPROFILER_NO_WAKEUPS 0xFFFFFFFFU // Task without a message broker queue
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    typedef struct
+    {
+        TaskHandle_t task_handle;
+        const char* name;
+        eTaskState state;
+        u32 priority;
+        u32 run_time;     // Run time counter ticks in the interval (us on ESP-IDF)
+        u32 cpu_permille; // Share of all cores in the interval, 1000 = every core busy for the whole interval
+        u32 nof_wakeups;  // Returns from messagebroker_queue_process() in the interval, or TASKPROFILER_NO_WAKEUPS
+    } taskprofiler_task_stats_t;
+
+    /**
+     * @brief Samples the run time counters of all tasks and computes their CPU use since the previous sample
+     *
+     * Nothing runs between two samples: the counters are kept by the scheduler (one timer read per
+     * context switch), a sample copies them once. The first sample covers the time since boot.
+     * The 32 bit counters of ESP-IDF count us and wrap after 71 minutes, sample more often than that.
+     * Call from one task only.
+     * @return Number of tasks in the sample, sorted by CPU use, 0 if the run time counters are disabled
+     */
+    u8 taskprofiler_sample(void);
+
+    /**
+     * @brief Get the CPU use of a task in the last sample
+     * @param index 0 .. taskprofiler_sample() - 1, the busiest task first
+     */
+    void taskprofiler_get_task_stats(u8 index, taskprofiler_task_stats_t* stats);
+
+    /**
+     * @brief Get the length of the interval of the last sample, in run time counter ticks (us on ESP-IDF)
+     */
+    u32 taskprofiler_get_interval(void);
+
+    /**
+     * @brief Get how long the last sample took, in us
+     */
+    u32 taskprofiler_get_sample_duration_us(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // TASKPROFILER_H
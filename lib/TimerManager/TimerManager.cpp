@@ -1,28 +1,42 @@
 #include "TimerManager.h"
 #include <Arduino.h>
+#include "Executor.h"
 #include "MessageBroker.h"
 #include "MessageDefinitions.h"
+#include "MessageSchema.h"
+#include "TimingWheel.h"
 #include "custom_assert.h"
 #include "custom_types.h"
+#include "rtos_alloc.h"
+#include "test_support.h"
 
 // ###########################################################################
 // # Internal Configuration
 // ###########################################################################
 
+static_assert(TIMER_ID_LAST <= TIMINGWHEEL_MAX_TIMERS, "Increase TIMINGWHEEL_MAX_TIMERS");
+
 // ###########################################################################
 // # Private function declarations
 // ###########################################################################
 static void prv_timermanager_task(void* parameter);
-static void prv_timermanager_init(void);
-static void prv_timermanager_run(void);
-static void prv_msg_broker_callback(const msg_t* const message);
-static void prv_timer_expired_callback(TimerHandle_t xTimer);
+STATIC void prv_timermanager_init(void);
+STATIC u32 prv_timermanager_run(void);
+static void prv_start_timer(timer_id_e timer_id, u32 delay_ms, u32 period_ms);
+static void prv_stop_timer(timer_id_e timer_id);
+static void prv_pause_timer(timer_id_e timer_id);
+static void prv_resume_timer(timer_id_e timer_id);
 
 // ###########################################################################
 // # Private variables
 // ###########################################################################
 
-static TimerHandle_t countdown_timer_handle = NULL;
+// All timers of the system, driven by the FreeRTOS tick
+static timingwheel_t prv_wheel;
+
+// Start and stop requests run in the task of the publisher (synchronous dispatch)
+static portMUX_TYPE prv_wheel_mux = portMUX_INITIALIZER_UNLOCKED;
+static msg_queue_t* prv_msg_queue = NULL;
 
 // ###########################################################################
 // # Public function implementations
@@ -32,17 +46,38 @@ TaskHandle_t timermanager_create_task(void)
 {
     TaskHandle_t task_handle = NULL;
 
-    xTaskCreate(prv_timermanager_task, // Task function
-                "TimerManagerTask",    // Task name
-                4096,                  // Stack size (words)
-                NULL,                  // Task parameters
-                2,                     // Task priority
-                &task_handle           // Task handle
+#if RTOS_STATIC_ALLOCATION
+    static StackType_t task_stack[TIMERMANAGER_STACK_SIZE / sizeof(StackType_t)];
+    static StaticTask_t task_buffer;
+
+    task_handle = xTaskCreateStatic(prv_timermanager_task,   // Task function
+                                    "TimerManagerTask",      // Task name
+                                    TIMERMANAGER_STACK_SIZE, // Stack size (bytes)
+                                    NULL,                    // Task parameters
+                                    2,                       // Task priority
+                                    task_stack,              // Task stack
+                                    &task_buffer             // Task control block
+    );
+#else
+    xTaskCreate(prv_timermanager_task,   // Task function
+                "TimerManagerTask",      // Task name
+                TIMERMANAGER_STACK_SIZE, // Stack size (bytes)
+                NULL,                    // Task parameters
+                2,                       // Task priority
+                &task_handle             // Task handle
     );
+#endif
+    ASSERT(task_handle != NULL); // Not enough memory to create task
 
     return task_handle;
 }
 
+void timermanager_add_to_executor(void)
+{
+    static const executor_module_t module = {"TimerManager", prv_timermanager_init, prv_timermanager_run};
+    executor_register(&module);
+}
+
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
@@ -57,40 +92,112 @@ static void prv_timermanager_task(void* parameter)
     // Task main loop
     while (1)
     {
-        // Run the timer manager processing
-        prv_timermanager_run();
+        // Publish the expired timers
+        u32 next_run_ms = prv_timermanager_run();
 
-        delay(10000000);
+        // Sleep until a start/stop request arrives or the next timer expires
+        messagebroker_queue_process(prv_msg_queue, next_run_ms);
     }
 }
 
-static void prv_timermanager_init(void)
+STATIC void prv_timermanager_init(void)
 {
+    timingwheel_init(&prv_wheel, xTaskGetTickCount());
+
+    // All message callbacks of this module are dispatched in the task that runs it
+    prv_msg_queue = messagebroker_queue_get_context_queue();
+
     // Subscribe to relevant messages
-    messagebroker_subscribe(MSG_3001, prv_msg_broker_callback); // Start Countdown with Time Stamp
-    messagebroker_subscribe(MSG_3002, prv_msg_broker_callback); // Stop Countdown
-
-    // Create the countdown timer (not started yet)
-    countdown_timer_handle =
-        xTimerCreate("CountdownTimer",          // Timer name
-                     pdMS_TO_TICKS(1000),       // Default timer period (1 second, will be changed when started)
-                     pdFALSE,                   // No auto-reload
-                     NULL,                      // Timer ID
-                     prv_timer_expired_callback // Callback function
-        );
-    ASSERT(countdown_timer_handle != NULL); // Not enough memory to create timer
+    messagebroker_subscribe_queued(MSG_3001, timermanager_msg_broker_callback, prv_msg_queue); // Start Countdown with Time Stamp
+    messagebroker_subscribe_queued(MSG_3002, timermanager_msg_broker_callback, prv_msg_queue); // Stop Countdown
+    messagebroker_subscribe_queued(MSG_3004, timermanager_msg_broker_callback, prv_msg_queue); // Start Timer
+    messagebroker_subscribe_queued(MSG_3005, timermanager_msg_broker_callback, prv_msg_queue); // Stop Timer
+    messagebroker_subscribe_queued(MSG_3007, timermanager_msg_broker_callback, prv_msg_queue); // Get Timers
+    messagebroker_subscribe_queued(MSG_3009, timermanager_msg_broker_callback, prv_msg_queue); // Pause Timer
+    messagebroker_subscribe_queued(MSG_3010, timermanager_msg_broker_callback, prv_msg_queue); // Resume Timer
 }
 
-static void prv_timermanager_run(void)
+// Returns the time in ms until the next timer expires
+STATIC u32 prv_timermanager_run(void)
 {
-    // Nothing to do in the run loop for now
+    TickType_t now_tick = xTaskGetTickCount();
+    u32 next_expiry_tick = 0;
+
+    portENTER_CRITICAL(&prv_wheel_mux);
+    u32 expired_mask = timingwheel_advance(&prv_wheel, now_tick);
+    bool is_pending = timingwheel_get_next_expiry(&prv_wheel, &next_expiry_tick);
+    portEXIT_CRITICAL(&prv_wheel_mux);
+
+    // Published outside of the critical section, the subscribers may start timers again
+    for (u8 timer_id = 0; timer_id < TIMER_ID_LAST; timer_id++)
+    {
+        if ((expired_mask & (1UL << timer_id)) == 0)
+        {
+            continue;
+        }
+
+        if (timer_id == TIMER_ID_COUNTDOWN)
+        {
+            msg::publish<MSG_3003>(); // Countdown finished
+        }
+        else
+        {
+            msg::publish<MSG_3006>((timer_id_e)timer_id); // Timer Expired
+        }
+    }
+
+    // A start request in the meantime wakes the task through its queue
+    return is_pending ? (u32)((next_expiry_tick - now_tick) * portTICK_PERIOD_MS) : MESSAGEBROKER_WAIT_FOREVER;
+}
+
+static void prv_start_timer(timer_id_e timer_id, u32 delay_ms, u32 period_ms)
+{
+    ASSERT(timer_id < TIMER_ID_LAST);
+
+    TickType_t expiry_tick = xTaskGetTickCount() + pdMS_TO_TICKS(delay_ms);
+
+    portENTER_CRITICAL(&prv_wheel_mux);
+    timingwheel_start(&prv_wheel, (u8)timer_id, expiry_tick, pdMS_TO_TICKS(period_ms));
+    portEXIT_CRITICAL(&prv_wheel_mux);
+}
+
+static void prv_stop_timer(timer_id_e timer_id)
+{
+    ASSERT(timer_id < TIMER_ID_LAST);
+
+    portENTER_CRITICAL(&prv_wheel_mux);
+    timingwheel_stop(&prv_wheel, (u8)timer_id);
+    portEXIT_CRITICAL(&prv_wheel_mux);
+}
+
+// The remaining time is counted on the tick, it does not depend on when the pause request is processed
+static void prv_pause_timer(timer_id_e timer_id)
+{
+    ASSERT(timer_id < TIMER_ID_LAST);
+
+    TickType_t now_tick = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&prv_wheel_mux);
+    timingwheel_pause(&prv_wheel, (u8)timer_id, now_tick);
+    portEXIT_CRITICAL(&prv_wheel_mux);
+}
+
+static void prv_resume_timer(timer_id_e timer_id)
+{
+    ASSERT(timer_id < TIMER_ID_LAST);
+
+    TickType_t now_tick = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&prv_wheel_mux);
+    timingwheel_resume(&prv_wheel, (u8)timer_id, now_tick);
+    portEXIT_CRITICAL(&prv_wheel_mux);
 }
 
 // ###########################################################################
 // # Private function implementations
 // ###########################################################################
 
-static void prv_msg_broker_callback(const msg_t* const message)
+void timermanager_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
@@ -98,30 +205,62 @@ static void prv_msg_broker_callback(const msg_t* const message)
     {
         case MSG_3001: // Start Countdown with Time Stamp from the Message Defintions
         {
-            ASSERT(countdown_timer_handle != NULL);
-            ASSERT(message->data_size == sizeof(uint32_t));
-
-            uint32_t countdown_time_ms = 0;
-            // Start a FreeRTOS timer here with the specified time from message->data_bytes
-            memcpy(&countdown_time_ms, message->data_bytes, sizeof(uint32_t));
+            u32 countdown_time_ms = msg::payload<MSG_3001>(message);
 
             ASSERT(countdown_time_ms > 0);
 
-            // Change timer period and start the timer
-            BaseType_t status = xTimerChangePeriod(countdown_timer_handle, pdMS_TO_TICKS(countdown_time_ms), 0);
-            ASSERT(status == pdPASS);
-
-            status = xTimerStart(countdown_timer_handle, 0);
-            ASSERT(status == pdPASS);
+            // Restarts the countdown if it is running
+            prv_start_timer(TIMER_ID_COUNTDOWN, countdown_time_ms, 0);
         }
 
         break;
 
         case MSG_3002: // Stop Countdown Timer
+            prv_stop_timer(TIMER_ID_COUNTDOWN);
+            break;
+
+        case MSG_3004: // Start Timer
+        {
+            const msg_timer_start_t& request = msg::payload<MSG_3004>(message);
+            prv_start_timer(request.timer_id, request.delay_ms, request.period_ms);
+        }
+        break;
+
+        case MSG_3005: // Stop Timer
+            prv_stop_timer(msg::payload<MSG_3005>(message));
+            break;
+
+        case MSG_3009: // Pause Timer
+            prv_pause_timer(msg::payload<MSG_3009>(message));
+            break;
+
+        case MSG_3010: // Resume Timer
+            prv_resume_timer(msg::payload<MSG_3010>(message));
+            break;
+
+        case MSG_3007: // Get Timers
         {
-            // Stop the FreeRTOS timer here
-            ASSERT(countdown_timer_handle != NULL);
-            xTimerStop(countdown_timer_handle, 0);
+            msg_timers_reply_t reply;
+            memset(&reply, 0, sizeof(reply));
+
+            TickType_t now_tick = xTaskGetTickCount();
+            portENTER_CRITICAL(&prv_wheel_mux);
+            for (u8 timer_id = 0; timer_id < TIMER_ID_LAST; timer_id++)
+            {
+                if (timingwheel_is_active(&prv_wheel, timer_id))
+                {
+                    reply.active_mask |= (1UL << timer_id);
+                }
+                if (timingwheel_is_paused(&prv_wheel, timer_id))
+                {
+                    reply.paused_mask |= (1UL << timer_id);
+                }
+                reply.remaining_ms[timer_id] =
+                    timingwheel_get_remaining(&prv_wheel, timer_id, now_tick) * portTICK_PERIOD_MS;
+            }
+            portEXIT_CRITICAL(&prv_wheel_mux);
+
+            msg::reply<MSG_3007>(message, reply);
         }
         break;
 
@@ -131,15 +270,3 @@ static void prv_msg_broker_callback(const msg_t* const message)
             break;
     }
 }
-
-static void prv_timer_expired_callback(TimerHandle_t xTimer)
-{
-    ASSERT(xTimer == countdown_timer_handle);
-
-    msg_t msg;
-    msg.msg_id = MSG_3003; // Countdown finished
-    msg.data_size = 0;
-    msg.data_bytes = NULL;
-
-    messagebroker_publish(&msg);
-}
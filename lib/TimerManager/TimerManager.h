@@ -5,17 +5,38 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define TIMERMANAGER_STACK_SIZE 4096 // Task stack in bytes
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
+    /**
+     * Timer service of the system: one timing wheel on the FreeRTOS tick runs the timers of
+     * all modules (timer_id_e), the task sleeps until the next expiry.
+     *
+     * MSG_3004/MSG_3005 start and stop a timer, one-shot or periodic, and the expiry is
+     * published as MSG_3006 with the timer ID. MSG_3009 pauses a timer and keeps its remaining
+     * time, MSG_3010 resumes it. The countdown of the ApplicationControl keeps its own topics
+     * (MSG_3001, MSG_3002 and MSG_3003). MSG_3007 queries all timers.
+     *
+     * Requests of modules that start before the TimerManager subscribed are lost (runtime
+     * subscriptions), create it before them.
+     */
+
     /**
      * @brief Creates and starts the TimerManager task
      * @return Task handle for the created task
      */
     TaskHandle_t timermanager_create_task(void);
 
+    /**
+     * @brief Registers the TimerManager with the cooperative executor
+     *        (EXECUTOR_COOPERATIVE), instead of creating its task
+     */
+    void timermanager_add_to_executor(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,361 @@
+#include "TimingWheel.h"
+#include "custom_assert.h"
+
+// ---------------------------------------------------------------------------
+// Defines and Macros
+// ---------------------------------------------------------------------------
+#define TIMINGWHEEL_NO_TIMER   0xFFU
+#define TIMINGWHEEL_SLOT_MASK  (TIMINGWHEEL_NOF_SLOTS - 1U)
+#define TIMINGWHEEL_MAX_TICKS  ((1UL << (TIMINGWHEEL_NOF_LEVELS * TIMINGWHEEL_LEVEL_BITS)) - 1U)
+#define TIMINGWHEEL_SHIFT(lvl) ((lvl) * TIMINGWHEEL_LEVEL_BITS)
+
+_Static_assert(TIMINGWHEEL_MAX_TIMERS <= 32U, "Timer IDs are bits of a u32 mask");
+_Static_assert(TIMINGWHEEL_NOF_SLOTS == 64U, "The occupancy bitmaps are u64");
+_Static_assert((TIMINGWHEEL_NOF_LEVELS * TIMINGWHEEL_LEVEL_BITS) < 31U, "Ticks ahead must stay below 2^31");
+
+// ---------------------------------------------------------------------------
+// Private Function Declarations
+// ---------------------------------------------------------------------------
+static bool prv_is_before(u32 tick, u32 reference);
+static void prv_insert(timingwheel_t* wheel, u8 timer_id);
+static void prv_unlink(timingwheel_t* wheel, u8 timer_id);
+static u8 prv_take_slot(timingwheel_t* wheel, u8 level, u8 slot);
+static u32 prv_process_tick(timingwheel_t* wheel, u32 now_tick);
+static u32 prv_get_first_tick(const timingwheel_t* wheel, u8 level);
+static bool prv_get_next_tick(const timingwheel_t* wheel, u32* next_tick);
+static u8 prv_find_occupied_slot(u64 occupied_slots, u8 first_slot);
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+void timingwheel_init(timingwheel_t* wheel, u32 now_tick)
+{
+    ASSERT(wheel != NULL);
+
+    wheel->next_tick = now_tick + 1U;
+    for (u8 level = 0; level < TIMINGWHEEL_NOF_LEVELS; level++)
+    {
+        wheel->occupied_slots[level] = 0;
+        for (u8 slot = 0; slot < TIMINGWHEEL_NOF_SLOTS; slot++)
+        {
+            wheel->slot_heads[level][slot] = TIMINGWHEEL_NO_TIMER;
+        }
+    }
+    for (u8 i = 0; i < TIMINGWHEEL_MAX_TIMERS; i++)
+    {
+        wheel->timers[i].is_active = false;
+        wheel->timers[i].is_paused = false;
+    }
+}
+
+void timingwheel_start(timingwheel_t* wheel, u8 timer_id, u32 expiry_tick, u32 period_ticks)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS); // Increase TIMINGWHEEL_MAX_TIMERS
+
+    timingwheel_stop(wheel, timer_id);
+
+    // The ticks before next_tick have been processed, a past expiry is due with the next one
+    timingwheel_timer_t* timer = &wheel->timers[timer_id];
+    timer->expiry_tick = prv_is_before(expiry_tick, wheel->next_tick) ? wheel->next_tick : expiry_tick;
+    timer->period_ticks = period_ticks;
+    timer->is_active = true;
+    prv_insert(wheel, timer_id);
+}
+
+void timingwheel_stop(timingwheel_t* wheel, u8 timer_id)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    if (wheel->timers[timer_id].is_active)
+    {
+        prv_unlink(wheel, timer_id);
+        wheel->timers[timer_id].is_active = false;
+    }
+    wheel->timers[timer_id].is_paused = false;
+}
+
+void timingwheel_pause(timingwheel_t* wheel, u8 timer_id, u32 now_tick)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    timingwheel_timer_t* timer = &wheel->timers[timer_id];
+    if (timer->is_active)
+    {
+        timer->paused_ticks = timingwheel_get_remaining(wheel, timer_id, now_tick);
+        prv_unlink(wheel, timer_id);
+        timer->is_active = false;
+        timer->is_paused = true;
+    }
+}
+
+void timingwheel_resume(timingwheel_t* wheel, u8 timer_id, u32 now_tick)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    const timingwheel_timer_t* timer = &wheel->timers[timer_id];
+    if (timer->is_paused)
+    {
+        // A periodic timer keeps its period, only the current one was shortened by the ticks before the pause
+        timingwheel_start(wheel, timer_id, now_tick + timer->paused_ticks, timer->period_ticks);
+    }
+}
+
+bool timingwheel_is_active(const timingwheel_t* wheel, u8 timer_id)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    return wheel->timers[timer_id].is_active;
+}
+
+bool timingwheel_is_paused(const timingwheel_t* wheel, u8 timer_id)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    return wheel->timers[timer_id].is_paused;
+}
+
+u32 timingwheel_get_remaining(const timingwheel_t* wheel, u8 timer_id, u32 now_tick)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(timer_id < TIMINGWHEEL_MAX_TIMERS);
+
+    const timingwheel_timer_t* timer = &wheel->timers[timer_id];
+    if (timer->is_paused)
+    {
+        return timer->paused_ticks;
+    }
+    if (!timer->is_active || !prv_is_before(now_tick, timer->expiry_tick))
+    {
+        return 0;
+    }
+    return timer->expiry_tick - now_tick;
+}
+
+u32 timingwheel_advance(timingwheel_t* wheel, u32 now_tick)
+{
+    ASSERT(wheel != NULL);
+
+    u32 expired_mask = 0;
+    u32 next_tick = 0;
+
+    // Only the ticks with an expiry or a cascade are processed, the others are skipped
+    while (prv_get_next_tick(wheel, &next_tick) && !prv_is_before(now_tick, next_tick))
+    {
+        wheel->next_tick = next_tick;
+        expired_mask |= prv_process_tick(wheel, now_tick);
+        wheel->next_tick = next_tick + 1U;
+    }
+
+    if (!prv_is_before(now_tick, wheel->next_tick))
+    {
+        wheel->next_tick = now_tick + 1U;
+    }
+    return expired_mask;
+}
+
+bool timingwheel_get_next_expiry(const timingwheel_t* wheel, u32* expiry_tick)
+{
+    ASSERT(wheel != NULL);
+    ASSERT(expiry_tick != NULL);
+
+    bool is_found = false;
+    u32 min_distance = 0;
+
+    for (u8 level = 0; level < TIMINGWHEEL_NOF_LEVELS; level++)
+    {
+        u64 occupied_slots = wheel->occupied_slots[level];
+        u8 first_slot = (u8)((prv_get_first_tick(wheel, level) >> TIMINGWHEEL_SHIFT(level)) & TIMINGWHEEL_SLOT_MASK);
+
+        while (occupied_slots != 0)
+        {
+            u8 slot = (u8)((first_slot + prv_find_occupied_slot(occupied_slots, first_slot)) & TIMINGWHEEL_SLOT_MASK);
+            for (u8 timer_id = wheel->slot_heads[level][slot]; timer_id != TIMINGWHEEL_NO_TIMER;
+                 timer_id = wheel->timers[timer_id].next)
+            {
+                u32 distance = wheel->timers[timer_id].expiry_tick - wheel->next_tick;
+                if (!is_found || (distance < min_distance))
+                {
+                    min_distance = distance;
+                    *expiry_tick = wheel->timers[timer_id].expiry_tick;
+                    is_found = true;
+                }
+            }
+
+            // The slots of a level are in expiry order, only the top level also parks the timers beyond the wheel
+            if (level < (TIMINGWHEEL_NOF_LEVELS - 1U))
+            {
+                break;
+            }
+            occupied_slots &= ~(1ULL << slot);
+        }
+    }
+    return is_found;
+}
+
+// ---------------------------------------------------------------------------
+// Private Function Implementations
+// ---------------------------------------------------------------------------
+// Wrap-around safe tick < reference, both within 2^31 ticks of each other
+static bool prv_is_before(u32 tick, u32 reference) { return (s32)(tick - reference) < 0; }
+
+static void prv_insert(timingwheel_t* wheel, u8 timer_id)
+{
+    timingwheel_timer_t* timer = &wheel->timers[timer_id];
+
+    // Far ahead timers wait on the last slot in reach and move on with its cascade
+    u32 distance = timer->expiry_tick - wheel->next_tick;
+    u32 slot_tick = timer->expiry_tick;
+    if (distance > TIMINGWHEEL_MAX_TICKS)
+    {
+        distance = TIMINGWHEEL_MAX_TICKS;
+        slot_tick = wheel->next_tick + TIMINGWHEEL_MAX_TICKS;
+    }
+
+    // Coarsest level that still tells the expiry apart from the ticks before it
+    u8 level = 0;
+    while ((level < (TIMINGWHEEL_NOF_LEVELS - 1U)) && (distance >= (1UL << TIMINGWHEEL_SHIFT(level + 1U))))
+    {
+        level++;
+    }
+    u8 slot = (u8)((slot_tick >> TIMINGWHEEL_SHIFT(level)) & TIMINGWHEEL_SLOT_MASK);
+
+    u8 head = wheel->slot_heads[level][slot];
+    timer->level = level;
+    timer->slot = slot;
+    timer->previous = TIMINGWHEEL_NO_TIMER;
+    timer->next = head;
+    if (head != TIMINGWHEEL_NO_TIMER)
+    {
+        wheel->timers[head].previous = timer_id;
+    }
+    wheel->slot_heads[level][slot] = timer_id;
+    wheel->occupied_slots[level] |= (1ULL << slot);
+}
+
+static void prv_unlink(timingwheel_t* wheel, u8 timer_id)
+{
+    timingwheel_timer_t* timer = &wheel->timers[timer_id];
+
+    if (timer->previous != TIMINGWHEEL_NO_TIMER)
+    {
+        wheel->timers[timer->previous].next = timer->next;
+    }
+    else
+    {
+        wheel->slot_heads[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next != TIMINGWHEEL_NO_TIMER)
+    {
+        wheel->timers[timer->next].previous = timer->previous;
+    }
+
+    if (wheel->slot_heads[timer->level][timer->slot] == TIMINGWHEEL_NO_TIMER)
+    {
+        wheel->occupied_slots[timer->level] &= ~(1ULL << timer->slot);
+    }
+}
+
+// Empties a slot, returns the head of its list
+static u8 prv_take_slot(timingwheel_t* wheel, u8 level, u8 slot)
+{
+    u8 head = wheel->slot_heads[level][slot];
+    wheel->slot_heads[level][slot] = TIMINGWHEEL_NO_TIMER;
+    wheel->occupied_slots[level] &= ~(1ULL << slot);
+    return head;
+}
+
+static u32 prv_process_tick(timingwheel_t* wheel, u32 now_tick)
+{
+    u32 tick = wheel->next_tick;
+
+    // Cascade the higher levels whose slot starts with this tick, their timers move down
+    for (u8 level = 1; level < TIMINGWHEEL_NOF_LEVELS; level++)
+    {
+        if ((tick & ((1UL << TIMINGWHEEL_SHIFT(level)) - 1U)) != 0)
+        {
+            break;
+        }
+
+        u8 timer_id = prv_take_slot(wheel, level, (u8)((tick >> TIMINGWHEEL_SHIFT(level)) & TIMINGWHEEL_SLOT_MASK));
+        while (timer_id != TIMINGWHEEL_NO_TIMER)
+        {
+            u8 next = wheel->timers[timer_id].next;
+            prv_insert(wheel, timer_id);
+            timer_id = next;
+        }
+    }
+
+    // A level 0 slot only holds timers that expire with this tick
+    u32 expired_mask = 0;
+    u8 timer_id = prv_take_slot(wheel, 0, (u8)(tick & TIMINGWHEEL_SLOT_MASK));
+    while (timer_id != TIMINGWHEEL_NO_TIMER)
+    {
+        timingwheel_timer_t* timer = &wheel->timers[timer_id];
+        u8 next = timer->next;
+
+        expired_mask |= (1UL << timer_id);
+        if (timer->period_ticks > 0)
+        {
+            // Expiries that were missed while the owner slept are skipped, not processed one by one
+            u32 nof_periods = ((now_tick - timer->expiry_tick) / timer->period_ticks) + 1U;
+            timer->expiry_tick += nof_periods * timer->period_ticks;
+            prv_insert(wheel, timer_id);
+        }
+        else
+        {
+            timer->is_active = false;
+        }
+        timer_id = next;
+    }
+    return expired_mask;
+}
+
+// First tick from next_tick on that processes a slot of the level: every tick on level 0, the cascades above
+static u32 prv_get_first_tick(const timingwheel_t* wheel, u8 level)
+{
+    u32 slot_width_mask = (1UL << TIMINGWHEEL_SHIFT(level)) - 1U;
+    return (wheel->next_tick + slot_width_mask) & ~slot_width_mask;
+}
+
+// Next tick with an expiry or a cascade
+static bool prv_get_next_tick(const timingwheel_t* wheel, u32* next_tick)
+{
+    bool is_found = false;
+    u32 min_distance = 0;
+
+    for (u8 level = 0; level < TIMINGWHEEL_NOF_LEVELS; level++)
+    {
+        if (wheel->occupied_slots[level] == 0)
+        {
+            continue;
+        }
+
+        u32 first_tick = prv_get_first_tick(wheel, level);
+        u8 first_slot = (u8)((first_tick >> TIMINGWHEEL_SHIFT(level)) & TIMINGWHEEL_SLOT_MASK);
+        u8 distance_slots = prv_find_occupied_slot(wheel->occupied_slots[level], first_slot);
+
+        u32 tick = first_tick + ((u32)distance_slots << TIMINGWHEEL_SHIFT(level));
+        u32 distance = tick - wheel->next_tick;
+        if (!is_found || (distance < min_distance))
+        {
+            min_distance = distance;
+            *next_tick = tick;
+            is_found = true;
+        }
+    }
+    return is_found;
+}
+
+// Slots from first_slot (wrapping) to the first occupied one, the bitmap must not be empty
+static u8 prv_find_occupied_slot(u64 occupied_slots, u8 first_slot)
+{
+    u64 rotated = (first_slot == 0) ? occupied_slots
+                                    : ((occupied_slots >> first_slot) | (occupied_slots << (64U - first_slot)));
+    return (u8)__builtin_ctzll(rotated);
+}
@@ -0,0 +1,122 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include "custom_types.h"
+
+// Levels of the wheel, every level has 64 slots: 2^(6 * levels) ticks ahead without a cascade (4.6 hours at 1 kHz)
+#define TIMINGWHEEL_NOF_LEVELS 4U
+#define TIMINGWHEEL_LEVEL_BITS 6U
+#define TIMINGWHEEL_NOF_SLOTS  (1U << TIMINGWHEEL_LEVEL_BITS)
+
+// Timer IDs are bits of the expired mask of timingwheel_advance()
+#ifndef TIMINGWHEEL_MAX_TIMERS
+#define TIMINGWHEEL_MAX_TIMERS 32U
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * Hierarchical timing wheel (Varghese and Lauck) for one-shot and periodic timers.
+     *
+     * Level 0 has one slot per tick for the next 64 ticks, every further level covers 64 slots
+     * of the level below it. A timer is put on the coarsest level that still resolves its expiry
+     * and moves down a level (cascade) when the wheel reaches its slot, so starting and stopping
+     * is O(1) and advancing costs one step per slot that holds timers - empty stretches of the
+     * wheel are skipped with the occupancy bitmaps, however long the caller slept.
+     *
+     * Times are absolute ticks of a free running u32 counter (e.g. xTaskGetTickCount()), they
+     * may wrap. Expiries further ahead than the wheel are parked on the top level and cascade
+     * until they are in reach. A paused timer is off the wheel and only keeps its remaining
+     * ticks, resuming it counts them down from the tick of the resume.
+     * Pure logic without locking, the owner serializes the calls.
+     */
+
+    typedef struct
+    {
+        u32 expiry_tick;  // Absolute tick of the next expiry
+        u32 period_ticks; // 0 = one-shot
+        u32 paused_ticks; // Remaining ticks of a paused timer
+        u8 next;          // Slot list links, 0xFF at the ends
+        u8 previous;
+        u8 level;
+        u8 slot;
+        bool is_active;
+        bool is_paused;
+    } timingwheel_timer_t;
+
+    typedef struct
+    {
+        u32 next_tick; // First tick that has not been processed yet
+        u64 occupied_slots[TIMINGWHEEL_NOF_LEVELS];
+        u8 slot_heads[TIMINGWHEEL_NOF_LEVELS][TIMINGWHEEL_NOF_SLOTS];
+        timingwheel_timer_t timers[TIMINGWHEEL_MAX_TIMERS];
+    } timingwheel_t;
+
+    /**
+     * @brief Stops all timers, the ticks up to and including now count as processed
+     */
+    void timingwheel_init(timingwheel_t* wheel, u32 now_tick);
+
+    /**
+     * @brief Starts or restarts a timer
+     * @param timer_id Timer ID, below TIMINGWHEEL_MAX_TIMERS
+     * @param expiry_tick Absolute tick of the first expiry, a past tick expires with the next advance
+     * @param period_ticks Ticks between the following expiries, 0 = one-shot
+     */
+    void timingwheel_start(timingwheel_t* wheel, u8 timer_id, u32 expiry_tick, u32 period_ticks);
+
+    /**
+     * @brief Stops a timer, no-op if it is not running. A paused timer is discarded.
+     */
+    void timingwheel_stop(timingwheel_t* wheel, u8 timer_id);
+
+    /**
+     * @brief Takes a running timer off the wheel and keeps its remaining ticks, no-op if it is not running
+     */
+    void timingwheel_pause(timingwheel_t* wheel, u8 timer_id, u32 now_tick);
+
+    /**
+     * @brief Puts a paused timer back on the wheel, it expires after the ticks it had left, no-op if it is not paused
+     */
+    void timingwheel_resume(timingwheel_t* wheel, u8 timer_id, u32 now_tick);
+
+    /**
+     * @brief Checks whether a timer is running
+     */
+    bool timingwheel_is_active(const timingwheel_t* wheel, u8 timer_id);
+
+    /**
+     * @brief Checks whether a timer is paused
+     */
+    bool timingwheel_is_paused(const timingwheel_t* wheel, u8 timer_id);
+
+    /**
+     * @brief Get the ticks from now until the next expiry of a timer
+     * @return Remaining ticks, the ticks a paused timer has left, 0 if the timer is stopped or already due
+     */
+    u32 timingwheel_get_remaining(const timingwheel_t* wheel, u8 timer_id, u32 now_tick);
+
+    /**
+     * @brief Processes all ticks up to and including now
+     *
+     * Periodic timers are re-armed from their expiry, not from now, so they do not drift.
+     * A periodic timer that expired several times since the last call is reported once.
+     *
+     * @return Mask of the timers that expired, bit n = timer ID n
+     */
+    u32 timingwheel_advance(timingwheel_t* wheel, u32 now_tick);
+
+    /**
+     * @brief Get the earliest expiry of the running timers, the owner sleeps until then
+     * @return false if no timer is running
+     */
+    bool timingwheel_get_next_expiry(const timingwheel_t* wheel, u32* expiry_tick);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,44 @@
+#include "monotonic_time.h"
+#include "custom_assert.h"
+
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#elif !MONOTONIC_TIME_VIRTUAL
+#include <time.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Private Variables
+// ---------------------------------------------------------------------------
+#if MONOTONIC_TIME_VIRTUAL
+static u64 prv_virtual_time_us = 0; // Read by all tasks (threads), written by the owner of the clock
+#endif
+
+// ---------------------------------------------------------------------------
+// Public Function Implementations
+// ---------------------------------------------------------------------------
+u64 monotonic_time_get_us(void)
+{
+#if MONOTONIC_TIME_VIRTUAL
+    return __atomic_load_n(&prv_virtual_time_us, __ATOMIC_RELAXED);
+#elif defined(ESP_PLATFORM)
+    return (u64)esp_timer_get_time();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000ULL + (u64)now.tv_nsec / 1000ULL;
+#endif
+}
+
+u64 monotonic_time_get_ms(void) { return monotonic_time_get_us() / 1000ULL; }
+
+#if MONOTONIC_TIME_VIRTUAL
+void monotonic_time_set_us(u64 now_us)
+{
+    ASSERT(now_us >= monotonic_time_get_us()); // The clock never runs backwards
+
+    __atomic_store_n(&prv_virtual_time_us, now_us, __ATOMIC_RELAXED);
+}
+
+void monotonic_time_advance_us(u64 delta_us) { __atomic_fetch_add(&prv_virtual_time_us, delta_us, __ATOMIC_RELAXED); }
+#endif
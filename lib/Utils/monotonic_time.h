@@ -0,0 +1,53 @@
+#ifndef MONOTONIC_TIME_H
+#define MONOTONIC_TIME_H
+
+#include "custom_types.h"
+
+/**
+ * @file monotonic_time.h
+ * @brief Time base of all modules: microseconds since boot as u64
+ *
+ * Unlike the u32 millis() (49.7 days) the clock does not wrap while the device runs, so time
+ * stamps can be stored and compared without wrap-around arithmetic.
+ *
+ * ESP32: esp_timer, the 64 bit system timer.
+ * Host:  CLOCK_MONOTONIC. With MONOTONIC_TIME_VIRTUAL=1 the clock is virtual instead, it starts
+ *        at 0 and only moves with monotonic_time_set_us()/monotonic_time_advance_us() - replays
+ *        and tests step it and get the same result on every run.
+ */
+#ifndef MONOTONIC_TIME_VIRTUAL
+#define MONOTONIC_TIME_VIRTUAL 0
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * @brief Get the time since boot in microseconds
+     */
+    u64 monotonic_time_get_us(void);
+
+    /**
+     * @brief Get the time since boot in milliseconds
+     */
+    u64 monotonic_time_get_ms(void);
+
+#if MONOTONIC_TIME_VIRTUAL
+    /**
+     * @brief Sets the virtual clock, it never runs backwards
+     */
+    void monotonic_time_set_us(u64 now_us);
+
+    /**
+     * @brief Moves the virtual clock forward
+     */
+    void monotonic_time_advance_us(u64 delta_us);
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // MONOTONIC_TIME_H
@@ -0,0 +1,17 @@
+#ifndef RTOS_ALLOC_H
+#define RTOS_ALLOC_H
+
+/**
+ * @file rtos_alloc.h
+ * @brief Allocation mode of the FreeRTOS tasks and timers of the modules
+ *
+ * 1: stacks, task control blocks and timers are static buffers sized at compile time. They show up
+ *    in the RAM use of the linker map, boot cannot run out of heap, and the heap is left in one piece
+ *    for the NimBLE and WiFi stacks.
+ * 0: xTaskCreate()/xTimerCreate() take them from the heap at boot.
+ */
+#ifndef RTOS_STATIC_ALLOCATION
+#define RTOS_STATIC_ALLOCATION 0
+#endif
+
+#endif // RTOS_ALLOC_H
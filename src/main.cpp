@@ -3,9 +3,12 @@
 #include "BlinkLed.h"
 #include "Console.h"
 #include "DeskControl.h"
+#include "Executor.h"
 #include "MessageBroker.h"
+#include "MessageDispatcher.h"
 #include "NetworkTime.h"
 #include "PresenceDetector.h"
+#include "StackMonitor.h"
 #include "TimerManager.h"
 #include "custom_assert.h"
 
@@ -17,7 +20,7 @@
 // # Private function declarations
 // ###########################################################################
 static void prv_assert_failed(const char* file, uint32_t line, const char* expr);
-static void msg_broker_callback(const msg_t* const message);
+static void prv_suspend_task(TaskHandle_t task_handle);
 
 // ###########################################################################
 // # Task handles
@@ -28,6 +31,9 @@ TaskHandle_t presencedetector_task_handle = NULL;
 TaskHandle_t applicationcontrol_task_handle = NULL;
 TaskHandle_t timermanager_task_handle = NULL;
 TaskHandle_t networktime_task_handle = NULL;
+TaskHandle_t messagedispatcher_task_handle = NULL;
+TaskHandle_t executor_task_handle = NULL; // EXECUTOR_COOPERATIVE, runs the modules without a task handle
+static TaskHandle_t loop_task_handle = NULL; // Arduino task that runs setup() and loop()
 
 // ###########################################################################
 // # Private Data
@@ -47,7 +53,26 @@ void setup()
 
     messagebroker_init();
 
-    // Create all tasks using module-specific functions
+#if EXECUTOR_COOPERATIVE
+    // One task runs the modules, the dispatcher first so that the others see its hardware events
+    messagedispatcher_add_to_executor();
+    console_add_to_executor();
+    deskcontrol_add_to_executor();
+    applicationcontrol_add_to_executor();
+    timermanager_add_to_executor();
+    presencedetector_add_to_executor();
+    executor_task_handle = executor_create_task();
+
+    // Stabilize the power on the system to avoid brownout issues on ESP32
+    // The presence detector requires more power during bluetooth scanning, the executor initializes it
+    delay(1000);
+
+    // NetworkTime keeps its own task, connecting to the WiFi and the NTP sync block for seconds.
+    // It starts its sync timer right away, after the TimerManager of the executor has subscribed
+    networktime_task_handle = networktime_create_task();
+#else
+    // Create all tasks using module-specific functions, the TimerManager before the modules that start timers
+    messagedispatcher_task_handle = messagedispatcher_create_task();
     console_task_handle = console_create_task();
     deskcontrol_task_handle = deskcontrol_create_task();
     applicationcontrol_task_handle = applicationcontrol_create_task();
@@ -59,20 +84,38 @@ void setup()
     delay(1000);
 
     presencedetector_task_handle = presencedetector_create_task();
+#endif
 
     // Initialize BlinkLed module
     blinkled_init(LED_PIN);
 
+    // Presence changes notify loop(), which sleeps otherwise
+    loop_task_handle = xTaskGetCurrentTaskHandle();
+
+    // Worst case stack use of every task, see the system_stack command
+    stackmonitor_add_task(messagedispatcher_task_handle, MESSAGEDISPATCHER_STACK_SIZE);
+    stackmonitor_add_task(console_task_handle, CONSOLE_STACK_SIZE);
+    stackmonitor_add_task(deskcontrol_task_handle, DESKCONTROL_STACK_SIZE);
+    stackmonitor_add_task(applicationcontrol_task_handle, APPLICATIONCONTROL_STACK_SIZE);
+    stackmonitor_add_task(timermanager_task_handle, TIMERMANAGER_STACK_SIZE);
+    stackmonitor_add_task(networktime_task_handle, NETWORKTIME_STACK_SIZE);
+    stackmonitor_add_task(presencedetector_task_handle, PRESENCEDETECTOR_STACK_SIZE);
+    stackmonitor_add_task(executor_task_handle, EXECUTOR_STACK_SIZE);
+    stackmonitor_add_task(loop_task_handle, getArduinoLoopTaskStackSize());
+    stackmonitor_start();
+
     // Subscribe to the presense detected message
-    messagebroker_subscribe(MSG_2001, msg_broker_callback);
-    messagebroker_subscribe(MSG_2002, msg_broker_callback);
+    // Both topics are retained, the current presence state is replayed right away
+    messagebroker_subscribe(MSG_2001, main_msg_broker_callback);
+    messagebroker_subscribe(MSG_2002, main_msg_broker_callback);
 }
 
 void loop()
 {
     if (g_assert_was_triggered)
     {
-        return;
+        // prv_assert_failed() blinks the LED from the failing task
+        vTaskSuspend(NULL);
     }
 
     // Blink the LED based on presence state
@@ -84,6 +127,9 @@ void loop()
     else // No person present
     {
         blinkled_disable();
+
+        // Sleep until main_msg_broker_callback() reports a presence change
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
 }
 
@@ -98,12 +144,14 @@ static void prv_assert_failed(const char* file, uint32_t line, const char* expr)
     // In embedded systems, we might want to reset instead of infinite loop
 
     // Stop all tasks
-    vTaskSuspend(console_task_handle);
-    vTaskSuspend(deskcontrol_task_handle);
-    vTaskSuspend(presencedetector_task_handle);
-    vTaskSuspend(applicationcontrol_task_handle);
-    vTaskSuspend(timermanager_task_handle);
-    vTaskSuspend(networktime_task_handle);
+    prv_suspend_task(console_task_handle);
+    prv_suspend_task(deskcontrol_task_handle);
+    prv_suspend_task(presencedetector_task_handle);
+    prv_suspend_task(applicationcontrol_task_handle);
+    prv_suspend_task(timermanager_task_handle);
+    prv_suspend_task(networktime_task_handle);
+    prv_suspend_task(messagedispatcher_task_handle);
+    prv_suspend_task(executor_task_handle);
 
     while (1)
     {
@@ -112,7 +160,16 @@ static void prv_assert_failed(const char* file, uint32_t line, const char* expr)
     }
 }
 
-static void msg_broker_callback(const msg_t* const message)
+static void prv_suspend_task(TaskHandle_t task_handle)
+{
+    // NULL would suspend the calling task, the handles of the mode that is not used stay NULL
+    if (task_handle != NULL)
+    {
+        vTaskSuspend(task_handle);
+    }
+}
+
+void main_msg_broker_callback(const msg_t* const message)
 {
     ASSERT(message != NULL);
 
@@ -129,4 +186,6 @@ static void msg_broker_callback(const msg_t* const message)
             ASSERT(false);
             break;
     }
+
+    xTaskNotifyGive(loop_task_handle);
 }
\ No newline at end of file
@@ -0,0 +1,1110 @@
+/**
+ * @file TraceReplay.cpp
+ * @brief Replays recorded broker traffic into the natively compiled ApplicationControl,
+ *        TimerManager, DeskControl and PresenceDetector modules and diffs their outgoing messages.
+ *
+ * Input is either a binary dump of the trace recorder (msgbroker_trace dump, see
+ * MessageTrace.h) or a text scenario with one publish per line:
+ *
+ *   # time_ms  topic     payload bytes (hex)
+ *   0          MSG_2001
+ *   1500       MSG_4001  40 77 1B 00
+ *   1:30:00    BLE       -52 -60 -71   (h:mm:ss, devices in range of the BLE scan and their RSSI)
+ *   #! --tail 1300000    (command line options, handy for corpus cases)
+ *
+ * With --simulate-presence the PresenceDetector runs as well: BLE lines put devices in
+ * range of its scan and MSG_2001/MSG_2002 are its output instead of an input. A scripted
+ * office day then covers the presence averaging, the countdown and the time restriction
+ * of ApplicationControl (the time of day is --start-time plus the virtual clock).
+ *
+ * Topics published by the replayed modules (output_topics) are not injected - the
+ * recorded ones are the expected output. MSG_1003 is replaced by a simulated desk that sends
+ * its request frame every --desk-poll ms while the display wake pin is high. Everything runs
+ * on a virtual clock, so a replay is deterministic and hours of traffic take milliseconds
+ * (--speed 1000 paces them at 1000 times real time instead).
+ *
+ * Outgoing messages and UART frames are printed, compared with the recorded messages of the
+ * trace and, with --expect, with a stored replay output. The exit code is 0 if all match.
+ *
+ * Build and run with PlatformIO (see env:replay in platformio.ini):
+ *   pio run -e replay && .pio/build/replay/program --corpus tools/replay/corpus
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "HostPlatform.h"
+#include "MessageBroker.h"
+#include "MessageSchema.h"
+#include "MessageTrace.h"
+#include "NetworkTime.h"
+#include "custom_assert.h"
+#include "custom_types.h"
+
+#if MESSAGEBROKER_ASYNC_DISPATCH || MESSAGEBROKER_STATIC_ROUTES
+#error "The replay steps the modules itself, build with synchronous runtime subscriptions"
+#endif
+
+// ###########################################################################
+// # Internal Configuration
+// ###########################################################################
+#define REPLAY_MAX_EVENTS         65536U
+#define REPLAY_MAX_PAYLOAD        MESSAGEPOOL_BLOCK_SIZE
+#define REPLAY_MAX_LINE           512U
+#define REPLAY_DEFAULT_DESK_POLL  100U // ms between request frames of the desk while its display is awake
+#define REPLAY_DESK_WAKEUP_PIN    D9   // WAKEUP_PIN of DeskControl
+#define REPLAY_NO_START_TIME      0xFFFFFFFFUL
+
+// Topics published by the replayed modules
+static const msg_id_e output_topics[] = {
+    MSG_1000, // ApplicationControl: desk toggle
+    MSG_1004, // DeskControl: desk height reply
+    MSG_3001, // ApplicationControl: start countdown
+    MSG_3002, // ApplicationControl: stop countdown
+    MSG_3003, // TimerManager: countdown finished
+    MSG_3009, // ApplicationControl: pause countdown
+    MSG_3010, // ApplicationControl: resume countdown
+    MSG_4004, // ApplicationControl: timer interval reply
+    MSG_4005, // ApplicationControl: elapsed timer time reply
+};
+
+// Request frame the desk sends to poll for commands
+static const u8 desk_request_frame[] = {0x9B, 0x04, 0x11, 0x7C, 0xC3, 0x9D};
+
+// Topics published by the PresenceDetector (--simulate-presence)
+static const msg_id_e presence_topics[] = {
+    MSG_2001, // Presence Detected
+    MSG_2002, // No Presence Detected
+};
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+typedef enum
+{
+    EVENT_MESSAGE,
+    EVENT_UART,
+    EVENT_BLE, // Input only: data_bytes holds the RSSI (s8) of the devices in range
+} replay_event_kind_e;
+
+typedef struct
+{
+    u32 time_ms;
+    replay_event_kind_e kind;
+    msg_id_e msg_id;
+    u16 data_size;    // Size of the published payload
+    u16 nof_bytes;    // Bytes available in data_bytes, less than data_size for truncated trace payloads
+    u8 data_bytes[REPLAY_MAX_PAYLOAD];
+} replay_event_t;
+
+typedef struct
+{
+    double speed;
+    u32 tail_ms;
+    u32 start_minute_of_day;
+    u32 desk_poll_ms;
+    const char* expect_path;
+    const char* output_path;
+    u32 tolerance_ms;
+    bool is_tolerance_set;
+    bool is_verbose;
+    bool is_presence_simulated;
+} replay_options_t;
+
+typedef struct
+{
+    const char* name;
+    msg_id_e msg_id;
+} replay_topic_name_t;
+
+#define REPLAY_TOPIC(id) {#id, id}
+static const replay_topic_name_t topic_names[] = {
+    REPLAY_TOPIC(MSG_0001), REPLAY_TOPIC(MSG_0002), REPLAY_TOPIC(MSG_0003), REPLAY_TOPIC(MSG_0004),
+    REPLAY_TOPIC(MSG_0005), REPLAY_TOPIC(MSG_0006), REPLAY_TOPIC(MSG_1000), REPLAY_TOPIC(MSG_1001),
+    REPLAY_TOPIC(MSG_1002), REPLAY_TOPIC(MSG_1003), REPLAY_TOPIC(MSG_1004), REPLAY_TOPIC(MSG_2001),
+    REPLAY_TOPIC(MSG_2002), REPLAY_TOPIC(MSG_2003), REPLAY_TOPIC(MSG_2004), REPLAY_TOPIC(MSG_2005),
+    REPLAY_TOPIC(MSG_3001), REPLAY_TOPIC(MSG_3002), REPLAY_TOPIC(MSG_3003), REPLAY_TOPIC(MSG_3004),
+    REPLAY_TOPIC(MSG_3005), REPLAY_TOPIC(MSG_3006), REPLAY_TOPIC(MSG_3007), REPLAY_TOPIC(MSG_3008),
+    REPLAY_TOPIC(MSG_3009), REPLAY_TOPIC(MSG_3010), REPLAY_TOPIC(MSG_4001), REPLAY_TOPIC(MSG_4002),
+    REPLAY_TOPIC(MSG_4003), REPLAY_TOPIC(MSG_4004), REPLAY_TOPIC(MSG_4005), REPLAY_TOPIC(MSG_5001),
+    REPLAY_TOPIC(MSG_5002), REPLAY_TOPIC(MSG_5003), REPLAY_TOPIC(MSG_5004), REPLAY_TOPIC(MSG_5005),
+    REPLAY_TOPIC(MSG_5006),
+};
+static_assert(sizeof(topic_names) / sizeof(topic_names[0]) == E_TOPIC_LAST_TOPIC - 1U,
+              "Add the new topic to topic_names");
+
+// ###########################################################################
+// # Module hooks (exposed with STATIC, the replay is built with -DTEST)
+// ###########################################################################
+void prv_applicationcontrol_init(void);
+void prv_applicationcontrol_run(void);
+void prv_timermanager_init(void);
+u32 prv_timermanager_run(void);
+void prv_deskcontrol_init(void);
+void prv_presencedetector_init(void);
+u32 prv_presencedetector_run(void);
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+static int prv_replay_file(const char* path);
+static int prv_run_corpus(const char* directory);
+static int prv_parse_options(int argc, char* argv[], bool is_scenario);
+static bool prv_load_trace(const char* path);
+static bool prv_load_binary_trace(const u8* bytes, size_t size);
+static bool prv_load_text_trace(char* text);
+static bool prv_parse_time(const char* text, u32* time_ms);
+static void prv_add_event(u32 time_ms, msg_id_e msg_id, u16 data_size, const u8* bytes, u16 nof_bytes);
+static void prv_add_ble_event(u32 time_ms, const s8* rssi_dbm, u8 nof_devices);
+static void prv_run(void);
+static void prv_run_until(u32 end_ms);
+static void prv_step(u32 time_ms);
+static void prv_settle(void);
+static void prv_run_timermanager(void);
+static void prv_pace(u32 time_ms);
+static void prv_output_callback(const msg_t* const message);
+static bool prv_is_output_topic(msg_id_e msg_id);
+static const char* prv_get_topic_name(msg_id_e msg_id);
+static bool prv_parse_topic(const char* text, msg_id_e* msg_id);
+static void prv_format_event(const replay_event_t* event, char* line, size_t size);
+static bool prv_diff_recorded_outputs(void);
+static bool prv_diff_expected_outputs(const char* path);
+static bool prv_write_outputs(FILE* file);
+static void prv_assert_failed(const char* file, uint32_t line, const char* expr);
+
+// ###########################################################################
+// # Private variables
+// ###########################################################################
+static replay_options_t options = {
+    0.0, 0, REPLAY_NO_START_TIME, REPLAY_DEFAULT_DESK_POLL, NULL, NULL, 0, false, false, false};
+
+static replay_event_t inputs[REPLAY_MAX_EVENTS];
+static u32 nof_inputs = 0;
+static replay_event_t recorded_outputs[REPLAY_MAX_EVENTS];
+static u32 nof_recorded_outputs = 0;
+static replay_event_t outputs[REPLAY_MAX_EVENTS];
+static u32 nof_outputs = 0;
+static u32 nof_truncated_inputs = 0;
+static u32 nof_invalid_inputs = 0;
+
+static u32 appctrl_resume_ms = 0;
+static u32 timermanager_resume_ms = 0;
+static bool is_timer_pending = false;
+static bool is_desk_awake = false;
+static u32 desk_poll_ms = 0;
+static struct timespec wall_start;
+
+// ###########################################################################
+// # Main
+// ###########################################################################
+int main(int argc, char* argv[])
+{
+    custom_assert_init(prv_assert_failed);
+
+    int first_path = prv_parse_options(argc, argv, false);
+    if (first_path < 0)
+    {
+        return 2;
+    }
+
+    if ((first_path < argc) && (strcmp(argv[first_path], "--corpus") == 0) && (first_path + 1 < argc))
+    {
+        return prv_run_corpus(argv[first_path + 1]);
+    }
+
+    if (first_path != argc - 1)
+    {
+        fprintf(stderr, "Usage: %s [options] <trace>\n", argv[0]);
+        fprintf(stderr, "       %s [options] --corpus <directory>\n", argv[0]);
+        fprintf(stderr, "Options: --speed <x> (0 = as fast as possible, 1 = original timing)\n");
+        fprintf(stderr, "         --tail <ms> --start-time <hh:mm> --desk-poll <ms> --pref <ns/key=u32>\n");
+        fprintf(stderr, "         --expect <file> --output <file> --tolerance <ms> --verbose --simulate-presence\n");
+        return 2;
+    }
+
+    return prv_replay_file(argv[first_path]);
+}
+
+// ###########################################################################
+// # NetworkTime replacement - wall clock derived from --start-time
+// ###########################################################################
+bool networktime_is_synchronized(void) { return options.start_minute_of_day != REPLAY_NO_START_TIME; }
+
+int networktime_get_current_hour(void)
+{
+    u32 minute_of_day = options.start_minute_of_day + host_get_time_ms() / 60000U;
+    return (int)((minute_of_day / 60U) % 24U);
+}
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+static int prv_replay_file(const char* path)
+{
+    if (!prv_load_trace(path))
+    {
+        return 2;
+    }
+    host_set_serial_echo(options.is_verbose);
+
+    prv_run();
+
+    bool is_matching = prv_diff_recorded_outputs();
+    if (options.expect_path != NULL)
+    {
+        is_matching = prv_diff_expected_outputs(options.expect_path) && is_matching;
+    }
+
+    if (options.output_path != NULL)
+    {
+        FILE* file = fopen(options.output_path, "w");
+        if ((file == NULL) || !prv_write_outputs(file) || (fclose(file) != 0))
+        {
+            fprintf(stderr, "Cannot write %s\n", options.output_path);
+            return 2;
+        }
+    }
+    else if (options.expect_path == NULL)
+    {
+        prv_write_outputs(stdout);
+    }
+
+    return is_matching ? 0 : 1;
+}
+
+// Every case needs fresh module state, so each one runs in its own process
+static int prv_run_corpus(const char* directory)
+{
+    DIR* dir = opendir(directory);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", directory);
+        return 2;
+    }
+
+    u32 nof_cases = 0;
+    u32 nof_failed = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        const char* extension = strrchr(entry->d_name, '.');
+        if ((extension == NULL) || ((strcmp(extension, ".txt") != 0) && (strcmp(extension, ".trace") != 0)))
+        {
+            continue;
+        }
+
+        char trace_path[REPLAY_MAX_LINE];
+        char expect_path[REPLAY_MAX_LINE];
+        int base_length = (int)(extension - entry->d_name);
+        snprintf(trace_path, sizeof(trace_path), "%s/%s", directory, entry->d_name);
+        snprintf(expect_path, sizeof(expect_path), "%s/%.*s.expected", directory, base_length, entry->d_name);
+        if (access(expect_path, R_OK) != 0)
+        {
+            fprintf(stderr, "SKIP %s (no %s)\n", trace_path, expect_path);
+            continue;
+        }
+
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0)
+        {
+            options.expect_path = expect_path;
+            options.output_path = NULL;
+            exit(prv_replay_file(trace_path));
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        bool is_passed = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+        printf("%s %s\n", is_passed ? "PASS" : "FAIL", trace_path);
+
+        nof_cases++;
+        nof_failed += is_passed ? 0U : 1U;
+    }
+    closedir(dir);
+
+    printf("%u cases, %u failed\n", nof_cases, nof_failed);
+    return (nof_failed == 0) ? 0 : 1;
+}
+
+// Returns the index of the first non-option argument or -1 on error
+static int prv_parse_options(int argc, char* argv[], bool is_scenario)
+{
+    int i = is_scenario ? 0 : 1;
+    for (; i < argc; i++)
+    {
+        const char* option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strncmp(option, "--", 2) != 0 || strcmp(option, "--corpus") == 0)
+        {
+            break;
+        }
+
+        if (strcmp(option, "--verbose") == 0)
+        {
+            options.is_verbose = true;
+            continue;
+        }
+        if (strcmp(option, "--simulate-presence") == 0)
+        {
+            options.is_presence_simulated = true;
+            continue;
+        }
+
+        if (value == NULL)
+        {
+            fprintf(stderr, "Missing value for %s\n", option);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(option, "--speed") == 0)
+        {
+            options.speed = atof(value);
+        }
+        else if (strcmp(option, "--tail") == 0)
+        {
+            options.tail_ms = (u32)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(option, "--start-time") == 0)
+        {
+            unsigned hour = 0;
+            unsigned minute = 0;
+            if ((sscanf(value, "%u:%u", &hour, &minute) < 1) || (hour > 23U) || (minute > 59U))
+            {
+                fprintf(stderr, "Invalid --start-time %s, expected hh:mm\n", value);
+                return -1;
+            }
+            options.start_minute_of_day = hour * 60U + minute;
+        }
+        else if (strcmp(option, "--desk-poll") == 0)
+        {
+            options.desk_poll_ms = (u32)strtoul(value, NULL, 0);
+            if (options.desk_poll_ms == 0)
+            {
+                fprintf(stderr, "--desk-poll must be at least 1 ms\n");
+                return -1;
+            }
+        }
+        else if (strcmp(option, "--pref") == 0)
+        {
+            char name_space[32];
+            char key[32];
+            unsigned long pref_value = 0;
+            if (sscanf(value, "%31[^/]/%31[^=]=%lu", name_space, key, &pref_value) != 3)
+            {
+                fprintf(stderr, "Invalid --pref %s, expected namespace/key=value\n", value);
+                return -1;
+            }
+            host_preferences_put_u32(name_space, key, (u32)pref_value);
+        }
+        else if (strcmp(option, "--expect") == 0 && !is_scenario)
+        {
+            options.expect_path = value;
+        }
+        else if (strcmp(option, "--output") == 0 && !is_scenario)
+        {
+            options.output_path = value;
+        }
+        else if (strcmp(option, "--tolerance") == 0)
+        {
+            options.tolerance_ms = (u32)strtoul(value, NULL, 0);
+            options.is_tolerance_set = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", option);
+            return -1;
+        }
+    }
+    return i;
+}
+
+static bool prv_load_trace(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* bytes = (char*)malloc((size_t)size + 1U);
+    ASSERT(bytes != NULL);
+    size_t nof_read = fread(bytes, 1, (size_t)size, file);
+    fclose(file);
+    bytes[nof_read] = '\0';
+
+    u32 magic = 0;
+    if (nof_read >= sizeof(magic))
+    {
+        memcpy(&magic, bytes, sizeof(magic));
+    }
+
+    bool is_loaded = (magic == MESSAGETRACE_MAGIC) ? prv_load_binary_trace((const u8*)bytes, nof_read)
+                                                   : prv_load_text_trace(bytes);
+    free(bytes);
+
+    if (is_loaded && (nof_truncated_inputs > 0))
+    {
+        fprintf(stderr, "Warning: %u recorded payloads were truncated by the recorder\n", nof_truncated_inputs);
+    }
+    if (is_loaded && (nof_invalid_inputs > 0))
+    {
+        fprintf(stderr, "Warning: %u inputs do not match MESSAGE_SCHEMA and are not replayed\n", nof_invalid_inputs);
+    }
+    return is_loaded;
+}
+
+// Milliseconds ("90000") or hours, minutes and seconds ("1:30:00") since the start of the replay
+static bool prv_parse_time(const char* text, u32* time_ms)
+{
+    unsigned hours = 0;
+    unsigned minutes = 0;
+    unsigned seconds = 0;
+    char end = '\0';
+    if (strchr(text, ':') == NULL)
+    {
+        char* number_end = NULL;
+        *time_ms = (u32)strtoul(text, &number_end, 0);
+        return (number_end != text) && (*number_end == '\0');
+    }
+    if ((sscanf(text, "%u:%u:%u%c", &hours, &minutes, &seconds, &end) != 3) || (minutes > 59U) || (seconds > 59U) ||
+        (hours > 1000U))
+    {
+        return false;
+    }
+    *time_ms = ((hours * 60U + minutes) * 60U + seconds) * 1000U;
+    return true;
+}
+
+static void prv_add_event(u32 time_ms, msg_id_e msg_id, u16 data_size, const u8* bytes, u16 nof_bytes)
+{
+    // The desk is simulated, its UART notifications are not replayed
+    if (msg_id == MSG_1003)
+    {
+        return;
+    }
+
+    bool is_output = prv_is_output_topic(msg_id);
+
+    // The replayed modules read their payloads without checks (MessageSchema.h)
+    msg_t message;
+    message.msg_id = msg_id;
+    message.data_size = nof_bytes;
+    message.data_bytes = (u8*)bytes;
+    if (!is_output && !msg::is_valid(&message))
+    {
+        nof_invalid_inputs++;
+        return;
+    }
+
+    replay_event_t* event = is_output ? &recorded_outputs[nof_recorded_outputs++] : &inputs[nof_inputs++];
+    ASSERT((nof_inputs <= REPLAY_MAX_EVENTS) && (nof_recorded_outputs <= REPLAY_MAX_EVENTS));
+    ASSERT(nof_bytes <= REPLAY_MAX_PAYLOAD);
+
+    event->time_ms = time_ms;
+    event->kind = EVENT_MESSAGE;
+    event->msg_id = msg_id;
+    event->data_size = data_size;
+    event->nof_bytes = nof_bytes;
+    memcpy(event->data_bytes, bytes, nof_bytes);
+
+    if (!is_output && (nof_bytes < data_size))
+    {
+        nof_truncated_inputs++;
+    }
+}
+
+static void prv_add_ble_event(u32 time_ms, const s8* rssi_dbm, u8 nof_devices)
+{
+    ASSERT(nof_inputs < REPLAY_MAX_EVENTS);
+    ASSERT(nof_devices <= REPLAY_MAX_PAYLOAD);
+
+    replay_event_t* event = &inputs[nof_inputs++];
+    event->time_ms = time_ms;
+    event->kind = EVENT_BLE;
+    event->msg_id = E_TOPIC_FIRST_TOPIC;
+    event->data_size = nof_devices;
+    event->nof_bytes = nof_devices;
+    memcpy(event->data_bytes, rssi_dbm, nof_devices);
+}
+
+static bool prv_load_binary_trace(const u8* bytes, size_t size)
+{
+    msg_trace_header_t header;
+    if (size < sizeof(header))
+    {
+        fprintf(stderr, "Trace header incomplete\n");
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(header));
+
+    const size_t data_offset = offsetof(msg_trace_record_t, data_bytes);
+    if ((header.version != MESSAGETRACE_VERSION) || (header.record_size < data_offset + header.payload_size))
+    {
+        fprintf(stderr, "Unsupported trace version %u\n", header.version);
+        return false;
+    }
+    if (size < sizeof(header) + (size_t)header.nof_records * header.record_size)
+    {
+        fprintf(stderr, "Trace truncated, %u records announced\n", header.nof_records);
+        return false;
+    }
+
+    // Time stamps are microseconds since boot, the replay starts with the first record
+    u64 first_us = 0;
+    for (u32 i = 0; i < header.nof_records; i++)
+    {
+        const u8* record = &bytes[sizeof(header) + (size_t)i * header.record_size];
+
+        u64 timestamp_us = 0;
+        u16 data_size = 0;
+        u8 msg_id = 0;
+        memcpy(&timestamp_us, &record[offsetof(msg_trace_record_t, timestamp_us)], sizeof(timestamp_us));
+        memcpy(&data_size, &record[offsetof(msg_trace_record_t, data_size)], sizeof(data_size));
+        memcpy(&msg_id, &record[offsetof(msg_trace_record_t, msg_id)], sizeof(msg_id));
+
+        if ((msg_id <= E_TOPIC_FIRST_TOPIC) || (msg_id >= E_TOPIC_LAST_TOPIC))
+        {
+            fprintf(stderr, "Record %u: unknown topic %u\n", i, msg_id);
+            return false;
+        }
+
+        if (i == 0)
+        {
+            first_us = timestamp_us;
+        }
+
+        u16 nof_bytes = (data_size < header.payload_size) ? data_size : header.payload_size;
+        u32 time_ms = (u32)((timestamp_us - first_us) / 1000U);
+        prv_add_event(time_ms, (msg_id_e)msg_id, data_size, &record[data_offset], nof_bytes);
+    }
+    return true;
+}
+
+static bool prv_load_text_trace(char* text)
+{
+    u32 line_number = 0;
+    u32 previous_ms = 0;
+    for (char* line = strtok(text, "\n"); line != NULL; line = strtok(NULL, "\n"))
+    {
+        line_number++;
+
+        // Scenario options, e.g. "#! --tail 60000 --start-time 09:00"
+        if (strncmp(line, "#!", 2) == 0)
+        {
+            char* arguments[16];
+            int nof_arguments = 0;
+            char* save = NULL;
+            for (char* word = strtok_r(&line[2], " \t\r", &save); (word != NULL) && (nof_arguments < 16);
+                 word = strtok_r(NULL, " \t\r", &save))
+            {
+                arguments[nof_arguments++] = word;
+            }
+            if (prv_parse_options(nof_arguments, arguments, true) != nof_arguments)
+            {
+                fprintf(stderr, "Line %u: invalid options\n", line_number);
+                return false;
+            }
+            continue;
+        }
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        char* save = NULL;
+        char* time_text = strtok_r(line, " \t\r", &save);
+        if (time_text == NULL)
+        {
+            continue; // Empty line
+        }
+
+        char* topic_text = strtok_r(NULL, " \t\r", &save);
+        bool is_ble = (topic_text != NULL) && (strcmp(topic_text, "BLE") == 0);
+        msg_id_e msg_id = E_TOPIC_FIRST_TOPIC;
+        if ((topic_text == NULL) || (!is_ble && !prv_parse_topic(topic_text, &msg_id)))
+        {
+            fprintf(stderr, "Line %u: expected <time_ms> <topic> [hex bytes]\n", line_number);
+            return false;
+        }
+
+        u32 time_ms = 0;
+        if (!prv_parse_time(time_text, &time_ms))
+        {
+            fprintf(stderr, "Line %u: expected the time as ms or h:mm:ss\n", line_number);
+            return false;
+        }
+        if (time_ms < previous_ms)
+        {
+            fprintf(stderr, "Line %u: time stamps must not decrease\n", line_number);
+            return false;
+        }
+        previous_ms = time_ms;
+
+        if (is_ble)
+        {
+            if (!options.is_presence_simulated)
+            {
+                fprintf(stderr, "Line %u: BLE devices need --simulate-presence\n", line_number);
+                return false;
+            }
+
+            s8 rssi_dbm[REPLAY_MAX_PAYLOAD];
+            u8 nof_devices = 0;
+            for (char* rssi_text = strtok_r(NULL, " \t\r", &save); rssi_text != NULL;
+                 rssi_text = strtok_r(NULL, " \t\r", &save))
+            {
+                long rssi = strtol(rssi_text, NULL, 10);
+                if ((nof_devices >= sizeof(rssi_dbm)) || (rssi < -128) || (rssi >= 0))
+                {
+                    fprintf(stderr, "Line %u: expected up to %u RSSI values in dBm\n", line_number,
+                            (unsigned)sizeof(rssi_dbm));
+                    return false;
+                }
+                rssi_dbm[nof_devices++] = (s8)rssi;
+            }
+            prv_add_ble_event(time_ms, rssi_dbm, nof_devices);
+            continue;
+        }
+
+        u8 payload[REPLAY_MAX_PAYLOAD];
+        u16 data_size = 0;
+        for (char* byte_text = strtok_r(NULL, " \t\r", &save); byte_text != NULL;
+             byte_text = strtok_r(NULL, " \t\r", &save))
+        {
+            if (data_size >= REPLAY_MAX_PAYLOAD)
+            {
+                fprintf(stderr, "Line %u: payload larger than %u bytes\n", line_number, REPLAY_MAX_PAYLOAD);
+                return false;
+            }
+            payload[data_size++] = (u8)strtoul(byte_text, NULL, 16);
+        }
+
+        prv_add_event(time_ms, msg_id, data_size, payload, data_size);
+    }
+    return true;
+}
+
+static void prv_run(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    // Same order as setup() in main.cpp
+    messagebroker_init();
+    prv_deskcontrol_init();
+    prv_applicationcontrol_init();
+    prv_timermanager_init();
+    if (options.is_presence_simulated)
+    {
+        prv_presencedetector_init();
+        for (u8 i = 0; i < sizeof(presence_topics) / sizeof(presence_topics[0]); i++)
+        {
+            messagebroker_subscribe(presence_topics[i], prv_output_callback);
+        }
+    }
+
+    for (u8 i = 0; i < sizeof(output_topics) / sizeof(output_topics[0]); i++)
+    {
+        messagebroker_subscribe(output_topics[i], prv_output_callback);
+    }
+
+    // The tasks start at boot, the first record is the boot time of the replay
+    appctrl_resume_ms = 0;
+    is_timer_pending = false;
+    prv_settle();
+
+    for (u32 i = 0; i < nof_inputs; i++)
+    {
+        const replay_event_t* input = &inputs[i];
+        prv_run_until(input->time_ms);
+
+        if (input->kind == EVENT_BLE)
+        {
+            // The PresenceDetector sees the devices with its next scan evaluation
+            host_ble_set_devices((const s8*)input->data_bytes, (u8)input->nof_bytes);
+            continue;
+        }
+
+        msg_t message;
+        message.msg_id = input->msg_id;
+        message.data_size = input->nof_bytes;
+        message.data_bytes = (input->nof_bytes > 0) ? (u8*)input->data_bytes : NULL;
+        messagebroker_publish(&message);
+
+        prv_settle();
+    }
+
+    u32 last_ms = (nof_inputs > 0) ? inputs[nof_inputs - 1U].time_ms : 0U;
+    prv_run_until(last_ms + options.tail_ms);
+}
+
+// Runs timers, the desk and the delayed ApplicationControl task up to and including end_ms
+static void prv_run_until(u32 end_ms)
+{
+    while (true)
+    {
+        bool is_due = false;
+        u32 next_ms = end_ms;
+
+        u32 expiry_ms = 0;
+        if (host_get_next_timer_expiry_ms(&expiry_ms) && (expiry_ms <= next_ms))
+        {
+            next_ms = expiry_ms;
+            is_due = true;
+        }
+        if (is_timer_pending && (timermanager_resume_ms <= next_ms))
+        {
+            next_ms = timermanager_resume_ms;
+            is_due = true;
+        }
+        if ((appctrl_resume_ms > host_get_time_ms()) && (appctrl_resume_ms <= next_ms))
+        {
+            next_ms = appctrl_resume_ms;
+            is_due = true;
+        }
+        if (is_desk_awake && (desk_poll_ms <= next_ms))
+        {
+            next_ms = desk_poll_ms;
+            is_due = true;
+        }
+
+        if (!is_due)
+        {
+            break;
+        }
+        prv_step(next_ms);
+    }
+
+    prv_pace(end_ms);
+    host_set_time_ms(end_ms);
+}
+
+static void prv_step(u32 time_ms)
+{
+    prv_pace(time_ms);
+    host_set_time_ms(time_ms);
+
+    host_run_expired_timers();
+
+    if (is_desk_awake && (desk_poll_ms <= time_ms))
+    {
+        desk_poll_ms += options.desk_poll_ms;
+        host_uart_receive(desk_request_frame, sizeof(desk_request_frame));
+    }
+
+    prv_settle();
+}
+
+// Lets every module react to what happened at the current time
+static void prv_settle(void)
+{
+    // TimerManager task: publishes the expired timers
+    prv_run_timermanager();
+
+    // MessageDispatcher task: timer and UART notifications are published from interrupt context
+    while (messagebroker_isr_queue_process(0) > 0)
+    {
+    }
+
+    // PresenceDetector task: evaluates the scan when its timer expired, never blocked in delay()
+    if (options.is_presence_simulated)
+    {
+        (void)prv_presencedetector_run();
+    }
+
+    // ApplicationControl task, unless it is still blocked in delay()
+    if (host_get_time_ms() >= appctrl_resume_ms)
+    {
+        prv_applicationcontrol_run();
+        appctrl_resume_ms = host_get_time_ms() + host_take_pending_delay_ms();
+
+        while (messagebroker_isr_queue_process(0) > 0)
+        {
+        }
+    }
+
+    // Timers started in the meantime
+    prv_run_timermanager();
+
+    // Frames DeskControl sent to the desk
+    u8 frame[REPLAY_MAX_PAYLOAD];
+    size_t size = host_uart_take_transmitted(frame, sizeof(frame));
+    if (size > 0)
+    {
+        ASSERT(nof_outputs < REPLAY_MAX_EVENTS);
+        replay_event_t* output = &outputs[nof_outputs++];
+        output->time_ms = host_get_time_ms();
+        output->kind = EVENT_UART;
+        output->msg_id = E_TOPIC_FIRST_TOPIC;
+        output->data_size = (u16)size;
+        output->nof_bytes = (u16)size;
+        memcpy(output->data_bytes, frame, size);
+    }
+
+    // The desk only polls for commands while DeskControl keeps its display awake
+    bool is_awake = host_get_pin_level(REPLAY_DESK_WAKEUP_PIN);
+    if (is_awake && !is_desk_awake)
+    {
+        desk_poll_ms = host_get_time_ms() + options.desk_poll_ms;
+    }
+    is_desk_awake = is_awake;
+}
+
+// Runs the TimerManager and remembers when it has to run again
+static void prv_run_timermanager(void)
+{
+    u32 next_run_ms = prv_timermanager_run();
+    is_timer_pending = (next_run_ms != MESSAGEBROKER_WAIT_FOREVER);
+    timermanager_resume_ms = host_get_time_ms() + next_run_ms;
+}
+
+// Keeps the replay on the original (or scaled) wall clock timing if requested
+static void prv_pace(u32 time_ms)
+{
+    if (options.speed <= 0.0)
+    {
+        return;
+    }
+
+    double target_s = (double)time_ms / 1000.0 / options.speed;
+    struct timespec target;
+    target.tv_sec = wall_start.tv_sec + (time_t)target_s;
+    target.tv_nsec = wall_start.tv_nsec + (long)((target_s - (double)(time_t)target_s) * 1e9);
+    if (target.tv_nsec >= 1000000000L)
+    {
+        target.tv_sec += 1;
+        target.tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+}
+
+static void prv_output_callback(const msg_t* const message)
+{
+    ASSERT(nof_outputs < REPLAY_MAX_EVENTS);
+    ASSERT(message->data_size <= REPLAY_MAX_PAYLOAD);
+
+    replay_event_t* output = &outputs[nof_outputs++];
+    output->time_ms = host_get_time_ms();
+    output->kind = EVENT_MESSAGE;
+    output->msg_id = message->msg_id;
+    output->data_size = message->data_size;
+    output->nof_bytes = message->data_size;
+    if (message->data_size > 0)
+    {
+        memcpy(output->data_bytes, message->data_bytes, message->data_size);
+    }
+}
+
+static bool prv_is_output_topic(msg_id_e msg_id)
+{
+    for (u8 i = 0; i < sizeof(output_topics) / sizeof(output_topics[0]); i++)
+    {
+        if (output_topics[i] == msg_id)
+        {
+            return true;
+        }
+    }
+    for (u8 i = 0; options.is_presence_simulated && (i < sizeof(presence_topics) / sizeof(presence_topics[0])); i++)
+    {
+        if (presence_topics[i] == msg_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* prv_get_topic_name(msg_id_e msg_id)
+{
+    for (u8 i = 0; i < sizeof(topic_names) / sizeof(topic_names[0]); i++)
+    {
+        if (topic_names[i].msg_id == msg_id)
+        {
+            return topic_names[i].name;
+        }
+    }
+    return "MSG_????";
+}
+
+static bool prv_parse_topic(const char* text, msg_id_e* msg_id)
+{
+    for (u8 i = 0; i < sizeof(topic_names) / sizeof(topic_names[0]); i++)
+    {
+        if (strcmp(topic_names[i].name, text) == 0)
+        {
+            *msg_id = topic_names[i].msg_id;
+            return true;
+        }
+    }
+
+    // Plain topic index as shown by msgbroker_trace
+    char* end = NULL;
+    unsigned long index = strtoul(text, &end, 0);
+    if ((*end != '\0') || (index <= E_TOPIC_FIRST_TOPIC) || (index >= E_TOPIC_LAST_TOPIC))
+    {
+        return false;
+    }
+    *msg_id = (msg_id_e)index;
+    return true;
+}
+
+static void prv_format_event(const replay_event_t* event, char* line, size_t size)
+{
+    const char* name = (event->kind == EVENT_UART) ? "UART" : prv_get_topic_name(event->msg_id);
+    int length = snprintf(line, size, "%10u ms  %-8s  %3u B", event->time_ms, name, event->data_size);
+
+    for (u16 i = 0; (i < event->nof_bytes) && (length > 0) && ((size_t)length + 5U < size); i++)
+    {
+        length += snprintf(&line[length], size - (size_t)length, (i == 0) ? "  %02X" : " %02X", event->data_bytes[i]);
+    }
+    if ((event->nof_bytes < event->data_size) && ((size_t)length + 5U < size))
+    {
+        snprintf(&line[length], size - (size_t)length, " ...");
+    }
+}
+
+// Compares the messages the modules published with the ones recorded on the device
+static bool prv_diff_recorded_outputs(void)
+{
+    if (nof_recorded_outputs == 0)
+    {
+        return true;
+    }
+
+    u32 nof_replayed = 0;
+    u32 nof_mismatches = 0;
+    u32 max_delta_ms = 0;
+    u32 recorded_index = 0;
+
+    printf("Recorded outputs vs. replay:\n");
+    for (u32 i = 0; i < nof_outputs; i++)
+    {
+        const replay_event_t* replayed = &outputs[i];
+        if (replayed->kind != EVENT_MESSAGE)
+        {
+            continue;
+        }
+        nof_replayed++;
+
+        char replayed_line[REPLAY_MAX_LINE];
+        prv_format_event(replayed, replayed_line, sizeof(replayed_line));
+
+        if (recorded_index >= nof_recorded_outputs)
+        {
+            printf("  + %s (not recorded)\n", replayed_line);
+            nof_mismatches++;
+            continue;
+        }
+
+        const replay_event_t* recorded = &recorded_outputs[recorded_index++];
+        u16 nof_compared = (recorded->nof_bytes < replayed->nof_bytes) ? recorded->nof_bytes : replayed->nof_bytes;
+        bool is_equal = (recorded->msg_id == replayed->msg_id) && (recorded->data_size == replayed->data_size) &&
+                        (memcmp(recorded->data_bytes, replayed->data_bytes, nof_compared) == 0);
+
+        u32 delta_ms = (replayed->time_ms > recorded->time_ms) ? replayed->time_ms - recorded->time_ms
+                                                                : recorded->time_ms - replayed->time_ms;
+        bool is_in_time = !options.is_tolerance_set || (delta_ms <= options.tolerance_ms);
+        max_delta_ms = (delta_ms > max_delta_ms) ? delta_ms : max_delta_ms;
+
+        if (!is_equal || !is_in_time)
+        {
+            char recorded_line[REPLAY_MAX_LINE];
+            prv_format_event(recorded, recorded_line, sizeof(recorded_line));
+            printf("  - %s\n  + %s\n", recorded_line, replayed_line);
+            nof_mismatches++;
+        }
+        else
+        {
+            printf("    %s (%+d ms)\n", replayed_line, (int)(replayed->time_ms - recorded->time_ms));
+        }
+    }
+
+    for (; recorded_index < nof_recorded_outputs; recorded_index++)
+    {
+        char recorded_line[REPLAY_MAX_LINE];
+        prv_format_event(&recorded_outputs[recorded_index], recorded_line, sizeof(recorded_line));
+        printf("  - %s (not replayed)\n", recorded_line);
+        nof_mismatches++;
+    }
+
+    printf("%u recorded, %u replayed, %u mismatches, max time difference %u ms\n", nof_recorded_outputs,
+           nof_replayed, nof_mismatches, max_delta_ms);
+    return nof_mismatches == 0;
+}
+
+static bool prv_diff_expected_outputs(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+
+    bool is_matching = true;
+    char expected[REPLAY_MAX_LINE];
+    char actual[REPLAY_MAX_LINE];
+    u32 index = 0;
+    while (fgets(expected, sizeof(expected), file) != NULL)
+    {
+        expected[strcspn(expected, "\r\n")] = '\0';
+
+        if (index >= nof_outputs)
+        {
+            printf("Expected output %u missing: %s\n", index + 1U, expected);
+            is_matching = false;
+            break;
+        }
+
+        prv_format_event(&outputs[index], actual, sizeof(actual));
+        if (strcmp(expected, actual) != 0)
+        {
+            printf("Output %u differs\n  expected: %s\n  actual:   %s\n", index + 1U, expected, actual);
+            is_matching = false;
+            break;
+        }
+        index++;
+    }
+    fclose(file);
+
+    if (is_matching && (index < nof_outputs))
+    {
+        prv_format_event(&outputs[index], actual, sizeof(actual));
+        printf("Unexpected output %u: %s\n", index + 1U, actual);
+        is_matching = false;
+    }
+    return is_matching;
+}
+
+static bool prv_write_outputs(FILE* file)
+{
+    for (u32 i = 0; i < nof_outputs; i++)
+    {
+        char line[REPLAY_MAX_LINE];
+        prv_format_event(&outputs[i], line, sizeof(line));
+        if (fprintf(file, "%s\n", line) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void prv_assert_failed(const char* file, uint32_t line, const char* expr)
+{
+    fprintf(stderr, "[ASSERT FAILED] at %u ms: %s:%u - %s\n", host_get_time_ms(), file, line, expr);
+    exit(3);
+}
@@ -0,0 +1,78 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * Host stand-in for the Arduino core API the modules use, see HostPlatform.h.
+ * millis() and delay() run on the virtual clock of the replay.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#define LOW    0x0
+#define HIGH   0x1
+#define INPUT  0x01
+#define OUTPUT 0x03
+
+// Pin numbers of the Seeed XIAO ESP32-C6
+#define D6 16
+#define D7 17
+#define D9 20
+
+#define SERIAL_8N1 0x800001cUL
+
+uint32_t millis(void);
+uint32_t micros(void);
+
+// Adds to the pending delay of the running module instead of blocking, see host_take_pending_delay_ms()
+void delay(uint32_t ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+class HardwareSerial
+{
+  public:
+    typedef void (*OnReceiveCb)(void);
+
+    explicit HardwareSerial(int uart_number);
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rx_pin = -1, int8_t tx_pin = -1);
+    void onReceive(OnReceiveCb callback, bool only_on_timeout = false);
+
+    int available(void);
+    int read(void);
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t* bytes, size_t size);
+    void flush(void);
+
+    size_t print(const char* text);
+    size_t print(char value);
+    size_t print(int value);
+    size_t print(unsigned int value);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(double value, int digits = 2);
+
+    size_t println(void);
+    template <typename T> size_t println(T value)
+    {
+        size_t size = print(value);
+        return size + println();
+    }
+
+    // Used by HostPlatform.cpp
+    int uart_number;
+    OnReceiveCb receive_callback;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,521 @@
+#include "HostPlatform.h"
+#include <stdio.h>
+#include <string.h>
+#include "Arduino.h"
+#include "NimBLEDevice.h"
+#include "Preferences.h"
+#include "custom_assert.h"
+#include "monotonic_time.h"
+
+// ###########################################################################
+// # Internal Configuration
+// ###########################################################################
+#define HOST_MAX_TIMERS      8U
+#define HOST_MAX_TASKS       16U
+#define HOST_MAX_PINS        64U
+#define HOST_UART_BUFFER     256U
+#define HOST_MAX_PREFERENCES 16U
+#define HOST_MAX_NAME_LENGTH 16U
+#define HOST_MAX_BLE_DEVICES 32U
+
+// ###########################################################################
+// # Private Types
+// ###########################################################################
+struct host_timer
+{
+    const char* name;
+    TickType_t period;
+    bool is_auto_reload;
+    bool is_active;
+    u32 expiry_ms;
+    void* timer_id;
+    TimerCallbackFunction_t callback;
+};
+
+typedef struct
+{
+    u8 bytes[HOST_UART_BUFFER];
+    size_t head;
+    size_t count;
+} host_byte_fifo_t;
+
+typedef struct
+{
+    char name_space[HOST_MAX_NAME_LENGTH];
+    char key[HOST_MAX_NAME_LENGTH];
+    u32 value;
+} host_preference_t;
+
+// ###########################################################################
+// # Private function declarations
+// ###########################################################################
+static void prv_fifo_push(host_byte_fifo_t* fifo, u8 byte);
+static bool prv_fifo_pop(host_byte_fifo_t* fifo, u8* byte);
+static void prv_serial_echo(const char* text);
+static host_preference_t* prv_find_preference(const char* name_space, const char* key);
+
+// ###########################################################################
+// # Private variables
+// ###########################################################################
+static u32 pending_delay_ms = 0;
+
+static struct host_timer timers[HOST_MAX_TIMERS];
+static u8 nof_timers = 0;
+
+static const char* task_names[HOST_MAX_TASKS];
+static u8 nof_tasks = 0;
+
+static bool pin_levels[HOST_MAX_PINS];
+
+static host_byte_fifo_t uart_rx = {};
+static host_byte_fifo_t uart_tx = {};
+static bool is_serial_echo_enabled = false;
+
+static host_preference_t preferences[HOST_MAX_PREFERENCES];
+static u8 nof_preferences = 0;
+
+static NimBLEAdvertisedDevice ble_devices[HOST_MAX_BLE_DEVICES];
+static u8 nof_ble_devices = 0;
+static NimBLEScan ble_scan;
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+
+// ###########################################################################
+// # Public function implementations - replay control
+// ###########################################################################
+u32 host_get_time_ms(void) { return (u32)monotonic_time_get_ms(); }
+
+void host_set_time_ms(u32 new_time_ms)
+{
+    ASSERT(new_time_ms >= host_get_time_ms()); // The virtual clock never runs backwards
+    monotonic_time_set_us((u64)new_time_ms * 1000U);
+}
+
+u32 host_take_pending_delay_ms(void)
+{
+    u32 delay_ms = pending_delay_ms;
+    pending_delay_ms = 0;
+    return delay_ms;
+}
+
+bool host_get_next_timer_expiry_ms(u32* expiry_ms)
+{
+    bool is_found = false;
+    for (u8 i = 0; i < nof_timers; i++)
+    {
+        if (timers[i].is_active && (!is_found || (timers[i].expiry_ms < *expiry_ms)))
+        {
+            *expiry_ms = timers[i].expiry_ms;
+            is_found = true;
+        }
+    }
+    return is_found;
+}
+
+void host_run_expired_timers(void)
+{
+    u32 expiry_ms = 0;
+    while (host_get_next_timer_expiry_ms(&expiry_ms) && (expiry_ms <= host_get_time_ms()))
+    {
+        // Earliest first, timers with the same expiry in creation order
+        for (u8 i = 0; i < nof_timers; i++)
+        {
+            struct host_timer* timer = &timers[i];
+            if (timer->is_active && (timer->expiry_ms == expiry_ms))
+            {
+                timer->is_active = timer->is_auto_reload;
+                timer->expiry_ms += timer->period;
+                timer->callback(timer);
+                break;
+            }
+        }
+    }
+}
+
+bool host_get_pin_level(u8 pin)
+{
+    ASSERT(pin < HOST_MAX_PINS);
+    return pin_levels[pin];
+}
+
+void host_uart_receive(const u8* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        prv_fifo_push(&uart_rx, bytes[i]);
+    }
+
+    if (Serial1.receive_callback != NULL)
+    {
+        Serial1.receive_callback();
+    }
+}
+
+size_t host_uart_take_transmitted(u8* bytes, size_t max_size)
+{
+    size_t size = 0;
+    while ((size < max_size) && prv_fifo_pop(&uart_tx, &bytes[size]))
+    {
+        size++;
+    }
+    return size;
+}
+
+void host_ble_set_devices(const s8* rssi_dbm, u8 nof_devices)
+{
+    ASSERT(nof_devices <= HOST_MAX_BLE_DEVICES); // Increase HOST_MAX_BLE_DEVICES
+
+    for (u8 i = 0; i < nof_devices; i++)
+    {
+        ble_devices[i].rssi = rssi_dbm[i];
+    }
+    nof_ble_devices = nof_devices;
+}
+
+void host_set_serial_echo(bool is_enabled) { is_serial_echo_enabled = is_enabled; }
+
+void host_preferences_put_u32(const char* name_space, const char* key, u32 value)
+{
+    host_preference_t* preference = prv_find_preference(name_space, key);
+    if (preference == NULL)
+    {
+        ASSERT(nof_preferences < HOST_MAX_PREFERENCES); // Increase HOST_MAX_PREFERENCES
+        ASSERT(strlen(name_space) < HOST_MAX_NAME_LENGTH);
+        ASSERT(strlen(key) < HOST_MAX_NAME_LENGTH);
+
+        preference = &preferences[nof_preferences++];
+        strcpy(preference->name_space, name_space);
+        strcpy(preference->key, key);
+    }
+    preference->value = value;
+}
+
+// ###########################################################################
+// # Public function implementations - FreeRTOS
+// ###########################################################################
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* task_handle)
+{
+    (void)task;
+    (void)stack_depth;
+    (void)parameter;
+    (void)priority;
+
+    ASSERT(nof_tasks < HOST_MAX_TASKS); // Increase HOST_MAX_TASKS
+    task_names[nof_tasks] = name;
+    if (task_handle != NULL)
+    {
+        *task_handle = (TaskHandle_t)&task_names[nof_tasks];
+    }
+    nof_tasks++;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { pending_delay_ms += ticks; }
+
+TickType_t xTaskGetTickCount(void) { return host_get_time_ms(); }
+
+char* pcTaskGetName(TaskHandle_t task)
+{
+    static char replay_name[] = "Replay";
+    if (task == NULL)
+    {
+        return replay_name;
+    }
+    return (char*)*(const char**)task;
+}
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t is_auto_reload, void* timer_id,
+                           TimerCallbackFunction_t callback)
+{
+    ASSERT(nof_timers < HOST_MAX_TIMERS); // Increase HOST_MAX_TIMERS
+    ASSERT(period > 0);
+    ASSERT(callback != NULL);
+
+    struct host_timer* timer = &timers[nof_timers++];
+    timer->name = name;
+    timer->period = period;
+    timer->is_auto_reload = (is_auto_reload != pdFALSE);
+    timer->is_active = false;
+    timer->expiry_ms = 0;
+    timer->timer_id = timer_id;
+    timer->callback = callback;
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    ASSERT(timer != NULL);
+
+    timer->is_active = true;
+    timer->expiry_ms = host_get_time_ms() + timer->period;
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait) { return xTimerStart(timer, ticks_to_wait); }
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+    ASSERT(timer != NULL);
+
+    timer->is_active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks_to_wait)
+{
+    ASSERT(timer != NULL);
+    ASSERT(period > 0);
+
+    timer->period = period;
+    return xTimerStart(timer, ticks_to_wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer)
+{
+    ASSERT(timer != NULL);
+    return timer->is_active ? pdTRUE : pdFALSE;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer)
+{
+    ASSERT(timer != NULL);
+    return timer->timer_id;
+}
+
+// ###########################################################################
+// # Public function implementations - Arduino
+// ###########################################################################
+uint32_t millis(void) { return host_get_time_ms(); }
+
+uint32_t micros(void) { return (u32)monotonic_time_get_us(); }
+
+void delay(uint32_t ms) { pending_delay_ms += ms; }
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)mode;
+    ASSERT(pin < HOST_MAX_PINS);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    ASSERT(pin < HOST_MAX_PINS);
+    pin_levels[pin] = (level != LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+    ASSERT(pin < HOST_MAX_PINS);
+    return pin_levels[pin] ? HIGH : LOW;
+}
+
+HardwareSerial::HardwareSerial(int number) : uart_number(number), receive_callback(NULL) {}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rx_pin, int8_t tx_pin)
+{
+    (void)baud;
+    (void)config;
+    (void)rx_pin;
+    (void)tx_pin;
+}
+
+void HardwareSerial::onReceive(OnReceiveCb callback, bool only_on_timeout)
+{
+    (void)only_on_timeout;
+    receive_callback = callback;
+}
+
+int HardwareSerial::available(void) { return (uart_number == 1) ? (int)uart_rx.count : 0; }
+
+int HardwareSerial::read(void)
+{
+    u8 byte = 0;
+    if ((uart_number != 1) || !prv_fifo_pop(&uart_rx, &byte))
+    {
+        return -1;
+    }
+    return byte;
+}
+
+size_t HardwareSerial::write(uint8_t byte) { return write(&byte, 1); }
+
+size_t HardwareSerial::write(const uint8_t* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (uart_number == 1)
+        {
+            prv_fifo_push(&uart_tx, bytes[i]);
+        }
+        else if (is_serial_echo_enabled)
+        {
+            fputc(bytes[i], stderr);
+        }
+    }
+    return size;
+}
+
+void HardwareSerial::flush(void) {}
+
+size_t HardwareSerial::print(const char* text)
+{
+    prv_serial_echo(text);
+    return strlen(text);
+}
+
+size_t HardwareSerial::print(char value)
+{
+    char text[2] = {value, '\0'};
+    return print(text);
+}
+
+size_t HardwareSerial::print(int value) { return print((long)value); }
+
+size_t HardwareSerial::print(unsigned int value) { return print((unsigned long)value); }
+
+size_t HardwareSerial::print(long value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return print(text);
+}
+
+size_t HardwareSerial::print(unsigned long value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%lu", value);
+    return print(text);
+}
+
+size_t HardwareSerial::print(double value, int digits)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t HardwareSerial::println(void) { return print("\r\n"); }
+
+// ###########################################################################
+// # Public function implementations - Preferences
+// ###########################################################################
+bool Preferences::begin(const char* name, bool is_read_only)
+{
+    (void)is_read_only;
+    name_space = name;
+    return true;
+}
+
+void Preferences::end(void) { name_space = nullptr; }
+
+uint32_t Preferences::getUInt(const char* key, uint32_t default_value)
+{
+    ASSERT(name_space != nullptr);
+    host_preference_t* preference = prv_find_preference(name_space, key);
+    return (preference != NULL) ? preference->value : default_value;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value)
+{
+    ASSERT(name_space != nullptr);
+    host_preferences_put_u32(name_space, key, value);
+    return sizeof(value);
+}
+
+int32_t Preferences::getInt(const char* key, int32_t default_value)
+{
+    return (int32_t)getUInt(key, (uint32_t)default_value);
+}
+
+size_t Preferences::putInt(const char* key, int32_t value)
+{
+    return putUInt(key, (uint32_t)value);
+}
+
+// ###########################################################################
+// # Public function implementations - NimBLE
+// ###########################################################################
+bool NimBLEDevice::init(const std::string& device_name)
+{
+    (void)device_name;
+    return true;
+}
+
+NimBLEScan* NimBLEDevice::getScan(void) { return &ble_scan; }
+
+void NimBLEScan::setActiveScan(bool is_active) { (void)is_active; }
+
+void NimBLEScan::setInterval(uint16_t interval_ms) { (void)interval_ms; }
+
+void NimBLEScan::setWindow(uint16_t window_ms) { (void)window_ms; }
+
+bool NimBLEScan::start(uint32_t duration_ms, bool is_continue, bool restart)
+{
+    (void)duration_ms;
+    (void)is_continue;
+    (void)restart;
+    return true;
+}
+
+NimBLEScanResults NimBLEScan::getResults(uint32_t duration_ms, bool is_continue)
+{
+    (void)duration_ms;
+    (void)is_continue;
+    return NimBLEScanResults();
+}
+
+void NimBLEScan::clearResults(void) {}
+
+int NimBLEScanResults::getCount(void) const { return nof_ble_devices; }
+
+const NimBLEAdvertisedDevice* NimBLEScanResults::getDevice(uint32_t index) const
+{
+    ASSERT(index < nof_ble_devices);
+    return &ble_devices[index];
+}
+
+// ###########################################################################
+// # Private function implementations
+// ###########################################################################
+static void prv_fifo_push(host_byte_fifo_t* fifo, u8 byte)
+{
+    ASSERT(fifo->count < HOST_UART_BUFFER); // Increase HOST_UART_BUFFER
+    fifo->bytes[(fifo->head + fifo->count) % HOST_UART_BUFFER] = byte;
+    fifo->count++;
+}
+
+static bool prv_fifo_pop(host_byte_fifo_t* fifo, u8* byte)
+{
+    if (fifo->count == 0)
+    {
+        return false;
+    }
+    *byte = fifo->bytes[fifo->head];
+    fifo->head = (fifo->head + 1U) % HOST_UART_BUFFER;
+    fifo->count--;
+    return true;
+}
+
+static void prv_serial_echo(const char* text)
+{
+    if (is_serial_echo_enabled)
+    {
+        fputs(text, stderr);
+    }
+}
+
+static host_preference_t* prv_find_preference(const char* name_space, const char* key)
+{
+    for (u8 i = 0; i < nof_preferences; i++)
+    {
+        if ((strcmp(preferences[i].name_space, name_space) == 0) && (strcmp(preferences[i].key, key) == 0))
+        {
+            return &preferences[i];
+        }
+    }
+    return NULL;
+}
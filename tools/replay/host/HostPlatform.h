@@ -0,0 +1,45 @@
+#ifndef HOST_PLATFORM_H
+#define HOST_PLATFORM_H
+
+/**
+ * Deterministic host platform for replaying firmware modules on Linux.
+ *
+ * The Arduino, FreeRTOS, NimBLE and Preferences headers in this directory replace the ESP32
+ * ones, so the module sources compile unchanged. Nothing runs on its own: the replay
+ * owns the virtual clock, steps the modules and runs expired timers. Module code only
+ * ever sees the virtual time, so a replay gives the same result on every run.
+ */
+
+#include <stddef.h>
+#include "custom_types.h"
+
+// Virtual clock, the monotonic time base of the modules (MONOTONIC_TIME_VIRTUAL)
+u32 host_get_time_ms(void);
+void host_set_time_ms(u32 time_ms);
+
+// Sum of all delay() and vTaskDelay() calls since the last call, the caller resumes the module that much later
+u32 host_take_pending_delay_ms(void);
+
+// Software timers - earliest expiry of the active timers, false if none is running
+bool host_get_next_timer_expiry_ms(u32* expiry_ms);
+
+// Runs the callbacks of all timers that expired at or before the current time
+void host_run_expired_timers(void);
+
+// GPIO level as last written with digitalWrite()
+bool host_get_pin_level(u8 pin);
+
+// UART 1: bytes from the peripheral are queued and the onReceive callback is called like the driver does
+void host_uart_receive(const u8* bytes, size_t size);
+size_t host_uart_take_transmitted(u8* bytes, size_t max_size);
+
+// BLE scan: devices in range from now on with their RSSI in dBm, the PresenceDetector counts the close ones
+void host_ble_set_devices(const s8* rssi_dbm, u8 nof_devices);
+
+// Console output of the modules (Serial) is dropped unless echoed to stderr
+void host_set_serial_echo(bool is_enabled);
+
+// Preset of a Preferences value, e.g. host_preferences_put_u32("appctrl", "timer_ms", 600000)
+void host_preferences_put_u32(const char* name_space, const char* key, u32 value);
+
+#endif // HOST_PLATFORM_H
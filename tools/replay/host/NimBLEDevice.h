@@ -0,0 +1,48 @@
+#ifndef HOST_NIMBLEDEVICE_H
+#define HOST_NIMBLEDEVICE_H
+
+/**
+ * Host stand-in for the NimBLE scanner the PresenceDetector uses, see HostPlatform.h.
+ * The scan results are the devices the replay put in range with host_ble_set_devices().
+ */
+
+#include <stdint.h>
+#include <string>
+
+class NimBLEAdvertisedDevice
+{
+  public:
+    int getRSSI(void) const { return rssi; }
+
+    // Used by HostPlatform.cpp
+    int rssi;
+};
+
+class NimBLEScanResults
+{
+  public:
+    int getCount(void) const;
+    const NimBLEAdvertisedDevice* getDevice(uint32_t index) const;
+};
+
+class NimBLEScan
+{
+  public:
+    void setActiveScan(bool is_active);
+    void setInterval(uint16_t interval_ms);
+    void setWindow(uint16_t window_ms);
+    bool start(uint32_t duration_ms, bool is_continue = false, bool restart = true);
+
+    // Returns at once with the devices in range, the replay does not scan in the background
+    NimBLEScanResults getResults(uint32_t duration_ms, bool is_continue = false);
+    void clearResults(void);
+};
+
+class NimBLEDevice
+{
+  public:
+    static bool init(const std::string& device_name);
+    static NimBLEScan* getScan(void);
+};
+
+#endif // HOST_NIMBLEDEVICE_H
@@ -0,0 +1,27 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+/**
+ * Host stand-in for the NVS backed Preferences of the ESP32 Arduino core.
+ * Values live in RAM for the duration of the replay, see host_preferences_put_u32().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Preferences
+{
+  public:
+    bool begin(const char* name, bool is_read_only = false);
+    void end(void);
+
+    uint32_t getUInt(const char* key, uint32_t default_value = 0);
+    size_t putUInt(const char* key, uint32_t value);
+    int32_t getInt(const char* key, int32_t default_value = 0);
+    size_t putInt(const char* key, int32_t value);
+
+  private:
+    const char* name_space = nullptr;
+};
+
+#endif // HOST_PREFERENCES_H
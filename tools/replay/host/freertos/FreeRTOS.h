@@ -0,0 +1,46 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/**
+ * Host stand-in for the FreeRTOS types and macros the modules use, see HostPlatform.h.
+ * One tick is one millisecond, like configTICK_RATE_HZ = 1000 on the ESP32-C6.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    typedef int32_t BaseType_t;
+    typedef uint32_t UBaseType_t;
+    typedef uint32_t TickType_t;
+    typedef void* TaskHandle_t;
+    typedef void (*TaskFunction_t)(void* parameter);
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE  ((BaseType_t)1)
+#define pdFAIL  pdFALSE
+#define pdPASS  pdTRUE
+
+#define configTICK_RATE_HZ 1000U
+#define portTICK_PERIOD_MS 1U
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+    // The replay runs the modules in one thread, critical sections have nothing to exclude
+    typedef struct
+    {
+        uint32_t owner;
+    } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux)      ((void)(mux))
+#define portEXIT_CRITICAL(mux)       ((void)(mux))
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // HOST_FREERTOS_H
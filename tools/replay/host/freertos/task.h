@@ -0,0 +1,30 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    /**
+     * @brief Registers the task without running it, the replay steps the modules itself
+     */
+    BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth, void* parameter,
+                           UBaseType_t priority, TaskHandle_t* task_handle);
+
+    /**
+     * @brief Adds the ticks to the pending delay of the running module, see host_take_pending_delay_ms()
+     */
+    void vTaskDelay(TickType_t ticks);
+
+    TickType_t xTaskGetTickCount(void);
+
+    char* pcTaskGetName(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,32 @@
+#ifndef HOST_FREERTOS_TIMERS_H
+#define HOST_FREERTOS_TIMERS_H
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+    typedef struct host_timer* TimerHandle_t;
+    typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+    /**
+     * Software timers on the virtual clock. Expired timers run in host_run_expired_timers(),
+     * which stands in for the timer service task. Same semantics as FreeRTOS: changing the
+     * period of a dormant timer starts it, starting an active timer restarts it.
+     */
+    TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t is_auto_reload, void* timer_id,
+                               TimerCallbackFunction_t callback);
+    BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait);
+    BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait);
+    BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait);
+    BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks_to_wait);
+    BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+    void* pvTimerGetTimerID(TimerHandle_t timer);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // HOST_FREERTOS_TIMERS_H